@@ -0,0 +1,386 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <functional>
+#include <algorithm>
+#include "../pool/affinity.h"
+
+using namespace std;
+
+namespace {
+
+//一个配置项: 名称、说明,以及从字符串设置与格式化为字符串的方法
+struct Option {
+    const char *name;
+    const char *help;
+    function<bool(Config &, const string &)> set;
+    function<string(const Config &)> get;
+};
+
+/**
+ * @brief 解析整数,可以带 K/M/G 后缀(1024 进制),如 64M
+ * @param text
+ * @param value
+ * @return 格式错误时返回 false
+ */
+bool ParseInteger(const string &text, long long &value) {
+    if (text.empty()) { return false; }
+    errno = 0;
+    char *end = nullptr;
+    value = strtoll(text.c_str(), &end, 10);
+    if (errno != 0 || end == text.c_str()) { return false; }
+    long long unit = 1;
+    switch (*end) {
+        case 'k': case 'K': unit = 1LL << 10; end++; break;
+        case 'm': case 'M': unit = 1LL << 20; end++; break;
+        case 'g': case 'G': unit = 1LL << 30; end++; break;
+        default: break;
+    }
+    if (*end != '\0') { return false; }
+    if (value > LLONG_MAX / unit || value < LLONG_MIN / unit) { return false; }
+    value *= unit;
+    return true;
+}
+
+/**
+ * @brief 解析布尔值,接受 true/false、on/off、yes/no、1/0
+ * @param text
+ * @param value
+ * @return
+ */
+bool ParseBool(const string &text, bool &value) {
+    const char *s = text.c_str();
+    if (!strcasecmp(s, "true") || !strcasecmp(s, "on") || !strcasecmp(s, "yes") || !strcmp(s, "1")) {
+        value = true;
+        return true;
+    }
+    if (!strcasecmp(s, "false") || !strcasecmp(s, "off") || !strcasecmp(s, "no") || !strcmp(s, "0")) {
+        value = false;
+        return true;
+    }
+    return false;
+}
+
+Option IntOpt(const char *name, int Config::*member, long long lo, long long hi, const char *help) {
+    return {name, help,
+            [=](Config &c, const string &v) {
+                long long n;
+                if (!ParseInteger(v, n) || n < lo || n > hi) { return false; }
+                c.*member = static_cast<int>(n);
+                return true;
+            },
+            [=](const Config &c) { return to_string(c.*member); }};
+}
+
+Option SizeOpt(const char *name, size_t Config::*member, const char *help) {
+    return {name, help,
+            [=](Config &c, const string &v) {
+                long long n;
+                if (!ParseInteger(v, n) || n < 0) { return false; }
+                c.*member = static_cast<size_t>(n);
+                return true;
+            },
+            [=](const Config &c) { return to_string(c.*member); }};
+}
+
+Option BoolOpt(const char *name, bool Config::*member, const char *help) {
+    return {name, help,
+            [=](Config &c, const string &v) { return ParseBool(v, c.*member); },
+            [=](const Config &c) { return string(c.*member ? "true" : "false"); }};
+}
+
+Option StrOpt(const char *name, string Config::*member, const char *help) {
+    return {name, help,
+            [=](Config &c, const string &v) {
+                c.*member = v;
+                return true;
+            },
+            [=](const Config &c) { return c.*member; }};
+}
+
+/**
+ * @brief 所有配置项,顺序与 Config 的成员一致
+ * @return
+ */
+const vector <Option> &Options() {
+    static const vector <Option> options = {
+            IntOpt("port", &Config::port, 1024, 65535, "监听端口"),
+            IntOpt("trigMode", &Config::trigMode, 0, 3, "触发模式: 0 LT+LT 1 连接 ET 2 监听 ET 3 ET+ET"),
+            IntOpt("timeoutMs", &Config::timeoutMs, 0, INT_MAX, "连接的空闲超时(毫秒),0 表示不超时"),
+            BoolOpt("optLinger", &Config::optLinger, "是否设置 SO_LINGER 优雅关闭"),
+            IntOpt("threadNum", &Config::threadNum, 0, 1024, "线程池的线程数,0 表示按可用 CPU 数自动设置"),
+
+            StrOpt("sqlHost", &Config::sqlHost, "MySQL 地址"),
+            IntOpt("sqlPort", &Config::sqlPort, 1, 65535, "MySQL 端口"),
+            StrOpt("sqlUser", &Config::sqlUser, "MySQL 用户名"),
+            StrOpt("sqlPwd", &Config::sqlPwd, "MySQL 密码,建议通过环境变量 WEBSERVER_SQL_PWD 传入"),
+            StrOpt("dbName", &Config::dbName, "数据库名"),
+            IntOpt("connPoolNum", &Config::connPoolNum, 0, 1024, "数据库连接池大小,0 表示与线程数相同"),
+
+            BoolOpt("openLog", &Config::openLog, "是否打开日志"),
+            IntOpt("logLevel", &Config::logLevel, 0, 3, "日志等级: 0 debug 1 info 2 warn 3 error"),
+            IntOpt("logQueSize", &Config::logQueSize, 0, 1 << 24, "异步日志队列容量,0 表示同步写日志"),
+            BoolOpt("logBinary", &Config::logBinary, "是否写二进制格式的日志"),
+            SizeOpt("logFileMaxBytes", &Config::logFileMaxBytes, "单个日志文件的最大字节数,0 表示只按日期滚动"),
+            IntOpt("logOverflow", &Config::logOverflow, 0, 2, "日志队列写满时: 0 等待 1 丢弃 2 同步写文件"),
+            IntOpt("logRetention", &Config::logRetention, 0, INT_MAX, "保留的已滚动日志文件个数,0 表示不清理"),
+            BoolOpt("logCompress", &Config::logCompress, "是否压缩已滚动的日志文件"),
+
+            IntOpt("listenBacklog", &Config::listenBacklog, 1, INT_MAX, "listen 的等待队列长度"),
+            IntOpt("acceptBatch", &Config::acceptBatch, 1, INT_MAX, "每次监听事件最多 accept 的连接数"),
+            IntOpt("deferAcceptSec", &Config::deferAcceptSec, 0, INT_MAX, "TCP_DEFER_ACCEPT 秒数,0 表示关闭"),
+
+            BoolOpt("tcpNoDelay", &Config::tcpNoDelay, "是否设置 TCP_NODELAY"),
+            IntOpt("sndBufBytes", &Config::sndBufBytes, 0, INT_MAX, "SO_SNDBUF 字节数,0 表示内核自动调节"),
+            IntOpt("rcvBufBytes", &Config::rcvBufBytes, 0, INT_MAX, "SO_RCVBUF 字节数,0 表示内核自动调节"),
+            IntOpt("notSentLowat", &Config::notSentLowat, 0, INT_MAX, "TCP_NOTSENT_LOWAT 字节数,0 表示不设置"),
+            IntOpt("keepAliveIdleSec", &Config::keepAliveIdleSec, 0, INT_MAX, "TCP 保活的空闲秒数,0 表示不开启"),
+            IntOpt("keepAliveIntvlSec", &Config::keepAliveIntvlSec, 1, INT_MAX, "TCP 保活探测的间隔秒数"),
+            IntOpt("keepAliveCnt", &Config::keepAliveCnt, 1, INT_MAX, "TCP 保活探测的次数"),
+
+            IntOpt("maxConnections", &Config::maxConnections, 0, INT_MAX, "最大连接数,0 表示 MAX_FD"),
+            IntOpt("shedQueueDepth", &Config::shedQueueDepth, 0, INT_MAX, "线程池队列达到该长度时返回 503,0 表示不检查"),
+            IntOpt("shedP99Ms", &Config::shedP99Ms, 0, INT_MAX, "请求耗时 p99 超过该毫秒数时返回 503,0 表示不检查"),
+            IntOpt("retryAfterSec", &Config::retryAfterSec, 0, INT_MAX, "503 响应中 Retry-After 的秒数"),
+            IntOpt("evictBatch", &Config::evictBatch, 1, INT_MAX, "一次找出的待关闭空闲长连接数"),
+
+            IntOpt("busyPollUs", &Config::busyPollUs, 0, INT_MAX, "事件循环忙轮询的时长(微秒),0 表示关闭"),
+            IntOpt("sockBusyPollUs", &Config::sockBusyPollUs, 0, INT_MAX, "连接上的 SO_BUSY_POLL(微秒),0 表示不设置"),
+            BoolOpt("preferBusyPoll", &Config::preferBusyPoll, "是否设置 SO_PREFER_BUSY_POLL"),
+
+            StrOpt("loopCpus", &Config::loopCpus, "事件循环绑定的 CPU 列表,auto 按 NUMA 拓扑选择,空表示不绑定"),
+            StrOpt("workerCpus", &Config::workerCpus, "工作线程绑定的 CPU 列表,auto 使用同一节点的其余 CPU"),
+
+            BoolOpt("inlineDispatch", &Config::inlineDispatch, "命中文件缓存的请求是否在事件循环线程中处理"),
+            SizeOpt("fileCacheBytes", &Config::fileCacheBytes, "静态文件缓存的总大小,0 表示不缓存"),
+            SizeOpt("fileCacheMaxFile", &Config::fileCacheMaxFile, "可以缓存的单个文件的最大字节数"),
+
+            StrOpt("htmlPages", &Config::htmlPages, "省略 .html 后缀访问的页面,逗号分隔"),
+            StrOpt("mimeTypesFile", &Config::mimeTypesFile, "额外的 MIME 类型文件(/etc/mime.types 格式),空表示只用内置的表"),
+
+            BoolOpt("accessLog", &Config::accessLog, "是否开启访问日志"),
+            StrOpt("accessLogPath", &Config::accessLogPath, "访问日志文件"),
+            IntOpt("accessLogSampleRate", &Config::accessLogSampleRate, 1, INT_MAX, "每 N 个请求记录一个"),
+            IntOpt("accessLogFlushMs", &Config::accessLogFlushMs, 1, INT_MAX, "访问日志批量写入的间隔(毫秒)"),
+
+            StrOpt("metricsPath", &Config::metricsPath, "返回 Prometheus 格式监控指标的路径(如 /metrics),空表示不提供"),
+            IntOpt("slowRequestMs", &Config::slowRequestMs, 0, INT_MAX, "耗时超过该毫秒数的请求把各阶段的耗时写入日志,0 表示不记录"),
+
+            StrOpt("captureFile", &Config::captureFile, "录制收到的原始请求与到达时间的文件(用 replay 工具回放),空表示不录制"),
+            SizeOpt("captureMaxBytes", &Config::captureMaxBytes, "录制文件的最大字节数,达到后停止录制,0 表示不限制"),
+
+            StrOpt("upgradeSocket", &Config::upgradeSocket, "交接监听套接字的 Unix 套接字路径,空表示不支持平滑升级"),
+            IntOpt("drainTimeoutMs", &Config::drainTimeoutMs, 0, INT_MAX, "平滑升级时等待已有连接处理完的最长时间(毫秒)"),
+
+            IntOpt("workers", &Config::workers, 0, 1024, "prefork 模式的工作进程数,0 表示单进程"),
+            BoolOpt("reusePort", &Config::reusePort, "设置 SO_REUSEPORT,prefork 模式下每个工作进程各自监听"),
+    };
+    return options;
+}
+
+/**
+ * @brief 去掉首尾空白
+ * @param s
+ * @return
+ */
+string Trim(const string &s) {
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == string::npos) { return ""; }
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+}
+
+/**
+ * @brief 按名称设置一个配置项
+ * @param key 配置项名称,与成员名相同
+ * @param value 字符串形式的值
+ * @param err 失败时的错误信息
+ * @return 名称不存在或取值不合法时返回 false
+ */
+bool Config::Set(const string &key, const string &value, string &err) {
+    for (const Option &opt: Options()) {
+        if (key != opt.name) { continue; }
+        if (!opt.set(*this, value)) {
+            err = "invalid value for " + key + ": " + value;
+            return false;
+        }
+        return true;
+    }
+    err = "unknown option: " + key;
+    return false;
+}
+
+/**
+ * @brief 按名称读取一个配置项
+ * @param key
+ * @return 名称不存在时返回空字符串
+ */
+string Config::Get(const string &key) const {
+    for (const Option &opt: Options()) {
+        if (key == opt.name) { return opt.get(*this); }
+    }
+    return "";
+}
+
+/**
+ * @brief 与另一份配置比较
+ * @param other
+ * @return 取值不同的配置项名称
+ */
+vector <string> Config::Diff(const Config &other) const {
+    vector <string> keys;
+    for (const Option &opt: Options()) {
+        if (opt.get(*this) != opt.get(other)) { keys.push_back(opt.name); }
+    }
+    return keys;
+}
+
+/**
+ * @brief 读取配置文件
+ * 每行一个 key = value,# 开始的是注释;值可以用双引号括起来以表示空字符串或包含 # 的内容
+ * @param path
+ * @param err 失败时的错误信息,包含文件名与行号
+ * @return
+ */
+bool Config::Load(const string &path, string &err) {
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp) {
+        err = "cannot open config file " + path;
+        return false;
+    }
+    char buff[4096];
+    int lineNo = 0;
+    bool ok = true;
+    while (ok && fgets(buff, sizeof(buff), fp)) {
+        lineNo++;
+        string line = Trim(buff);
+        if (line.empty() || line[0] == '#') { continue; }
+        size_t eq = line.find('=');
+        string key = Trim(line.substr(0, eq));
+        string value = eq == string::npos ? "" : Trim(line.substr(eq + 1));
+        if (eq == string::npos) {
+            err = "expected key = value";
+            ok = false;
+        } else if (!value.empty() && value[0] == '"') {
+            size_t close = value.find('"', 1);
+            if (close == string::npos) {
+                err = "unterminated quote";
+                ok = false;
+            }
+            value = value.substr(1, close - 1);
+        } else {
+            value = Trim(value.substr(0, value.find('#')));
+        }
+        if (ok && !Set(key, value, err)) { ok = false; }
+        if (!ok) { err = path + ":" + to_string(lineNo) + ": " + err; }
+    }
+    fclose(fp);
+    return ok;
+}
+
+/**
+ * @brief 解析命令行参数(不含程序名)
+ * -c/--config <文件> 先于其他参数读取,之后应用环境变量 WEBSERVER_SQL_PWD,
+ * 最后按顺序应用 --key=value 或 --key value,因此命令行总是覆盖配置文件
+ * @param args
+ * @param err 失败时的错误信息
+ * @return
+ */
+bool Config::ParseArgs(const vector <string> &args, string &err) {
+    vector <pair<string, string>> overrides;
+    for (size_t i = 0; i < args.size(); i++) {
+        const string &arg = args[i];
+        if (arg.compare(0, 2, "--") != 0 && arg != "-c") {
+            err = "unexpected argument: " + arg;
+            return false;
+        }
+        string key = arg == "-c" ? "config" : arg.substr(2);
+        string value;
+        size_t eq = key.find('=');
+        if (eq != string::npos) {
+            value = key.substr(eq + 1);
+            key = key.substr(0, eq);
+        } else if (i + 1 < args.size()) {
+            value = args[++i];
+        } else {
+            err = "missing value for " + arg;
+            return false;
+        }
+        if (key == "config") {
+            if (!Load(value, err)) { return false; }
+        } else {
+            overrides.emplace_back(key, value);
+        }
+    }
+    //密码不写在配置文件或命令行中时,可以从环境变量读取,避免出现在 ps 的输出中
+    const char *pwd = getenv("WEBSERVER_SQL_PWD");
+    if (pwd) { sqlPwd = pwd; }
+    for (const auto &kv: overrides) {
+        if (!Set(kv.first, kv.second, err)) { return false; }
+    }
+    return true;
+}
+
+/**
+ * @brief 返回把自动取值的配置项替换为实际值后的副本
+ * threadNum 为 0 时取可用 CPU 数(允许使用的 CPU 与 cgroup CPU 配额中较小的一个),
+ * connPoolNum 为 0 时与线程数相同: 同一时刻最多只有这么多个任务在使用数据库连接
+ * @return
+ */
+Config Config::Resolved() const {
+    Config config = *this;
+    if (config.threadNum <= 0) {
+        //prefork 模式下每个工作进程都有自己的线程池,CPU 由各工作进程平分
+        config.threadNum = max(1, Affinity::AvailableCpus() / max(1, config.workers));
+    }
+    if (config.connPoolNum <= 0) {
+        config.connPoolNum = config.threadNum;
+    }
+    return config;
+}
+
+/**
+ * @brief 以配置文件的格式输出所有配置项,输出结果可以直接作为配置文件使用
+ * 密码不会输出
+ * @return
+ */
+string Config::Dump() const {
+    string out;
+    for (const Option &opt: Options()) {
+        out += string("# ") + opt.help + "\n";
+        string value = opt.get(*this);
+        if (strcmp(opt.name, "sqlPwd") == 0 && !value.empty()) {
+            out += string("# ") + opt.name + " = (hidden)\n";
+            continue;
+        }
+        if (value.empty() || value.find_first_of("# \t\"") != string::npos) {
+            value = "\"" + value + "\"";
+        }
+        out += string(opt.name) + " = " + value + "\n";
+    }
+    return out;
+}
+
+/**
+ * @brief 命令行用法与所有配置项的说明
+ * @return
+ */
+string Config::Usage() {
+    Config defaults;
+    string out = "usage: server [-c <config file>] [--key=value ...] [--print-config] [--help]\n"
+                 "options (same keys as the config file):\n";
+    for (const Option &opt: Options()) {
+        char line[512];
+        snprintf(line, sizeof(line), "  --%-22s %s (default: %s)\n",
+                 opt.name, opt.help, opt.get(defaults).c_str());
+        out += line;
+    }
+    return out;
+}
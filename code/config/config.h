@@ -5,4 +5,116 @@
 #ifndef CCORANGE_WEBSERVER_CONFIG_H
 #define CCORANGE_WEBSERVER_CONFIG_H
 
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+//服务器的全部运行参数,每一项都有默认值
+//启动时依次应用: 默认值 -> 配置文件(-c) -> 环境变量 WEBSERVER_SQL_PWD -> 命令行 --key=value
+//配置文件每行一个 key = value,# 开始的是注释,key 与下面的成员名相同
+//收到 SIGHUP 时重新读取,见 WebServer::Reload_
+struct Config {
+    /* 服务器 */
+    int port = 1316;                            //监听端口
+    int trigMode = 3;                           //触发模式: 0 LT+LT 1 连接 ET 2 监听 ET 3 ET+ET
+    int timeoutMs = 60000;                      //连接的空闲超时(毫秒),0 表示不超时
+    bool optLinger = false;                     //是否设置 SO_LINGER 优雅关闭
+    int threadNum = 0;                          //线程池的线程数,0 表示按可用 CPU 数(包括 cgroup 配额)自动设置,prefork 模式下由各工作进程平分
+
+    /* 数据库 */
+    std::string sqlHost = "localhost";          //MySQL 地址
+    int sqlPort = 3306;                         //MySQL 端口
+    std::string sqlUser = "root";               //MySQL 用户名
+    std::string sqlPwd;                         //MySQL 密码,建议通过环境变量 WEBSERVER_SQL_PWD 传入
+    std::string dbName = "webserver";           //数据库名
+    int connPoolNum = 0;                        //数据库连接池大小,0 表示与线程池的线程数相同
+
+    /* 日志 */
+    bool openLog = true;                        //是否打开日志
+    int logLevel = 1;                           //日志等级: 0 debug 1 info 2 warn 3 error
+    int logQueSize = 1024;                      //异步日志队列容量,0 表示同步写日志
+    bool logBinary = false;                     //是否写二进制格式的日志(用 logdecode 工具解码)
+    size_t logFileMaxBytes = 64 * 1024 * 1024;  //单个日志文件的最大字节数,超过后滚动,0 表示只按日期滚动
+    int logOverflow = 2;                        //异步日志队列写满时: 0 等待 1 丢弃并计数 2 同步写文件
+    int logRetention = 0;                       //保留的已滚动日志文件个数,0 表示不清理
+    bool logCompress = false;                   //是否在后台把已滚动的日志文件压缩为 .gz
+
+    /* 监听与 accept */
+    int listenBacklog = 1024;                   //listen 的等待队列长度(内核会截断到 net.core.somaxconn)
+    int acceptBatch = 64;                       //每次监听事件最多 accept 的连接数,LT 与 ET 模式都适用
+    int deferAcceptSec = 0;                     //TCP_DEFER_ACCEPT 秒数,连接上有数据后才唤醒 accept,0 表示关闭
+
+    /* 连接的 TCP 参数 */
+    bool tcpNoDelay = true;                     //TCP_NODELAY,关闭 Nagle 算法,小响应不必等待前一个段的 ACK
+    int sndBufBytes = 0;                        //SO_SNDBUF 字节数,0 表示使用内核的自动调节
+    int rcvBufBytes = 0;                        //SO_RCVBUF 字节数,0 表示使用内核的自动调节
+    int notSentLowat = 0;                       //TCP_NOTSENT_LOWAT 字节数,发送缓冲区中未发出的数据低于该值才可写,0 表示不设置
+    int keepAliveIdleSec = 0;                   //连接空闲多少秒后发送 TCP 保活探测,0 表示不开启 SO_KEEPALIVE
+    int keepAliveIntvlSec = 10;                 //保活探测的间隔秒数
+    int keepAliveCnt = 3;                       //连续多少次探测无响应后断开连接
+
+    /* 过载保护 */
+    int maxConnections = 0;                     //最大连接数,0 表示 MAX_FD;达到后先关闭最空闲的长连接,仍不够时返回 503
+    int shedQueueDepth = 1024;                  //线程池等待队列达到该长度时新连接返回 503,0 表示不检查
+    int shedP99Ms = 0;                          //最近一秒请求耗时的 p99 超过该毫秒数时新连接返回 503,0 表示不检查
+    int retryAfterSec = 1;                      //503 响应中 Retry-After 的秒数
+    int evictBatch = 8;                         //连接数达到上限时一次找出的待关闭空闲长连接数
+
+    /* 忙轮询 */
+    int busyPollUs = 0;                         //阻塞在 epoll_wait 之前先用 epoll_wait(0) 轮询的时长(微秒),0 表示关闭
+    int sockBusyPollUs = 0;                     //在连接上设置 SO_BUSY_POLL(微秒),0 表示不设置,超过 net.core.busy_read 需要 CAP_NET_ADMIN
+    bool preferBusyPoll = false;                //在连接上设置 SO_PREFER_BUSY_POLL(Linux 5.11+)
+
+    /* CPU 亲和性 */
+    std::string loopCpus;                       //事件循环线程绑定的 CPU 列表(如 "0"),"auto" 按 NUMA 拓扑选择,空表示不绑定
+    std::string workerCpus;                     //工作线程绑定的 CPU 列表(如 "1-7"),"auto" 使用事件循环所在节点的其余 CPU
+
+    /* 请求分发 */
+    bool inlineDispatch = true;                 //命中文件缓存的请求直接在事件循环线程中处理,其余交给线程池
+    size_t fileCacheBytes = 64 * 1024 * 1024;   //静态文件内存缓存的总大小,0 表示不缓存
+    size_t fileCacheMaxFile = 1024 * 1024;      //可以缓存的单个文件的最大字节数
+
+    /* 站点 */
+    std::string htmlPages = "/index,/register,/login,/welcome,/video,/picture"; //省略 .html 后缀访问的页面,逗号分隔
+    std::string mimeTypesFile;                  //额外的 MIME 类型文件(/etc/mime.types 格式),覆盖内置的表,空表示只用内置的表
+
+    /* 访问日志 */
+    bool accessLog = false;                     //是否开启访问日志
+    std::string accessLogPath = "./log/access.log"; //访问日志文件
+    int accessLogSampleRate = 1;                //每 N 个请求记录一个,错误响应总是记录
+    int accessLogFlushMs = 1000;                //批量写入文件的间隔
+
+    /* 监控 */
+    std::string metricsPath;                    //以 Prometheus 文本格式返回监控指标的路径(如 /metrics),空表示不提供
+    int slowRequestMs = 0;                      //耗时超过该毫秒数的请求把各阶段的耗时写入日志,0 表示不记录
+
+    /* 流量录制 */
+    std::string captureFile;                    //把连接上收到的原始请求与到达时间录制到该文件(用 replay 工具回放),空表示不录制
+    size_t captureMaxBytes = 256 * 1024 * 1024; //录制文件的最大字节数,达到后停止录制,0 表示不限制
+
+    /* 平滑升级 */
+    std::string upgradeSocket;                  //交接监听套接字的 Unix 套接字路径,空表示不支持平滑升级
+    int drainTimeoutMs = 30000;                 //交出监听套接字后等待已有连接处理完的最长时间(毫秒)
+
+    /* 多进程 */
+    int workers = 0;                            //prefork 模式的工作进程数,由 master 监管并在崩溃后重启,0 表示单进程
+    bool reusePort = false;                     //设置 SO_REUSEPORT;prefork 模式下每个工作进程各自创建监听套接字,而不是共享 master 的
+
+    bool Set(const std::string &key, const std::string &value, std::string &err);
+
+    std::string Get(const std::string &key) const;
+
+    std::vector <std::string> Diff(const Config &other) const;
+
+    bool Load(const std::string &path, std::string &err);
+
+    bool ParseArgs(const std::vector <std::string> &args, std::string &err);
+
+    Config Resolved() const;
+
+    std::string Dump() const;
+
+    static std::string Usage();
+};
+
 #endif //CCORANGE_WEBSERVER_CONFIG_H
@@ -0,0 +1,130 @@
+#include "filecache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/**
+ * @brief 构造函数,默认不缓存
+ */
+FileCache::FileCache() : capacity_(0), maxFileSize_(0), bytes_(0), generation_(0), hits_(0), misses_(0) {}
+
+/**
+ * @brief 单例
+ * @return
+ */
+FileCache *FileCache::Instance() {
+    static FileCache cache;
+    return &cache;
+}
+
+/**
+ * @brief 设置缓存容量,已缓存的内容会被清空
+ * @param capacity 缓存的总字节数上限,0 表示不缓存
+ * @param maxFileSize 可以缓存的单个文件的最大字节数
+ */
+void FileCache::Init(size_t capacity, size_t maxFileSize) {
+    lock_guard <mutex> locker(mtx_);
+    capacity_ = capacity;
+    maxFileSize_ = maxFileSize;
+    files_.clear();
+    bytes_ = 0;
+    generation_++;
+}
+
+/**
+ * @brief 查找文件内容
+ * @param path 文件的完整路径
+ * @return 未缓存时返回 nullptr
+ */
+shared_ptr<const string> FileCache::Get(const string &path) {
+    if (!Enabled()) { return nullptr; }
+    lock_guard <mutex> locker(mtx_);
+    auto it = files_.find(path);
+    if (it == files_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    return it->second;
+}
+
+/**
+ * @brief 判断文件是否已缓存,不计入命中统计
+ * @param path 文件的完整路径
+ * @return
+ */
+bool FileCache::Contains(const string &path) {
+    if (!Enabled()) { return false; }
+    lock_guard <mutex> locker(mtx_);
+    return files_.count(path) == 1;
+}
+
+/**
+ * @brief 缓存一个文件的内容,文件过大或缓存已满时忽略
+ * @param path 文件的完整路径
+ * @param data 文件内容
+ * @param len 文件长度
+ * @param generation 读取文件之前的缓存代数,缓存在此之后被清空过时忽略,读到的内容可能已经过期
+ */
+void FileCache::Put(const string &path, const char *data, size_t len, uint64_t generation) {
+    if (!Enabled() || len == 0 || len > maxFileSize_ || generation != Generation()) { return; }
+    shared_ptr<const string> content = make_shared<const string>(data, len);
+    lock_guard <mutex> locker(mtx_);
+    if (generation != generation_ || files_.count(path) == 1 || bytes_ + len > capacity_) { return; }
+    files_.emplace(path, move(content));
+    bytes_ += len;
+}
+
+/**
+ * @brief 清空缓存,文件在磁盘上被修改后调用
+ */
+void FileCache::Clear() {
+    lock_guard <mutex> locker(mtx_);
+    files_.clear();
+    bytes_ = 0;
+    generation_++;
+}
+
+/**
+ * @brief 返回已缓存的文件路径,平滑升级时交给新进程预热缓存
+ * @return
+ */
+vector <string> FileCache::Paths() {
+    lock_guard <mutex> locker(mtx_);
+    vector <string> paths;
+    paths.reserve(files_.size());
+    for (const auto &file: files_) {
+        paths.push_back(file.first);
+    }
+    return paths;
+}
+
+/**
+ * @brief 从磁盘读入一组文件放入缓存,新进程启动时用旧进程已缓存的文件列表预热,
+ * 接手流量后不会因为缓存全部未命中而把请求都交给线程池读盘
+ * @param paths 文件的完整路径
+ * @return 放入缓存的文件数
+ */
+size_t FileCache::Warm(const vector <string> &paths) {
+    size_t count = 0;
+    for (const string &path: paths) {
+        if (!Enabled()) { break; }
+        uint64_t generation = Generation();
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { continue; }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+            static_cast<size_t>(st.st_size) <= maxFileSize_) {
+            string data(st.st_size, '\0');
+            if (read(fd, &data[0], data.size()) == st.st_size) {
+                Put(path, data.data(), data.size(), generation);
+                count += Contains(path) ? 1 : 0;
+            }
+        }
+        close(fd);
+    }
+    return count;
+}
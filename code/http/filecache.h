@@ -0,0 +1,57 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+
+//静态文件的内存缓存,以完整路径为键保存小文件的内容
+//命中缓存的请求不需要 stat/open/mmap,可以直接在事件循环线程中处理;
+//文件内容以 shared_ptr 交给响应对象,清空缓存时正在发送的响应不受影响
+class FileCache {
+public:
+    static FileCache *Instance();
+
+    void Init(size_t capacity, size_t maxFileSize);
+
+    bool Enabled() const { return capacity_.load(std::memory_order_relaxed) > 0; }
+
+    std::shared_ptr<const std::string> Get(const std::string &path);
+
+    bool Contains(const std::string &path);
+
+    void Put(const std::string &path, const char *data, size_t len, uint64_t generation);
+
+    void Clear();
+
+    std::vector <std::string> Paths();
+
+    size_t Warm(const std::vector <std::string> &paths);
+
+    uint64_t Generation() const { return generation_.load(std::memory_order_acquire); }
+
+    uint64_t Hits() const { return hits_; }
+
+    uint64_t Misses() const { return misses_; }
+
+private:
+    FileCache();
+
+    ~FileCache() = default;
+
+    std::atomic <size_t> capacity_;     //缓存的总字节数上限,0 表示不缓存
+    std::atomic <size_t> maxFileSize_;  //可以缓存的单个文件的最大字节数
+    size_t bytes_;                      //已缓存的字节数
+    std::atomic <uint64_t> generation_; //每次清空缓存后加一
+
+    std::atomic <uint64_t> hits_;   //命中次数
+    std::atomic <uint64_t> misses_; //未命中次数
+
+    std::unordered_map <std::string, std::shared_ptr<const std::string>> files_;   //路径 -> 文件内容
+    std::mutex mtx_;
+};
+
+#endif //FILE_CACHE_H
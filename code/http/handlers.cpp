@@ -0,0 +1,71 @@
+#include "handlers.h"
+
+#include <memory>
+#include "httprequest.h"
+#include "httpresponse.h"
+#include "sitetables.h"
+#include "../log/log.h"
+#include "../metrics/metrics.h"
+#include "../pool/userstore.h"
+
+using namespace std;
+
+/**
+ * @brief 读取请求路径对应的文件,页面路径表中的页面加上 .html 后缀
+ * @param request
+ * @param params
+ * @param response
+ */
+void StaticHandler::Handle(HttpRequest &request, const RouteParams &, HttpResponse &response) {
+    string path = request.path();
+    HttpRequest::ResolvePath(path, *SiteTables::Current());
+    response.SetPath(path);
+}
+
+/**
+ * @brief 实现了用户登录与注册的逻辑
+ * @param request 表单中的 username 与 password
+ * @param params
+ * @param response
+ */
+void UserFormHandler::Handle(HttpRequest &request, const RouteParams &, HttpResponse &response) {
+    string name = request.GetPost("username");
+    string pwd = request.GetPost("password");
+    bool flag = false;
+    //检查用户名和密码是否为空
+    if (!name.empty() && !pwd.empty()) {
+        LOG_INFO("Verify name:%s", name.c_str());
+        //登录检查密码,注册在用户名未被使用时添加用户;账号存储默认是 MySQL,见 UserStore
+        shared_ptr<UserStore> store = UserStore::Current();
+        flag = isLogin_ ? store->Verify(name, pwd) : store->Register(name, pwd);
+    }
+    LOG_DEBUG("UserVerify %s!!", flag ? "success" : "failed");
+    //验证通过则返回 /welcome.html 页面,否则返回 /error.html 页面
+    response.SetPath(flag ? "/welcome.html" : "/error.html");
+}
+
+/**
+ * @brief 汇总当前的监控指标作为响应正文
+ * @param request
+ * @param params
+ * @param response
+ */
+void MetricsHandler::Handle(HttpRequest &, const RouteParams &, HttpResponse &response) {
+    response.SetContent(make_shared<const string>(Metrics::Instance()->Render()),
+                        "text/plain; version=0.0.4; charset=utf-8");
+}
+
+/**
+ * @brief 添加自带页面使用的路由: 登录与注册表单(表单提交到 /login 与 /register,也接受 .html 后缀),
+ * 其余请求读取静态文件
+ * @param router
+ * @param err
+ * @return
+ */
+bool AddDefaultRoutes(Router &router, string &err) {
+    shared_ptr<Handler> login = make_shared<UserFormHandler>(true);
+    shared_ptr<Handler> reg = make_shared<UserFormHandler>(false);
+    router.SetFallback(make_shared<StaticHandler>());
+    return router.Add("POST", "/login", login, err) && router.Add("POST", "/login.html", login, err) &&
+           router.Add("POST", "/register", reg, err) && router.Add("POST", "/register.html", reg, err);
+}
@@ -0,0 +1,34 @@
+#ifndef HANDLERS_H
+#define HANDLERS_H
+
+#include <string>
+#include "router.h"
+
+//内置的处理对象
+
+//静态文件: 把页面路径(如 /login)转换为文件路径(/login.html)后读取该文件,作为没有路由匹配时的处理对象
+class StaticHandler : public Handler {
+public:
+    void Handle(HttpRequest &request, const RouteParams &params, HttpResponse &response) override;
+};
+
+//登录或注册表单: 通过 UserStore 验证或注册,成功时返回 /welcome.html,否则返回 /error.html
+class UserFormHandler : public Handler {
+public:
+    explicit UserFormHandler(bool isLogin) : isLogin_(isLogin) {}
+
+    void Handle(HttpRequest &request, const RouteParams &params, HttpResponse &response) override;
+
+private:
+    bool isLogin_;      //true 登录 false 注册
+};
+
+//以 Prometheus 文本格式返回监控指标,在抓取时汇总生成,不读取文件
+class MetricsHandler : public Handler {
+public:
+    void Handle(HttpRequest &request, const RouteParams &params, HttpResponse &response) override;
+};
+
+bool AddDefaultRoutes(Router &router, std::string &err);
+
+#endif //HANDLERS_H
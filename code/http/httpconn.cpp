@@ -1,9 +1,12 @@
 #include "httpconn.h"
+#include "../metrics/probes.h"
 
 using namespace std;
 
 const char *HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
+std::atomic<bool> HttpConn::draining;
+std::atomic<int> HttpConn::slowRequestMs;
 bool HttpConn::isET;
 
 /**
@@ -13,6 +16,15 @@ HttpConn::HttpConn() {
     fd_ = -1;       //Socket文件描述符
     addr_ = {0};    //客户端地址信息
     isClose_ = true;//连接是否关闭
+    keepAlive_ = false;
+    reqStarted_ = false;
+    respPending_ = false;
+    respBytes_ = 0;
+    lastLatencyUs_ = 0;
+    memset(stageNs_, 0, sizeof(stageNs_));
+    queued_ = false;
+    idle_ = false;
+    captureId_ = 0;
 };
 
 /**
@@ -37,6 +49,14 @@ void HttpConn::init(int fd, const sockaddr_in &addr) {
     writeBuff_.RetrieveAll();
     readBuff_.RetrieveAll();
     isClose_ = false;//未关闭连接
+    keepAlive_ = false;
+    reqStarted_ = false;
+    respPending_ = false;
+    lastLatencyUs_ = 0;
+    memset(stageNs_, 0, sizeof(stageNs_));
+    queued_ = false;
+    idle_ = true;   //新连接在发来第一个请求前也是空闲的
+    captureId_ = TrafficCapture::Instance()->Open();    //没有在录制时为 0
     //确保之前缓存的数据不会对新的连接产生影响
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int) userCount);
 }
@@ -51,8 +71,13 @@ void HttpConn::Close() {
     if (isClose_ == false) {
         //如果连接没用被关闭
         isClose_ = true;    //表示已经关闭连接
+        idle_.store(false, std::memory_order_release);  //已经关闭的连接不能再被当作空闲连接淘汰
         userCount--;        //客户端数量减一
         close(fd_);     //关闭文件描述符
+        if (captureId_ != 0) {
+            TrafficCapture::Instance()->Closed(captureId_);
+            captureId_ = 0;
+        }
         //日志记录
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int) userCount);
     }
@@ -91,6 +116,27 @@ int HttpConn::GetPort() const {
     return addr_.sin_port;
 }
 
+/**
+ * @brief 记录 accept 阶段的耗时,连接加入 epoll 之后由事件循环线程调用
+ * 慢请求日志中只有连接上的第一个请求带有这一项
+ * @param ready 监听事件就绪的时间
+ */
+void HttpConn::RecordAccept(std::chrono::steady_clock::time_point ready) {
+    stageNs_[Metrics::STAGE_ACCEPT] = ElapsedNs_(ready, std::chrono::steady_clock::now());
+    Metrics::Observe(Metrics::STAGE_ACCEPT, stageNs_[Metrics::STAGE_ACCEPT]);
+}
+
+/**
+ * @brief 工作线程开始处理连接时记录排队的耗时,不是从线程池进入时什么也不做
+ */
+void HttpConn::MarkDequeued() {
+    if (!queued_) { return; }
+    queued_ = false;
+    uint64_t ns = ElapsedNs_(queuedAt_, std::chrono::steady_clock::now());
+    stageNs_[Metrics::STAGE_QUEUE] += ns;
+    Metrics::Observe(Metrics::STAGE_QUEUE, ns);
+}
+
 /**
  * @brief 从客户端连接中读取数据
  * @param saveErrno 保存读取数据时发生的错误信息
@@ -104,6 +150,16 @@ ssize_t HttpConn::read(int *saveErrno) {
         if (len <= 0) {
             break;
         }
+        Metrics::Add(Metrics::HTTP_RECEIVED_BYTES, len);
+        if (captureId_ != 0) {
+            //本次读到的数据位于读缓冲区的末尾
+            TrafficCapture::Instance()->Data(captureId_, readBuff_.BeginWriteConst() - len, len);
+        }
+        if (!reqStarted_) {
+            //记录请求开始的时间,用于访问日志中的耗时
+            reqStarted_ = true;
+            reqStart_ = std::chrono::steady_clock::now();
+        }
     } while (isET); //表示当前是否使用了边缘触发模式进行读取
     return len;
 }
@@ -115,9 +171,15 @@ ssize_t HttpConn::read(int *saveErrno) {
  */
 ssize_t HttpConn::write(int *saveErrno) {
     ssize_t len = -1;
+    //响应头与文件内容在同一次调用中交给内核,小响应的头和正文会合并在同一个 TCP 段中发出,
+    //不需要 TCP_CORK 或 MSG_MORE;对端已经关闭时返回 EPIPE 而不是触发 SIGPIPE
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov_;
+    msg.msg_iovlen = iovCnt_;
     do {
         //将保存在iov中的数据写入到文件描述符fd中,并将返回的字节数保存在len中
-        len = writev(fd_, iov_, iovCnt_);
+        len = sendmsg(fd_, &msg, MSG_NOSIGNAL);
         if (len <= 0) {
             *saveErrno = errno;
             break;
@@ -136,9 +198,94 @@ ssize_t HttpConn::write(int *saveErrno) {
             writeBuff_.Retrieve(len);
         }
     } while (isET || ToWriteBytes() > 10240);   //判断当前待写入数据的大小是否超过了 10KB
+    if (respPending_ && ToWriteBytes() == 0) {
+        //响应发送完毕
+        respPending_ = false;
+        Metrics::AddResponse(response_.Code(), respBytes_);
+        FinishStages_(std::chrono::steady_clock::now());
+        WEBSERVER_PROBE4(write_done, fd_, response_.Code(), respBytes_, lastLatencyUs_);
+        LogAccess_();
+    }
     return len;
 }
 
+/**
+ * @brief 响应发送完毕时记录发送与总耗时,超过 slowRequestMs 时把各阶段的耗时写入日志
+ * @param now
+ */
+void HttpConn::FinishStages_(std::chrono::steady_clock::time_point now) {
+    stageNs_[Metrics::STAGE_WRITE] = ElapsedNs_(writeStart_, now);
+    stageNs_[Metrics::STAGE_TOTAL] = reqStarted_ ? ElapsedNs_(reqStart_, now) : 0;
+    Metrics::Observe(Metrics::STAGE_WRITE, stageNs_[Metrics::STAGE_WRITE]);
+    if (reqStarted_) {
+        Metrics::Observe(Metrics::STAGE_TOTAL, stageNs_[Metrics::STAGE_TOTAL]);
+    }
+    lastLatencyUs_ = static_cast<uint32_t>(stageNs_[Metrics::STAGE_TOTAL] / 1000);
+    int slowMs = slowRequestMs.load(std::memory_order_relaxed);
+    if (slowMs > 0 && lastLatencyUs_ >= static_cast<uint32_t>(slowMs) * 1000) {
+        LOG_WARN("Slow request %s %s %d from %s:%d, %uus: accept %lluus, queue %lluus, parse %lluus, "
+                 "file %lluus, write %lluus, %zu bytes",
+                 request_.method().c_str(), request_.path().c_str(), response_.Code(), GetIP(), GetPort(),
+                 lastLatencyUs_, (unsigned long long) stageNs_[Metrics::STAGE_ACCEPT] / 1000,
+                 (unsigned long long) stageNs_[Metrics::STAGE_QUEUE] / 1000,
+                 (unsigned long long) stageNs_[Metrics::STAGE_PARSE] / 1000,
+                 (unsigned long long) stageNs_[Metrics::STAGE_FILE] / 1000,
+                 (unsigned long long) stageNs_[Metrics::STAGE_WRITE] / 1000, respBytes_);
+    }
+    memset(stageNs_, 0, sizeof(stageNs_));
+}
+
+/**
+ * @brief 响应发送完毕后向访问日志追加一条记录
+ */
+void HttpConn::LogAccess_() {
+    AccessLog *accessLog = AccessLog::Instance();
+    if (!accessLog->IsOpen() || !accessLog->Sample(response_.Code())) {
+        reqStarted_ = false;
+        return;
+    }
+    AccessRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.latencyUs = lastLatencyUs_;
+    rec.usec = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    rec.bytes = respBytes_;
+    rec.ip = addr_.sin_addr.s_addr;
+    rec.status = static_cast<uint16_t>(response_.Code());
+    //过长时截断,保留结尾的 '\0'(rec 已经清零)
+    memcpy(rec.method, request_.method().data(), min(request_.method().size(), sizeof(rec.method) - 1));
+    memcpy(rec.path, request_.path().data(), min(request_.path().size(), sizeof(rec.path) - 1));
+    accessLog->Record(rec);
+    reqStarted_ = false;
+}
+
+/**
+ * @brief 判断读缓冲区中的请求能否在事件循环线程中直接处理
+ * 只有完整的、不带请求体的 GET 请求,且请求的文件已经在内存缓存中时才返回 true,
+ * 处理它不会访问数据库或磁盘
+ * @return
+ */
+bool HttpConn::CanServeInline() const {
+    const char *begin = readBuff_.Peek();
+    const char *end = readBuff_.BeginWriteConst();
+    const char CRLF2[] = "\r\n\r\n";
+    if (end - begin < 4 || memcmp(begin, "GET ", 4) != 0 ||
+        search(begin, end, CRLF2, CRLF2 + 4) == end) {
+        return false;
+    }
+    const char *pathEnd = static_cast<const char *>(memchr(begin + 4, ' ', end - begin - 4));
+    if (pathEnd == nullptr) { return false; }
+    string path(begin + 4, pathEnd);
+    //只有路由到静态文件的请求才可能命中缓存
+    const Router *router = Router::Current();
+    RouteParams params;
+    if (router == nullptr || router->Match("GET", path, params) != router->Fallback()) {
+        return false;
+    }
+    HttpRequest::ResolvePath(path, *SiteTables::Current());
+    return FileCache::Instance()->Contains(srcDir + path);
+}
+
 /**
  * HTTP连接处理函数
  * @brief 解析HTTP请求并返回HTTP响应，其中包括响应头和文件内容
@@ -150,15 +297,41 @@ bool HttpConn::process() {
     //2.检查读缓冲区是否有数据可读
     if (readBuff_.ReadableBytes() <= 0) {
         return false;
+    }
+    auto parseStart = std::chrono::steady_clock::now();
+    if (!reqStarted_) {
+        //流水线中的后续请求已经在读缓冲区中,不会再经过 read,从开始解析时计时
+        reqStarted_ = true;
+        reqStart_ = parseStart;
+    }
+    bool parsed = request_.parse(readBuff_);
+    auto parseEnd = std::chrono::steady_clock::now();
+    stageNs_[Metrics::STAGE_PARSE] = ElapsedNs_(parseStart, parseEnd);
+    Metrics::Observe(Metrics::STAGE_PARSE, stageNs_[Metrics::STAGE_PARSE]);
+    WEBSERVER_PROBE4(request_parsed, fd_, parsed, request_.method().c_str(), request_.path().c_str());
     //3.调用 request_.parse(readBuff_) 解析HTTP请求
-    } else if (request_.parse(readBuff_)) {
+    if (parsed) {
     //4.解析成功,调用response_.Init初始化HTTP响应对象，200表示响应状态码
         LOG_DEBUG("%s", request_.path().c_str());
-        //srcDir 是服务器根目录、request_.path() 是请求的文件路径、request_.IsKeepAlive() 表示是否保持长连接
-        response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
+        //srcDir 是服务器根目录、request_.path() 是请求的文件路径、keepAlive_ 表示是否保持长连接,
+        //平滑升级时旧进程不再保持连接,客户端发送下一个请求时会重新连接到新进程
+        keepAlive_ = request_.IsKeepAlive() && !draining;
+        Metrics::Add(Metrics::HTTP_REQUESTS);
+        //按请求方法与路径查找处理对象(登录、注册、监控指标等),没有路由匹配时读取静态文件
+        const Router *router = Router::Current();
+        RouteParams params;
+        Handler *handler = router ? router->Match(request_.method(), request_.path(), params) : nullptr;
+        if (handler) {
+            response_.Init(srcDir, request_.path(), keepAlive_, 200);
+            handler->Handle(request_, params, response_);
+        } else {
+            response_.Init(srcDir, request_.path(), keepAlive_, 404);
+        }
     } else {
     //5.解析失败,调用response_.Init初始化HTTP响应对象，400表示响应状态码
+        keepAlive_ = request_.IsKeepAlive() && !draining;
         response_.Init(srcDir, request_.path(), false, 400);
+        Metrics::Add(Metrics::HTTP_BAD_REQUESTS);
     }
 
     //6.调用 response_.MakeResponse(writeBuff_) 生成HTTP响应消息体
@@ -176,6 +349,12 @@ bool HttpConn::process() {
         iov_[1].iov_len = response_.FileLen();
         iovCnt_ = 2;
     }
+    respBytes_ = ToWriteBytes();
+    respPending_ = true;
+    writeStart_ = std::chrono::steady_clock::now();
+    stageNs_[Metrics::STAGE_FILE] = ElapsedNs_(parseEnd, writeStart_);
+    Metrics::Observe(Metrics::STAGE_FILE, stageNs_[Metrics::STAGE_FILE]);
+    WEBSERVER_PROBE3(response_built, fd_, response_.Code(), respBytes_);
     //7.打印服务器日志
     LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen(), iovCnt_, ToWriteBytes());
     return true;
@@ -2,18 +2,25 @@
 #define HTTP_CONN_H
 
 #include <sys/types.h>
-#include <sys/uio.h>     // readv/writev
+#include <sys/uio.h>     // readv
+#include <sys/socket.h>  // sendmsg
 #include <arpa/inet.h>   // sockaddr_in
 #include <stdlib.h>      // atoi()
 #include <errno.h>
+#include <chrono>
 
 #include "../log/log.h"
+#include "../log/accesslog.h"
+#include "../log/trafficcapture.h"
 #include "../pool/sqlconnRAII.h"
 #include "../buffer/buffer.h"
+#include "../metrics/metrics.h"
 #include "httprequest.h"
 #include "httpresponse.h"
+#include "router.h"
 
-class HttpConn {
+//对象按缓存行对齐,开头的一条缓存行只放事件循环频繁访问的热数据,缓冲区、请求与响应等冷数据在其后
+class alignas(64) HttpConn {
 public:
     HttpConn();
 
@@ -37,6 +44,37 @@ public:
 
     bool process();
 
+    bool CanServeInline() const;
+
+    /**
+     * @brief 读缓冲区中是否还有未处理的数据(长连接上客户端提前发来的下一个请求)
+     * @return
+     */
+    bool HasPendingRequest() const { return readBuff_.ReadableBytes() > 0; }
+
+    /**
+     * @brief 标记连接是否空闲(没有未处理的请求,正在等待客户端发来下一个请求)
+     * 由即将重新注册读事件的线程置为 true,由事件循环线程在收到读事件时置为 false
+     * @param idle
+     */
+    void SetIdle(bool idle) { idle_.store(idle, std::memory_order_release); }
+
+    bool IsIdle() const { return idle_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 上一个响应从读到请求到发送完毕的耗时,微秒
+     * @return
+     */
+    uint32_t LastLatencyUs() const { return lastLatencyUs_; }
+
+    /**
+     * @brief 当前响应的文件内容是否来自内存缓存
+     * @return
+     */
+    bool IsCachedResponse() const {
+        return response_.IsCached();
+    }
+
     /**
      * @brief 返回写缓冲区中的字节数
      * @return
@@ -50,28 +88,65 @@ public:
      * @return
      */
     bool IsKeepAlive() const {
-        return request_.IsKeepAlive();
+        return keepAlive_;
     }
 
+    bool IsClosed() const { return isClose_; }
+
+    void RecordAccept(std::chrono::steady_clock::time_point ready);
+
+    /**
+     * @brief 交给线程池之前记录入队时间,工作线程开始处理时调用 MarkDequeued 计算排队耗时
+     */
+    void MarkQueued() {
+        queuedAt_ = std::chrono::steady_clock::now();
+        queued_ = true;
+    }
+
+    void MarkDequeued();
+
     static bool isET;                   //标记是否采用 ET 模式，即边缘触发模式
     static const char *srcDir;          //HTTP 服务器的根目录
     static std::atomic<int> userCount;  //当前连接的 HTTP 客户端数目的原子变量
+    static std::atomic<bool> draining;  //平滑升级时置为 true,之后的响应都带 Connection: close
+    static std::atomic<int> slowRequestMs;  //耗时超过该毫秒数的请求记录各阶段耗时,0 表示不记录
 
 private:
+    void FinishStages_(std::chrono::steady_clock::time_point now);
 
-    int fd_;                    //HTTP 连接使用的文件描述符
-    struct sockaddr_in addr_;   //连接的客户端 IP 和端口号
+    void LogAccess_();
 
-    bool isClose_;              //标记连接是否关闭
+    static uint64_t ElapsedNs_(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+    }
 
+    //热数据: 事件循环处理每个事件都会读写的字段,集中在对象开头的一条缓存行(64 字节)中
+    int fd_;                    //HTTP 连接使用的文件描述符
     int iovCnt_;                //结构体数组的元素个数
+    bool isClose_;              //标记连接是否关闭
+    bool keepAlive_;            //当前响应发送完后是否保持连接
+    bool queued_;               //是否在线程池队列中
+    bool reqStarted_;           //当前请求是否已经开始计时
+    bool respPending_;          //是否有尚未发送完毕的响应
+    std::atomic<bool> idle_;    //连接是否空闲,过载时优先关闭空闲的长连接
+    uint32_t lastLatencyUs_;    //上一个响应的耗时,微秒
     struct iovec iov_[2];       //结构体数组，用于将数据从缓冲区读到文件描述符或者从文件描述符写入缓冲区
+    uint64_t captureId_;        //流量录制中的连接编号,0 表示不录制
+
+    //冷数据: 只在读写和处理请求时访问,从第二条缓存行开始
+    struct sockaddr_in addr_;   //连接的客户端 IP 和端口号
 
     Buffer readBuff_; // 读缓冲区，用于存储从文件描述符读取到的数据
     Buffer writeBuff_; // 写缓冲区，用于存储需要写入文件描述符的数据
 
     HttpRequest request_;       //HttpRequest 类的对象，存储从客户端接收到的 HTTP 请求
     HttpResponse response_;     //HttpResponse 类的对象，用于生成 HTTP 响应
+
+    std::chrono::steady_clock::time_point reqStart_;   //开始读取当前请求的时间,流水线中的后续请求为开始解析的时间
+    size_t respBytes_;          //当前响应的总字节数
+    uint64_t stageNs_[Metrics::STAGE_COUNT];    //当前请求各阶段的耗时,纳秒,用于记录慢请求
+    std::chrono::steady_clock::time_point queuedAt_;   //交给线程池的时间
+    std::chrono::steady_clock::time_point writeStart_; //响应生成完毕的时间
 };
 
 
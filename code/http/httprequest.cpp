@@ -2,14 +2,6 @@
 
 using namespace std;
 
-const unordered_set<string> HttpRequest::DEFAULT_HTML{
-        "/index", "/register", "/login",
-        "/welcome", "/video", "/picture",};
-
-const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG{
-        {"/register.html", 0},
-        {"/login.html",    1},};
-
 /**
  * @brief 初始化 HttpRequest 对象的成员变量
  */
@@ -59,7 +51,6 @@ bool HttpRequest::parse(Buffer &buff) {
                 if (!ParseRequestLine_(line)) {
                     return false;
                 }
-                ParsePath_();
                 break;
             case HEADERS:
                 ParseHeader_(line);
@@ -73,7 +64,11 @@ bool HttpRequest::parse(Buffer &buff) {
             default:
                 break;
         }
-        if (lineEnd == buff.BeginWrite()) { break; }
+        if (lineEnd == buff.BeginWrite()) {
+            //没有以 CRLF 结尾的请求体也要移出缓冲区,否则会留给同一长连接上的下一个请求
+            if (state_ == FINISH) { buff.RetrieveUntil(lineEnd); }
+            break;
+        }
         //每次解析完一行数据后，通过RetrieveUntil()函数从缓冲区中移除已读数据
         buff.RetrieveUntil(lineEnd + 2);
     }
@@ -83,22 +78,20 @@ bool HttpRequest::parse(Buffer &buff) {
 }
 
 /**
- * @brief 根据请求的 path_ 解析出请求的文件路径
+ * @brief 把请求路径转换为文件路径,由读取静态文件的 StaticHandler 调用,
+ * 事件循环线程在解析请求前判断是否命中缓存时也会用到
+ * @param path
+ * @param tables 页面路径表
  */
-void HttpRequest::ParsePath_() {
-    //如果请求的 path_ 为根路径 /，则将文件路径设置为 /index.html
-    if (path_ == "/") {
-        path_ = "/index.html";
+void HttpRequest::ResolvePath(string &path, const SiteTables &tables) {
+    //如果请求的 path 为根路径 /，则将文件路径设置为 /index.html
+    if (path == "/") {
+        path = "/index.html";
     } else {
-        //如果请求的 path_ 在默认 HTML 文件集合 DEFAULT_HTML 中，那么将文件路径修改为以 .html 结尾的格式
-        //DEFAULT_HTML 是一个无序集合，用于存储默认的 HTML 文件路径
-        //默认情况下，如果请求的 path_ 不在 DEFAULT_HTML 集合中，则默认请求的是静态文件，例如图片、CSS 样式表等
-        for (auto &item: DEFAULT_HTML) {    //使用 for 循环遍历默认 HTML 文件集合 DEFAULT_HTML
-            //如果在集合中找到请求的 path_，则将文件路径修改为以 .html 结尾的格式
-            if (item == path_) {
-                path_ += ".html";
-                break;
-            }
+        //如果请求的 path 是页面路径表中的页面(可以在配置中修改),那么将文件路径修改为以 .html 结尾的格式
+        //默认情况下，如果请求的 path 不在表中，则默认请求的是静态文件，例如图片、CSS 样式表等
+        if (tables.IsPage(path)) {
+            path += ".html";
         }
     }
 }
@@ -187,31 +180,13 @@ int HttpRequest::ConverHex(char ch) {
 }
 
 /**
- * @brief 解析POST请求中的数据，并根据请求的URL path 和 POST 数据中的内容，
- * 判断是否有特定的关键字（即 "DEFAULT_HTML_TAG" 字典中是否存在相应的键值），
- * 然后执行特定的操作
+ * @brief 解析POST请求中的数据,表单交给路由到的处理对象(如登录与注册)读取
  */
 void HttpRequest::ParsePost_() {
     //如果当前是 POST 请求且 Content-Type 为 application/x-www-form-urlencoded
     if (method_ == "POST" && header_["Content-Type"] == "application/x-www-form-urlencoded") {
         //调用 ParseFromUrlencoded_() 方法解析 POST 数据
         ParseFromUrlencoded_();
-        //如果在 DEFAULT_HTML_TAG 字典中找到了请求的 URL path 对应的键
-        if (DEFAULT_HTML_TAG.count(path_)) {
-            //说明该请求是一个特定的请求（如登录请求或者注册请求）
-            int tag = DEFAULT_HTML_TAG.find(path_)->second;
-            LOG_DEBUG("Tag:%d", tag);
-            if (tag == 0 || tag == 1) {
-                bool isLogin = (tag == 1);
-                //如果是登录请求，则需要调用 UserVerify() 方法进行验证
-                if (UserVerify(post_["username"], post_["password"], isLogin)) {
-                    //验证通过则返回 /welcome.html 页面
-                    path_ = "/welcome.html";
-                } else
-                    //否则返回 /error.html 页面
-                    path_ = "/error.html";
-            }
-        }
     }
 }
 
@@ -271,86 +246,10 @@ void HttpRequest::ParseFromUrlencoded_() {
 }
 
 /**
- * @brief 实现了用户登录验证的逻辑
- * @param name
- * @param pwd
- * @param isLogin
- * @return
- */
-bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin) {
-    //检查用户名和密码是否为空
-    if (name == "" || pwd == "") { return false; }
-    LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
-    //与MySQL数据库建立连接，并构建SQL查询语句
-    MYSQL *sql;
-    SqlConnRAII(&sql, SqlConnPool::Instance());
-    assert(sql);
-
-    bool flag = false;              //定义验证标志,默认为验证失败
-    unsigned int j = 0;
-    char order[256] = {0};          //定义 SQL 语句的字符数组
-    MYSQL_FIELD *fields = nullptr;  //定义 MySQL 查询结果字段对象
-    MYSQL_RES *res = nullptr;       //定义 MySQL 查询结果对象
-
-    if (!isLogin) { flag = true; }  // 如果不是登录行为，则直接返回验证成功
-    /* 查询用户及密码 */
-    //构造查询语句
-    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
-    LOG_DEBUG("%s", order);
-
-    // 执行查询语句
-    if (mysql_query(sql, order)) {
-        //检查用户名和密码是否与数据库中的匹配
-        mysql_free_result(res);
-        return false;
-    }
-    res = mysql_store_result(sql);  // 存储查询结果
-    j = mysql_num_fields(res);            // 获取查询结果的字段数
-    fields = mysql_fetch_fields(res);     // 获取查询结果的字段对象
-
-    // 遍历查询结果
-    while (MYSQL_ROW row = mysql_fetch_row(res)) {
-        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        string password(row[1]);       // 获取密码
-        if (isLogin) {                    // 如果是登录行为
-            if (pwd == password) { flag = true; }   // 如果密码正确，则验证成功
-            else {                        // 如果密码不正确
-                flag = false;
-                LOG_DEBUG("pwd error!");  // 打印密码错误信息
-            }
-        } else {                          // 如果是注册行为
-            flag = false;
-            LOG_DEBUG("user used!");      // 打印用户名已被使用信息
-        }
-    }
-    mysql_free_result(res);         // 释放查询结果
-
-    /* 注册行为 且 用户名未被使用*/
-    if (!isLogin && flag == true) {       // 如果是注册行为且用户名未被使用
-        LOG_DEBUG("regirster!");          // 打印注册成功信息
-        bzero(order, 256);          // 将 SQL 语句清空
-        // 构造插入语句
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG("%s", order);           // 打印插入语句
-        //通过mysql_query()函数将新用户的信息插入到user表中
-        if (mysql_query(sql, order)) {  // 执行插入语句
-            LOG_DEBUG("Insert error!");
-            flag = false;
-        }
-        flag = true;
-    }
-    //释放MySQL连接
-    SqlConnPool::Instance()->FreeConn(sql);
-    LOG_DEBUG("UserVerify success!!");
-    //返回flag表示用户是否验证成功
-    return flag;
-}
-
-/**
- * @brief
+ * @brief 返回成员的引用,不复制字符串,请求再次 Init 之前一直有效(探针直接使用其中的指针)
  * @return
  */
-std::string HttpRequest::path() const {
+const std::string &HttpRequest::path() const {
     return path_;
 }
 
@@ -366,7 +265,7 @@ std::string &HttpRequest::path() {
  * @brief
  * @return
  */
-std::string HttpRequest::method() const {
+const std::string &HttpRequest::method() const {
     return method_;
 }
 
@@ -374,7 +273,7 @@ std::string HttpRequest::method() const {
  * @brief
  * @return
  */
-std::string HttpRequest::version() const {
+const std::string &HttpRequest::version() const {
     return version_;
 }
 
@@ -6,12 +6,10 @@
 #include <string>
 #include <regex>
 #include <errno.h>
-#include <mysql/mysql.h>  //mysql
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
-#include "../pool/sqlconnpool.h"
-#include "../pool/sqlconnRAII.h"
+#include "sitetables.h"
 
 //HTTP 请求的类
 class HttpRequest {
@@ -42,13 +40,13 @@ public:
 
     bool parse(Buffer &buff);
 
-    std::string path() const;
+    const std::string &path() const;
 
     std::string &path();
 
-    std::string method() const;
+    const std::string &method() const;
 
-    std::string version() const;
+    const std::string &version() const;
 
     std::string GetPost(const std::string &key) const;
 
@@ -56,6 +54,8 @@ public:
 
     bool IsKeepAlive() const;
 
+    static void ResolvePath(std::string &path, const SiteTables &tables);
+
     /* 
     todo 
     void HttpConn::ParseFormData() {}
@@ -69,22 +69,15 @@ private:
 
     void ParseBody_(const std::string &line);
 
-    void ParsePath_();
-
     void ParsePost_();
 
     void ParseFromUrlencoded_();
 
-    static bool UserVerify(const std::string &name, const std::string &pwd, bool isLogin);
-
     PARSE_STATE state_;
     std::string method_, path_, version_, body_;
     std::unordered_map <std::string, std::string> header_;
     std::unordered_map <std::string, std::string> post_;
 
-    static const std::unordered_set <std::string> DEFAULT_HTML;
-    static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
-
     static int ConverHex(char ch);
 };
 
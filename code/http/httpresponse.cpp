@@ -2,28 +2,6 @@
 
 using namespace std;
 
-const unordered_map <string, string> HttpResponse::SUFFIX_TYPE = {
-        {".html",  "text/html"},
-        {".xml",   "text/xml"},
-        {".xhtml", "application/xhtml+xml"},
-        {".txt",   "text/plain"},
-        {".rtf",   "application/rtf"},
-        {".pdf",   "application/pdf"},
-        {".word",  "application/nsword"},
-        {".png",   "image/png"},
-        {".gif",   "image/gif"},
-        {".jpg",   "image/jpeg"},
-        {".jpeg",  "image/jpeg"},
-        {".au",    "audio/basic"},
-        {".mpeg",  "video/mpeg"},
-        {".mpg",   "video/mpeg"},
-        {".avi",   "video/x-msvideo"},
-        {".gz",    "application/x-gzip"},
-        {".tar",   "application/x-tar"},
-        {".css",   "text/css "},
-        {".js",    "text/javascript "},
-};
-
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
         {200, "OK"},
         {400, "Bad Request"},
@@ -47,6 +25,7 @@ HttpResponse::HttpResponse() {
     isKeepAlive_ = false;
     mmFile_ = nullptr;
     mmFileStat_ = {0};
+    cacheGeneration_ = 0;
 };
 
 /**
@@ -65,7 +44,7 @@ HttpResponse::~HttpResponse() {
  */
 void HttpResponse::Init(const string &srcDir, string &path, bool isKeepAlive, int code) {
     assert(srcDir != "");           //判断 srcDir 是否为空
-    if (mmFile_) { UnmapFile(); }   //判断之前是否有文件映射到内存中
+    UnmapFile();                    //释放之前映射到内存中(或来自缓存)的文件
     //将输入参数分别赋值给对应的数据成员
     code_ = code;
     isKeepAlive_ = isKeepAlive;
@@ -73,6 +52,19 @@ void HttpResponse::Init(const string &srcDir, string &path, bool isKeepAlive, in
     srcDir_ = srcDir;
     mmFile_ = nullptr;
     mmFileStat_ = {0};
+    tables_ = SiteTables::Current();
+    contentType_.clear();
+}
+
+/**
+ * @brief 使用内存中生成的内容作为响应正文,而不是读取文件,在 Init 之后、MakeResponse 之前调用
+ * 内容与缓存的文件一样以 shared_ptr 持有,发送方式相同
+ * @param content 响应正文
+ * @param type Content-type
+ */
+void HttpResponse::SetContent(shared_ptr<const string> content, const string &type) {
+    cached_ = move(content);
+    contentType_ = type;
 }
 
 /**
@@ -80,9 +72,18 @@ void HttpResponse::Init(const string &srcDir, string &path, bool isKeepAlive, in
  * @param buff 输出缓冲区
  */
 void HttpResponse::MakeResponse(Buffer &buff) {
+    //先记下缓存的代数,读取文件期间缓存被清空(文件可能已经修改)时不会把读到的内容放入缓存
+    cacheGeneration_ = FileCache::Instance()->Generation();
+    //文件已经缓存时说明它存在且可读,省去 stat
+    if ((code_ == -1 || code_ == 200) && !cached_) {
+        cached_ = FileCache::Instance()->Get(srcDir_ + path_);
+    }
+    if (cached_) {
+        code_ = 200;
+        mmFileStat_.st_size = cached_->size();
     /* 判断请求的资源文件 */
     //通过 stat 函数获取请求的资源文件的属性信息
-    if (stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
+    } else if (stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
         //请求的资源文件不存在或者是一个目录，则设置响应状态码为 404（Not Found）
         code_ = 404;
     } else if (!(mmFileStat_.st_mode & S_IROTH)) {
@@ -93,6 +94,10 @@ void HttpResponse::MakeResponse(Buffer &buff) {
         code_ = 200;
     }
     ErrorHtml_();           //根据响应状态码生成对应的错误页面
+    //错误页面也可能已经缓存;请求的文件上面已经查找过,不再重复查找,否则每次未命中都会计两次
+    if (!cached_ && CODE_PATH.count(code_) == 1) {
+        cached_ = FileCache::Instance()->Get(srcDir_ + path_);
+    }
     //向输出缓冲区添加状态行、响应头和响应内容
     AddStateLine_(buff);
     AddHeader_(buff);
@@ -106,6 +111,9 @@ void HttpResponse::MakeResponse(Buffer &buff) {
  * @return
  */
 char *HttpResponse::File() {
+    if (cached_) {
+        return const_cast<char *>(cached_->data());
+    }
     return mmFile_;
 }
 
@@ -173,6 +181,11 @@ void HttpResponse::AddHeader_(Buffer &buff) {
  * @param buff
  */
 void HttpResponse::AddContent_(Buffer &buff) {
+    if (cached_) {
+        mmFileStat_.st_size = cached_->size();
+        buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
+        return;
+    }
     //首先通过调用open()函数打开文件，并返回文件描述符srcFd
     int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
     if (srcFd < 0) {
@@ -193,6 +206,8 @@ void HttpResponse::AddContent_(Buffer &buff) {
     mmFile_ = (char *) mmRet;
     //关闭文件
     close(srcFd);
+    //把小文件放入缓存,之后的请求不再需要打开和映射文件
+    FileCache::Instance()->Put(srcDir_ + path_, mmFile_, mmFileStat_.st_size, cacheGeneration_);
     //将文件长度添加到HTTP响应头部，内容添加到HTTP响应体中
     buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
 }
@@ -201,6 +216,7 @@ void HttpResponse::AddContent_(Buffer &buff) {
  * @brief 取消当前文件的内存映射
  */
 void HttpResponse::UnmapFile() {
+    cached_.reset();
     if (mmFile_) {
         //调用munmap()函数，将文件内存映射取消
         munmap(mmFile_, mmFileStat_.st_size);
@@ -214,6 +230,7 @@ void HttpResponse::UnmapFile() {
  * @return
  */
 string HttpResponse::GetFileType_() {
+    if (!contentType_.empty()) { return contentType_; }
     /* 判断文件类型 */
     //从请求资源路径中找到最后一个 "." 符号的位置
     string::size_type idx = path_.find_last_of('.');
@@ -221,14 +238,8 @@ string HttpResponse::GetFileType_() {
         //如果找不到，返回默认的类型 "text/plain"
         return "text/plain";
     }
-    //如果找到了，将后缀名截取下来，再查找 SUFFIX_TYPE 表中对应的类型
-    string suffix = path_.substr(idx);
-    if (SUFFIX_TYPE.count(suffix) == 1) {
-        //如果能找到对应的类型，返回对应的类型
-        return SUFFIX_TYPE.find(suffix)->second;
-    }
-    //否则也返回默认的类型 "text/plain"
-    return "text/plain";
+    //如果找到了，将后缀名截取下来，再查找 MIME 类型表中对应的类型，找不到时也返回 "text/plain"
+    return tables_->MimeType(path_.substr(idx));
 }
 
 /**
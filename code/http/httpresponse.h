@@ -2,6 +2,7 @@
 #define HTTP_RESPONSE_H
 
 #include <unordered_map>
+#include <memory>
 #include <fcntl.h>       // open
 #include <unistd.h>      // close
 #include <sys/stat.h>    // stat
@@ -9,6 +10,8 @@
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
+#include "filecache.h"
+#include "sitetables.h"
 
 class HttpResponse {
 public:
@@ -28,8 +31,22 @@ public:
 
     void ErrorContent(Buffer &buff, std::string message);
 
+    void SetContent(std::shared_ptr<const std::string> content, const std::string &type);
+
+    /**
+     * @brief 修改响应读取的文件,在 Init 之后、MakeResponse 之前调用
+     * @param path 相对于资源目录的文件路径
+     */
+    void SetPath(const std::string &path) { path_ = path; }
+
     int Code() const { return code_; }
 
+    /**
+     * @brief 响应的文件内容是否来自内存缓存
+     * @return
+     */
+    bool IsCached() const { return cached_ != nullptr; }
+
 private:
     void AddStateLine_(Buffer &buff);
 
@@ -49,8 +66,11 @@ private:
 
     char *mmFile_;          //映射的文件指针
     struct stat mmFileStat_;//映射文件的stat结构体
+    std::shared_ptr<const std::string> cached_;    //命中文件缓存时的文件内容,此时不做内存映射
+    uint64_t cacheGeneration_;                      //生成响应时文件缓存的代数,缓存在此之后被清空时不再放入读到的内容
+    std::shared_ptr<const SiteTables> tables_;      //本次响应使用的 MIME 类型表,处理期间重新加载不会影响它
+    std::string contentType_;                       //SetContent 指定的类型,为空时按文件后缀确定
 
-    static const std::unordered_map <std::string, std::string> SUFFIX_TYPE;     //文件后缀与Content-Type的对应关系
     static const std::unordered_map<int, std::string> CODE_STATUS;              //HTTP状态码与状态文本的对应关系
     static const std::unordered_map<int, std::string> CODE_PATH;                //HTTP状态码与错误页面路径的对应关系
 };
@@ -0,0 +1,252 @@
+#include "router.h"
+
+#include <assert.h>
+#include <string.h>
+
+using namespace std;
+
+//路由树的节点,prefix 是从父节点到这里的静态片段,参数节点的 prefix 为空
+struct Router::Node {
+    std::string prefix;                         //静态片段
+    std::string indices;                        //各静态子节点 prefix 的首字符,与 children 一一对应
+    std::vector <std::unique_ptr<Node>> children;   //静态子节点,首字符互不相同
+    std::unique_ptr <Node> param;               //:name 参数子节点
+    std::string paramName;                      //参数子节点对应的参数名
+    std::shared_ptr<Handler> handler;           //在这里结束的路由
+    std::shared_ptr<Handler> catchAll;          //在这里以 *name 结尾的路由
+    std::string catchAllName;                   //* 后面的参数名
+};
+
+shared_ptr<const Router> Router::installed_;
+atomic<const Router *> Router::current_(nullptr);
+
+/**
+ * @brief 构造函数
+ */
+Router::Router() : size_(0) {}
+
+/**
+ * @brief 析构函数
+ */
+Router::~Router() = default;
+
+/**
+ * @brief 获取方法对应的路由树,不存在时创建
+ * @param method
+ * @return
+ */
+Router::Node *Router::Tree_(const string &method) {
+    for (auto &tree: trees_) {
+        if (tree.first == method) { return tree.second.get(); }
+    }
+    trees_.emplace_back(method, unique_ptr<Node>(new Node()));
+    return trees_.back().second.get();
+}
+
+/**
+ * @brief 查找方法对应的路由树,方法只有几种,顺序查找比哈希更快
+ * @param method
+ * @return 不存在时返回 nullptr
+ */
+const Router::Node *Router::FindTree_(const string &method) const {
+    for (const auto &tree: trees_) {
+        if (tree.first == method) { return tree.second.get(); }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 在 node 之后插入一段静态片段,与已有子节点有公共前缀时拆分该子节点
+ * @param node
+ * @param begin
+ * @param end
+ * @return 片段结束处的节点
+ */
+Router::Node *Router::InsertStatic_(Node *node, const char *begin, const char *end) {
+    while (begin < end) {
+        size_t idx = node->indices.find(*begin);
+        if (idx == string::npos) {
+            unique_ptr<Node> child(new Node());
+            child->prefix.assign(begin, end);
+            node->indices.push_back(*begin);
+            node->children.push_back(move(child));
+            return node->children.back().get();
+        }
+        Node *child = node->children[idx].get();
+        size_t common = 0;
+        size_t limit = min(child->prefix.size(), static_cast<size_t>(end - begin));
+        while (common < limit && child->prefix[common] == begin[common]) { common++; }
+        if (common < child->prefix.size()) {
+            //拆分: 公共前缀成为新的中间节点,原来的子节点挂在它下面
+            unique_ptr<Node> mid(new Node());
+            mid->prefix = child->prefix.substr(0, common);
+            child->prefix.erase(0, common);
+            mid->indices.push_back(child->prefix[0]);
+            mid->children.push_back(move(node->children[idx]));
+            node->children[idx] = move(mid);
+            child = node->children[idx].get();
+        }
+        node = child;
+        begin += common;
+    }
+    return node;
+}
+
+/**
+ * @brief 添加一条路由
+ * @param method 请求方法,"*" 表示任何方法
+ * @param pattern 路径,写法见类的说明
+ * @param handler
+ * @param err 路径不合法或与已有的路由冲突时的错误信息
+ * @return
+ */
+bool Router::Add(const string &method, const string &pattern, shared_ptr<Handler> handler, string &err) {
+    if (method.empty() || !handler) {
+        err = "route needs a method and a handler: " + pattern;
+        return false;
+    }
+    if (pattern.empty() || pattern[0] != '/') {
+        err = "route path must start with '/': " + pattern;
+        return false;
+    }
+    Node *node = Tree_(method);
+    const char *p = pattern.data();
+    const char *end = p + pattern.size();
+    while (p < end) {
+        if (*p != ':' && *p != '*') {
+            const char *next = p;
+            while (next < end && *next != ':' && *next != '*') { next++; }
+            node = InsertStatic_(node, p, next);
+            p = next;
+            continue;
+        }
+        //参数必须占据一个完整的路径段
+        if (p[-1] != '/') {
+            err = "parameter must follow '/': " + pattern;
+            return false;
+        }
+        const char *nameEnd = static_cast<const char *>(memchr(p, '/', end - p));
+        if (nameEnd == nullptr) { nameEnd = end; }
+        string name(p + 1, nameEnd);
+        if (name.empty()) {
+            err = "parameter needs a name: " + pattern;
+            return false;
+        }
+        if (*p == '*') {
+            if (nameEnd != end) {
+                err = "'*' must be the last segment: " + pattern;
+                return false;
+            }
+            if (node->catchAll) {
+                err = "duplicate route: " + method + " " + pattern;
+                return false;
+            }
+            node->catchAll = move(handler);
+            node->catchAllName = name;
+            size_++;
+            return true;
+        }
+        if (!node->param) {
+            node->param.reset(new Node());
+            node->paramName = name;
+        } else if (node->paramName != name) {
+            err = "conflicting parameter names :" + node->paramName + " and :" + name + ": " + pattern;
+            return false;
+        }
+        node = node->param.get();
+        p = nameEnd;
+    }
+    if (node->handler) {
+        err = "duplicate route: " + method + " " + pattern;
+        return false;
+    }
+    node->handler = move(handler);
+    size_++;
+    return true;
+}
+
+/**
+ * @brief 设置没有路由匹配时的处理对象
+ * @param handler
+ */
+void Router::SetFallback(shared_ptr<Handler> handler) {
+    fallback_ = move(handler);
+}
+
+/**
+ * @brief 在 node 的 prefix 已经匹配之后,匹配剩余的路径 [p, end)
+ * 先试静态子节点,再试参数,最后是 *;前一种在更深处失败时回溯
+ * @param node
+ * @param p
+ * @param end
+ * @param params 匹配成功时追加参数
+ * @return 匹配的处理对象,没有时返回 nullptr
+ */
+Handler *Router::Match_(const Node *node, const char *p, const char *end, RouteParams &params) {
+    if (p == end && node->handler) {
+        return node->handler.get();
+    }
+    if (p < end) {
+        size_t idx = node->indices.find(*p);
+        if (idx != string::npos) {
+            const Node *child = node->children[idx].get();
+            size_t len = child->prefix.size();
+            if (static_cast<size_t>(end - p) >= len && memcmp(p, child->prefix.data(), len) == 0) {
+                Handler *handler = Match_(child, p + len, end, params);
+                if (handler) { return handler; }
+            }
+        }
+        if (node->param && *p != '/') {
+            const char *segEnd = static_cast<const char *>(memchr(p, '/', end - p));
+            if (segEnd == nullptr) { segEnd = end; }
+            size_t mark = params.size();
+            params.emplace_back(node->paramName, string(p, segEnd));
+            Handler *handler = Match_(node->param.get(), segEnd, end, params);
+            if (handler) { return handler; }
+            params.resize(mark);
+        }
+    }
+    if (node->catchAll) {
+        params.emplace_back(node->catchAllName, string(p, end));
+        return node->catchAll.get();
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 查找请求对应的处理对象
+ * @param method 请求方法
+ * @param path 请求路径
+ * @param params 清空后放入路由中的参数
+ * @return 没有路由匹配时返回 Fallback(),可能为 nullptr
+ */
+Handler *Router::Match(const string &method, const string &path, RouteParams &params) const {
+    params.clear();
+    const char *p = path.data();
+    const char *end = p + path.size();
+    for (const Node *tree: {FindTree_(method), FindTree_("*")}) {
+        if (tree == nullptr) { continue; }
+        Handler *handler = Match_(tree, p, end, params);
+        if (handler) { return handler; }
+        params.clear();
+    }
+    return fallback_.get();
+}
+
+/**
+ * @brief 设置工作线程使用的路由表,只在启动时、没有请求正在处理时调用
+ * @param router
+ */
+void Router::Install(shared_ptr<const Router> router) {
+    assert(router);
+    current_.store(router.get(), memory_order_release);
+    installed_ = move(router);
+}
+
+/**
+ * @brief 当前的路由表
+ * @return 没有调用过 Install 时返回 nullptr
+ */
+const Router *Router::Current() {
+    return current_.load(memory_order_acquire);
+}
@@ -0,0 +1,79 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class HttpRequest;
+
+class HttpResponse;
+
+//路由中的参数,如 /user/:id 匹配 /user/42 时为 {"id", "42"}
+typedef std::vector <std::pair<std::string, std::string>> RouteParams;
+
+//处理一类请求的对象,由多个工作线程同时调用,不能修改自身的状态
+class Handler {
+public:
+    virtual ~Handler() = default;
+
+    /**
+     * @brief 生成响应。调用前响应已经以请求路径和状态码 200 初始化,处理对象可以改为另一个文件、
+     * 内存中生成的内容或其他状态码
+     * @param request
+     * @param params 路由中的参数
+     * @param response
+     */
+    virtual void Handle(HttpRequest &request, const RouteParams &params, HttpResponse &response) = 0;
+};
+
+//把请求方法与路径映射到处理对象,启动时建立,之后只读
+//每个方法一棵压缩前缀树(radix trie),路径的写法:
+//  /login          完全匹配
+//  /user/:id       :id 匹配一个路径段(到下一个 '/' 为止),放入参数 id
+//  /static/*file   *file 匹配剩余的全部路径(可以为空),只能出现在末尾
+//同一位置上静态片段优先于参数,参数优先于 *;方法为 "*" 的路由匹配任何方法,在该方法自己的树之后查找。
+//都不匹配时返回 SetFallback 设置的处理对象(静态文件)
+class Router {
+public:
+    Router();
+
+    ~Router();
+
+    bool Add(const std::string &method, const std::string &pattern, std::shared_ptr<Handler> handler,
+             std::string &err);
+
+    void SetFallback(std::shared_ptr<Handler> handler);
+
+    Handler *Fallback() const { return fallback_.get(); }
+
+    Handler *Match(const std::string &method, const std::string &path, RouteParams &params) const;
+
+    size_t Size() const { return size_; }
+
+    static void Install(std::shared_ptr<const Router> router);
+
+    static const Router *Current();
+
+private:
+    struct Node;
+
+    Node *Tree_(const std::string &method);
+
+    const Node *FindTree_(const std::string &method) const;
+
+    static Node *InsertStatic_(Node *node, const char *begin, const char *end);
+
+    static Handler *Match_(const Node *node, const char *p, const char *end, RouteParams &params);
+
+    std::vector <std::pair<std::string, std::unique_ptr<Node>>> trees_; //方法 -> 路由树
+    std::shared_ptr<Handler> fallback_;     //没有路由匹配时的处理对象
+    size_t size_;                           //路由条数
+
+    static std::shared_ptr<const Router> installed_;    //Install 设置的路由表,保持存活
+    static std::atomic<const Router *> current_;        //工作线程读取的路由表
+};
+
+#endif //ROUTER_H
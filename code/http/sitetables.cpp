@@ -0,0 +1,128 @@
+#include "sitetables.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+
+atomic <uint64_t> SiteTables::version_(1);
+
+/**
+ * @brief 构造函数,使用内置的 MIME 类型表与页面路径
+ */
+SiteTables::SiteTables() :
+        mime_{
+                {".html",  "text/html"},
+                {".xml",   "text/xml"},
+                {".xhtml", "application/xhtml+xml"},
+                {".txt",   "text/plain"},
+                {".rtf",   "application/rtf"},
+                {".pdf",   "application/pdf"},
+                {".word",  "application/nsword"},
+                {".png",   "image/png"},
+                {".gif",   "image/gif"},
+                {".jpg",   "image/jpeg"},
+                {".jpeg",  "image/jpeg"},
+                {".au",    "audio/basic"},
+                {".mpeg",  "video/mpeg"},
+                {".mpg",   "video/mpeg"},
+                {".avi",   "video/x-msvideo"},
+                {".gz",    "application/x-gzip"},
+                {".tar",   "application/x-tar"},
+                {".css",   "text/css "},
+                {".js",    "text/javascript "},
+        },
+        pages_{"/index", "/register", "/login", "/welcome", "/video", "/picture"} {}
+
+/**
+ * @brief 全局的当前快照,第一次使用时以内置的表初始化
+ * @return
+ */
+shared_ptr<const SiteTables> &SiteTables::Global_() {
+    static shared_ptr<const SiteTables> global(new SiteTables());
+    return global;
+}
+
+/**
+ * @brief 获取当前的表
+ * 线程缓存上一次的快照,版本号没有变化时不需要访问全局指针
+ * @return
+ */
+shared_ptr<const SiteTables> SiteTables::Current() {
+    static thread_local shared_ptr<const SiteTables> cached;
+    static thread_local uint64_t cachedVersion = 0;
+    uint64_t version = version_.load(memory_order_acquire);
+    if (version != cachedVersion) {
+        cached = atomic_load(&Global_());
+        cachedVersion = version;
+    }
+    return cached;
+}
+
+/**
+ * @brief 重新生成表并替换全局快照,失败时保留原来的表
+ * @param mimeFile 额外的 MIME 类型文件,格式与 /etc/mime.types 相同(每行一个类型,后面是不带 . 的后缀),
+ *                 其中的后缀覆盖内置的表;空字符串表示只使用内置的表
+ * @param pages 逗号分隔的页面路径,请求这些路径时返回同名的 .html 文件
+ * @param err 失败时的错误信息
+ * @return
+ */
+bool SiteTables::Load(const string &mimeFile, const string &pages, string &err) {
+    shared_ptr <SiteTables> tables(new SiteTables());
+    if (!mimeFile.empty()) {
+        FILE *fp = fopen(mimeFile.c_str(), "r");
+        if (!fp) {
+            err = "cannot open mime types file " + mimeFile;
+            return false;
+        }
+        char line[1024];
+        while (fgets(line, sizeof(line), fp)) {
+            if (line[0] == '#') { continue; }
+            char *save = nullptr;
+            char *type = strtok_r(line, " \t\r\n", &save);
+            if (type == nullptr) { continue; }
+            while (char *ext = strtok_r(nullptr, " \t\r\n", &save)) {
+                tables->mime_[string(".") + ext] = type;
+            }
+        }
+        fclose(fp);
+    }
+    tables->pages_.clear();
+    size_t pos = 0;
+    while (pos <= pages.size()) {
+        size_t end = pages.find(',', pos);
+        if (end == string::npos) { end = pages.size(); }
+        string page = pages.substr(pos, end - pos);
+        if (!page.empty()) {
+            if (page[0] != '/') {
+                err = "page path must start with '/': " + page;
+                return false;
+            }
+            tables->pages_.insert(page);
+        }
+        pos = end + 1;
+    }
+    atomic_store(&Global_(), shared_ptr<const SiteTables>(move(tables)));
+    version_.fetch_add(1, memory_order_release);
+    return true;
+}
+
+/**
+ * @brief 根据后缀查找 Content-Type
+ * @param suffix 带 . 的后缀
+ * @return 找不到时返回 text/plain
+ */
+const string &SiteTables::MimeType(const string &suffix) const {
+    static const string defaultType = "text/plain";
+    auto it = mime_.find(suffix);
+    return it == mime_.end() ? defaultType : it->second;
+}
+
+/**
+ * @brief 路径是否是省略了 .html 后缀的页面
+ * @param path
+ * @return
+ */
+bool SiteTables::IsPage(const string &path) const {
+    return pages_.count(path) == 1;
+}
@@ -0,0 +1,38 @@
+#ifndef SITE_TABLES_H
+#define SITE_TABLES_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+
+//静态站点的 MIME 类型表与页面路径表,可以在运行时整体替换
+//处理请求时取一份快照(shared_ptr),重新加载时只替换全局指针,正在处理的请求继续使用旧的表;
+//每个线程缓存最近一次取到的快照,只有版本号变化时才重新读取全局指针
+class SiteTables {
+public:
+    static std::shared_ptr<const SiteTables> Current();
+
+    static bool Load(const std::string &mimeFile, const std::string &pages, std::string &err);
+
+    const std::string &MimeType(const std::string &suffix) const;
+
+    bool IsPage(const std::string &path) const;
+
+    size_t MimeCount() const { return mime_.size(); }
+
+    size_t PageCount() const { return pages_.size(); }
+
+private:
+    SiteTables();
+
+    static std::shared_ptr<const SiteTables> &Global_();
+
+    std::unordered_map <std::string, std::string> mime_;    //文件后缀(带 .)与 Content-Type 的对应关系
+    std::unordered_set <std::string> pages_;                //省略了 .html 后缀的页面路径,如 /login
+
+    static std::atomic <uint64_t> version_;                 //每次加载后加一
+};
+
+#endif //SITE_TABLES_H
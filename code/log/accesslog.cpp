@@ -0,0 +1,190 @@
+#include "accesslog.h"
+
+#include <time.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+/**
+ * @brief 构造函数
+ */
+AccessLog::AccessLog() : isOpen_(false), sampleRate_(1), flushIntervalMs_(1000),
+                         ringSize_(4096), dropped_(0), fp_(nullptr) {}
+
+/**
+ * @brief 析构函数,把剩余的记录写入文件
+ */
+AccessLog::~AccessLog() {
+    Close();
+}
+
+/**
+ * @brief 单例
+ * @return
+ */
+AccessLog *AccessLog::Instance() {
+    static AccessLog inst;
+    return &inst;
+}
+
+/**
+ * @brief 打开访问日志并启动后台刷新线程
+ * @param path 访问日志文件路径
+ * @param sampleRate 采样率,每 sampleRate 个请求记录一个
+ * @param flushIntervalMs 批量写入文件的间隔
+ * @param ringSize 每个线程环形缓冲区可以缓存的记录数
+ */
+void AccessLog::Init(const char *path, int sampleRate, int flushIntervalMs, size_t ringSize) {
+    assert(path && sampleRate > 0 && flushIntervalMs > 0 && ringSize > 0);
+    Close();
+    fp_ = fopen(path, "a");
+    if (fp_ == nullptr) {
+        //目录不存在时先创建目录
+        string dir(path);
+        size_t idx = dir.find_last_of('/');
+        if (idx != string::npos) {
+            mkdir(dir.substr(0, idx).c_str(), 0777);
+            fp_ = fopen(path, "a");
+        }
+    }
+    if (fp_ == nullptr) { return; }
+    sampleRate_ = sampleRate;
+    flushIntervalMs_ = flushIntervalMs;
+    ringSize_ = ringSize;
+    isOpen_ = true;
+    flushThread_.reset(new thread(&AccessLog::FlushLoop_, this));
+}
+
+/**
+ * @brief 停止刷新线程,写出剩余记录并关闭文件
+ */
+void AccessLog::Close() {
+    if (!isOpen_) { return; }
+    {
+        lock_guard <mutex> locker(mtx_);
+        isOpen_ = false;
+    }
+    cond_.notify_one();
+    if (flushThread_ && flushThread_->joinable()) {
+        flushThread_->join();
+    }
+    flushThread_.reset();
+    fclose(fp_);
+    fp_ = nullptr;
+}
+
+/**
+ * @brief 判断当前请求是否需要记录
+ * 按线程计数,每 sampleRate_ 个请求记录一个;状态码 >= 400 的请求总是记录
+ * @param status 响应状态码
+ * @return
+ */
+bool AccessLog::Sample(int status) {
+    static thread_local unsigned int counter = 0;
+    if (!isOpen_) { return false; }
+    if (status >= 400 || sampleRate_ == 1) { return true; }
+    return ++counter % sampleRate_ == 0;
+}
+
+/**
+ * @brief 获取当前线程的环形缓冲区,第一次调用时登记
+ * @return
+ */
+AccessLog::Ring *AccessLog::LocalRing_() {
+    static thread_local Ring *ring = nullptr;
+    if (ring == nullptr) {
+        lock_guard <mutex> locker(mtx_);
+        rings_.emplace_back(new Ring(ringSize_));
+        ring = rings_.back().get();
+    }
+    return ring;
+}
+
+/**
+ * @brief 追加一条访问记录,缓冲区已满时丢弃并计数,不会阻塞调用线程
+ * @param rec
+ */
+void AccessLog::Record(const AccessRecord &rec) {
+    if (!isOpen_) { return; }
+    Ring *ring = LocalRing_();
+    size_t tail = ring->tail.load(memory_order_relaxed);
+    size_t head = ring->head.load(memory_order_acquire);
+    if (tail - head >= ring->slots.size()) {
+        dropped_++;
+        return;
+    }
+    ring->slots[tail % ring->slots.size()] = rec;
+    ring->tail.store(tail + 1, memory_order_release);
+    //缓冲区超过一半时提前唤醒刷新线程
+    if (tail + 1 - head == ring->slots.size() / 2) {
+        cond_.notify_one();
+    }
+}
+
+/**
+ * @brief 刷新线程,每隔 flushIntervalMs_ 或被唤醒时批量写出记录
+ */
+void AccessLog::FlushLoop_() {
+    while (true) {
+        bool open;
+        {
+            unique_lock <mutex> locker(mtx_);
+            if (isOpen_) {
+                cond_.wait_for(locker, chrono::milliseconds(flushIntervalMs_));
+            }
+            open = isOpen_;
+        }
+        Drain_();
+        if (!open) { break; }
+    }
+}
+
+/**
+ * @brief 取出所有线程缓冲区中的记录,格式化后一次写入文件
+ */
+void AccessLog::Drain_() {
+    {
+        lock_guard <mutex> locker(mtx_);
+        for (auto &ring: rings_) {
+            size_t head = ring->head.load(memory_order_relaxed);
+            size_t tail = ring->tail.load(memory_order_acquire);
+            for (; head != tail; head++) {
+                Format_(ring->slots[head % ring->slots.size()]);
+            }
+            ring->head.store(head, memory_order_release);
+        }
+    }
+    if (buff_.ReadableBytes() > 0) {
+        fwrite(buff_.Peek(), 1, buff_.ReadableBytes(), fp_);
+        fflush(fp_);
+        buff_.RetrieveAll();
+    }
+}
+
+/**
+ * @brief 把一条记录格式化为一行文本
+ * 格式: 时间 IP 方法 路径 状态码 字节数 耗时(微秒)
+ * @param rec
+ */
+void AccessLog::Format_(const AccessRecord &rec) {
+    time_t sec = static_cast<time_t>(rec.usec / 1000000);
+    struct tm t;
+    localtime_r(&sec, &t);
+    char ip[INET_ADDRSTRLEN];
+    struct in_addr addr;
+    addr.s_addr = rec.ip;
+    inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+
+    buff_.EnsureWriteable(256);
+    int n = snprintf(buff_.BeginWrite(), buff_.WritableBytes(),
+                     "%d-%02d-%02d %02d:%02d:%02d.%06ld %s %.*s %.*s %u %llu %u\n",
+                     t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec,
+                     static_cast<long>(rec.usec % 1000000), ip,
+                     static_cast<int>(sizeof(rec.method)), rec.method,
+                     static_cast<int>(sizeof(rec.path)), rec.path,
+                     rec.status, static_cast<unsigned long long>(rec.bytes), rec.latencyUs);
+    buff_.HasWritten(n);
+}
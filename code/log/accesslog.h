@@ -0,0 +1,81 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+#include "../buffer/buffer.h"
+
+//一条访问记录,字段长度固定,写入环形缓冲区时不需要分配内存
+struct AccessRecord {
+    int64_t usec;           //请求完成的时间,微秒
+    uint64_t bytes;         //响应的字节数
+    uint32_t latencyUs;     //从读到请求到响应发送完毕的耗时,微秒
+    uint32_t ip;            //客户端 IP,网络字节序
+    uint16_t status;        //响应状态码
+    char method[8];         //请求方法,以 '\0' 结尾
+    char path[94];          //请求路径,以 '\0' 结尾,过长时截断
+};
+
+//访问日志,与诊断日志 Log 相互独立
+//每个线程把记录追加到自己的环形缓冲区(单生产者单消费者,无锁),
+//后台线程定期把所有缓冲区中的记录批量格式化后一次写入文件
+class AccessLog {
+public:
+    static AccessLog *Instance();
+
+    void Init(const char *path = "./log/access.log", int sampleRate = 1,
+              int flushIntervalMs = 1000, size_t ringSize = 4096);
+
+    void Close();
+
+    bool IsOpen() const { return isOpen_; }
+
+    bool Sample(int status);
+
+    void Record(const AccessRecord &rec);
+
+    uint64_t Dropped() const { return dropped_; }
+
+private:
+    AccessLog();
+
+    ~AccessLog();
+
+    //每个线程独占的环形缓冲区,tail_ 只由所属线程修改,head_ 只由刷新线程修改
+    struct Ring {
+        explicit Ring(size_t size) : slots(size), head(0), tail(0) {}
+
+        std::vector <AccessRecord> slots;
+        std::atomic <size_t> head;
+        std::atomic <size_t> tail;
+    };
+
+    Ring *LocalRing_();
+
+    void FlushLoop_();
+
+    void Drain_();
+
+    void Format_(const AccessRecord &rec);
+
+    std::atomic<bool> isOpen_;          //访问日志是否打开
+    int sampleRate_;                    //每 sampleRate_ 个请求记录一个,错误响应总是记录
+    int flushIntervalMs_;               //批量刷新的间隔
+    size_t ringSize_;                   //每个线程环形缓冲区的容量
+    std::atomic <uint64_t> dropped_;    //缓冲区满而丢弃的记录数
+
+    FILE *fp_;                          //访问日志文件
+    Buffer buff_;                       //刷新线程格式化记录使用的缓冲区
+    std::vector <std::unique_ptr<Ring>> rings_; //所有线程的环形缓冲区
+    std::mutex mtx_;                    //保护 rings_ 与刷新线程的等待
+    std::condition_variable cond_;      //唤醒刷新线程
+    std::unique_ptr <std::thread> flushThread_; //后台刷新线程
+};
+
+#endif //ACCESS_LOG_H
@@ -0,0 +1,535 @@
+#include "binlog.h"
+
+#include <time.h>
+#include <ctype.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <algorithm>
+
+using namespace std;
+
+const char BinLog::MAGIC[4] = {'C', 'C', 'B', 'L'};
+
+/**
+ * @brief 构造函数
+ */
+BinLog::BinLog() {
+    headerPending_ = true;
+    lastUsec_ = 0;
+}
+
+/**
+ * @brief 以 varint 形式写入一个无符号整数,每个字节保存 7 位,最高位表示后面是否还有字节
+ * @param buff
+ * @param value
+ */
+void BinLog::PutVarint_(Buffer &buff, uint64_t value) {
+    char tmp[10];
+    size_t n = 0;
+    while (value >= 0x80) {
+        tmp[n++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    tmp[n++] = static_cast<char>(value);
+    buff.Append(tmp, n);
+}
+
+/**
+ * @brief 以 zigzag 形式写入一个有符号整数,使绝对值小的负数同样只占少量字节
+ * @param buff
+ * @param value
+ */
+void BinLog::PutZigzag_(Buffer &buff, int64_t value) {
+    PutVarint_(buff, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+/**
+ * @brief 获取格式串对应的编号,第一次出现的格式串会被分配新的编号
+ * 每个线程缓存自己查过的编号,常见情况下不需要加锁
+ * @param format
+ * @return
+ */
+uint32_t BinLog::FormatId(const char *format) {
+    static thread_local std::unordered_map<const char *, uint32_t> cache;
+    auto hit = cache.find(format);
+    if (hit != cache.end()) {
+        return hit->second;
+    }
+    lock_guard <mutex> locker(mtx_);
+    uint32_t id;
+    auto it = ids_.find(format);
+    if (it != ids_.end()) {
+        id = it->second;
+    } else {
+        id = static_cast<uint32_t>(formats_.size());
+        ids_[format] = id;
+        formats_.push_back(format);
+    }
+    cache[format] = id;
+    return id;
+}
+
+/**
+ * @brief 按照 printf 格式串的转换说明依次取出参数,并按类型编码到缓冲区中
+ * @param buff
+ * @param format
+ * @param vaList
+ * @return 编码的参数个数
+ */
+int BinLog::EncodeArgs_(Buffer &buff, const char *format, va_list vaList) {
+    int argc = 0;
+    for (const char *p = format; *p; p++) {
+        if (*p != '%') { continue; }
+        p++;
+        if (*p == '%') { continue; }
+        //标志、宽度与精度,其中 '*' 需要额外取出一个 int 参数
+        while (*p && strchr("-+ #0", *p)) { p++; }
+        for (; *p == '*' || (*p >= '0' && *p <= '9') || *p == '.'; p++) {
+            if (*p == '*') {
+                buff.Append("i", 1);
+                PutZigzag_(buff, va_arg(vaList, int));
+                argc++;
+            }
+        }
+        //长度修饰符
+        int lengthMod = 0;  // 0:默认 1:l 2:ll 3:z 4:j 5:t 6:L
+        while (*p && strchr("hlLzjtq", *p)) {
+            switch (*p) {
+                case 'l':
+                    lengthMod = (lengthMod == 1) ? 2 : 1;
+                    break;
+                case 'q':
+                    lengthMod = 2;
+                    break;
+                case 'z':
+                    lengthMod = 3;
+                    break;
+                case 'j':
+                    lengthMod = 4;
+                    break;
+                case 't':
+                    lengthMod = 5;
+                    break;
+                case 'L':
+                    lengthMod = 6;
+                    break;
+                default:
+                    break;
+            }
+            p++;
+        }
+        if (*p == '\0') { break; }
+        switch (*p) {
+            case 'd':
+            case 'i':
+            case 'c': {
+                int64_t v;
+                switch (lengthMod) {
+                    case 1: v = va_arg(vaList, long); break;
+                    case 2: v = va_arg(vaList, long long); break;
+                    case 3: v = va_arg(vaList, ssize_t); break;
+                    case 4: v = va_arg(vaList, intmax_t); break;
+                    case 5: v = va_arg(vaList, ptrdiff_t); break;
+                    default: v = va_arg(vaList, int); break;
+                }
+                buff.Append("i", 1);
+                PutZigzag_(buff, v);
+                argc++;
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o': {
+                uint64_t v;
+                switch (lengthMod) {
+                    case 1: v = va_arg(vaList, unsigned long); break;
+                    case 2: v = va_arg(vaList, unsigned long long); break;
+                    case 3: v = va_arg(vaList, size_t); break;
+                    case 4: v = va_arg(vaList, uintmax_t); break;
+                    case 5: v = static_cast<uint64_t>(va_arg(vaList, ptrdiff_t)); break;
+                    default: v = va_arg(vaList, unsigned int); break;
+                }
+                buff.Append("u", 1);
+                PutVarint_(buff, v);
+                argc++;
+                break;
+            }
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                double v = (lengthMod == 6) ? static_cast<double>(va_arg(vaList, long double))
+                                            : va_arg(vaList, double);
+                buff.Append("f", 1);
+                buff.Append(&v, sizeof(v));
+                argc++;
+                break;
+            }
+            case 's': {
+                const char *v = va_arg(vaList, const char *);
+                if (!v) { v = "(null)"; }
+                size_t n = strlen(v);
+                buff.Append("s", 1);
+                PutVarint_(buff, n);
+                buff.Append(v, n);
+                argc++;
+                break;
+            }
+            case 'p': {
+                void *v = va_arg(vaList, void *);
+                buff.Append("p", 1);
+                PutVarint_(buff, reinterpret_cast<uintptr_t>(v));
+                argc++;
+                break;
+            }
+            case 'n':
+                //不支持 %n,只取出参数
+                va_arg(vaList, void *);
+                break;
+            default:
+                break;
+        }
+    }
+    return argc;
+}
+
+/**
+ * @brief 编码一条日志,供写线程交给 WriteRecord 写入文件
+ * 编码结果为: 8字节的绝对时间 varint(编号) 级别 varint(参数个数) 参数...
+ * 绝对时间由 WriteRecord 在落盘时换算成相对上一条记录的增量,
+ * 这样文件滚动或同步写入插队时增量依然正确
+ * 可以在多个线程中同时调用
+ * @param buff 输出缓冲区
+ * @param level 日志级别
+ * @param usec 日志时间,微秒
+ * @param format 格式串
+ * @param vaList 参数列表
+ */
+void BinLog::Encode(Buffer &buff, int level, int64_t usec, const char *format, va_list vaList) {
+    static thread_local Buffer args(256);
+    uint32_t id = FormatId(format);
+    args.RetrieveAll();
+    int argc = EncodeArgs_(args, format, vaList);
+
+    buff.Append(&usec, sizeof(usec));
+    PutVarint_(buff, id);
+    char lv = static_cast<char>(level);
+    buff.Append(&lv, 1);
+    PutVarint_(buff, argc);
+    buff.Append(args);
+}
+
+/**
+ * @brief 标记开始写一个新文件,下一条记录前会重新写出文件头与格式串
+ */
+void BinLog::ResetFile() {
+    headerPending_ = true;
+    written_.assign(written_.size(), false);
+}
+
+/**
+ * @brief 将 Encode 产生的一条记录写入文件
+ * 必要时先写出文件头和该记录用到的格式串
+ * 同一时刻只能由一个线程调用(调用者持有日志文件的锁)
+ * @param fp 日志文件
+ * @param data Encode 的编码结果
+ * @param len 编码结果的长度
+ * @return 实际写入文件的字节数
+ */
+size_t BinLog::WriteRecord(FILE *fp, const char *data, size_t len) {
+    assert(fp && len > sizeof(int64_t));
+    int64_t usec;
+    memcpy(&usec, data, sizeof(usec));
+    data += sizeof(usec);
+    len -= sizeof(usec);
+
+    //解出格式串编号
+    uint32_t id = 0;
+    for (size_t i = 0, shift = 0; i < len; i++, shift += 7) {
+        id |= static_cast<uint32_t>(data[i] & 0x7F) << shift;
+        if (!(data[i] & 0x80)) { break; }
+    }
+    if (id >= written_.size()) {
+        written_.resize(id + 1, false);
+    }
+
+    out_.RetrieveAll();
+    if (headerPending_) {
+        char version = VERSION;
+        out_.Append(MAGIC, sizeof(MAGIC));
+        out_.Append(&version, 1);
+        PutVarint_(out_, static_cast<uint64_t>(usec));
+        lastUsec_ = usec;
+        headerPending_ = false;
+    }
+    if (!written_[id]) {
+        lock_guard <mutex> locker(mtx_);
+        assert(id < formats_.size());
+        char type = REC_FORMAT;
+        out_.Append(&type, 1);
+        PutVarint_(out_, id);
+        PutVarint_(out_, formats_[id].size());
+        out_.Append(formats_[id]);
+        written_[id] = true;
+    }
+    char type = REC_MESSAGE;
+    out_.Append(&type, 1);
+    PutZigzag_(out_, usec - lastUsec_);
+    lastUsec_ = usec;
+    out_.Append(data, len);
+
+    return fwrite(out_.Peek(), 1, out_.ReadableBytes(), fp);
+}
+
+namespace {
+    //解码时使用的只读游标
+    struct Reader {
+        const uint8_t *p;
+        const uint8_t *end;
+
+        bool Varint(uint64_t &value) {
+            value = 0;
+            for (int shift = 0; p < end && shift < 64; shift += 7) {
+                uint8_t b = *p++;
+                value |= static_cast<uint64_t>(b & 0x7F) << shift;
+                if (!(b & 0x80)) { return true; }
+            }
+            return false;
+        }
+
+        bool Zigzag(int64_t &value) {
+            uint64_t v;
+            if (!Varint(v)) { return false; }
+            value = static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+            return true;
+        }
+
+        bool Bytes(size_t n, const char *&out) {
+            if (static_cast<size_t>(end - p) < n) { return false; }
+            out = reinterpret_cast<const char *>(p);
+            p += n;
+            return true;
+        }
+    };
+
+    struct Arg {
+        char type;
+        int64_t i;
+        uint64_t u;
+        double f;
+        std::string s;
+    };
+
+    const char *LevelTitle(int level) {
+        switch (level) {
+            case 0:
+                return "debug";
+            case 2:
+                return "warn";
+            case 3:
+                return "error";
+            default:
+                return "info";
+        }
+    }
+
+    //按格式串把参数还原成文本
+    std::string Format(const std::string &format, const std::vector <Arg> &args) {
+        std::string res;
+        char tmp[512];
+        size_t next = 0;
+        for (size_t i = 0; i < format.size(); i++) {
+            if (format[i] != '%') {
+                res += format[i];
+                continue;
+            }
+            if (i + 1 < format.size() && format[i + 1] == '%') {
+                res += '%';
+                i++;
+                continue;
+            }
+            //重新拼出去掉长度修饰符的转换说明,'*' 替换为编码时记录的数值
+            std::string spec = "%";
+            size_t j = i + 1;
+            for (; j < format.size() && strchr("-+ #0", format[j]); j++) { spec += format[j]; }
+            for (; j < format.size() && (format[j] == '*' || format[j] == '.' || isdigit(format[j])); j++) {
+                if (format[j] == '*') {
+                    spec += (next < args.size() && args[next].type == BinLog::ARG_INT)
+                            ? std::to_string(args[next].i) : "0";
+                    next++;
+                } else {
+                    spec += format[j];
+                }
+            }
+            for (; j < format.size() && strchr("hlLzjtq", format[j]); j++) {}
+            if (j >= format.size()) { break; }
+            char conv = format[j];
+            i = j;
+            if (conv == 'n') { continue; }
+            if (next >= args.size()) {
+                res += "<?>";
+                continue;
+            }
+            const Arg &arg = args[next++];
+            int n = -1;
+            switch (arg.type) {
+                case BinLog::ARG_INT:
+                    n = (conv == 'c') ? snprintf(tmp, sizeof(tmp), (spec + conv).c_str(), static_cast<int>(arg.i))
+                                      : snprintf(tmp, sizeof(tmp), (spec + "ll" + conv).c_str(),
+                                                 static_cast<long long>(arg.i));
+                    break;
+                case BinLog::ARG_UINT:
+                    n = snprintf(tmp, sizeof(tmp), (spec + "ll" + conv).c_str(), static_cast<unsigned long long>(arg.u));
+                    break;
+                case BinLog::ARG_DOUBLE:
+                    n = snprintf(tmp, sizeof(tmp), (spec + conv).c_str(), arg.f);
+                    break;
+                case BinLog::ARG_STRING:
+                    if (spec.size() == 1) {
+                        res += arg.s;
+                        continue;
+                    }
+                    n = snprintf(tmp, sizeof(tmp), (spec + 's').c_str(), arg.s.c_str());
+                    break;
+                case BinLog::ARG_PTR:
+                    n = snprintf(tmp, sizeof(tmp), (spec + 'p').c_str(), reinterpret_cast<void *>(arg.u));
+                    break;
+                default:
+                    break;
+            }
+            if (n < 0) {
+                res += "<?>";
+            } else {
+                res.append(tmp, std::min(static_cast<size_t>(n), sizeof(tmp) - 1));
+            }
+        }
+        return res;
+    }
+
+    void PutJsonString(FILE *out, const std::string &s) {
+        fputc('"', out);
+        for (unsigned char ch: s) {
+            switch (ch) {
+                case '"':
+                    fputs("\\\"", out);
+                    break;
+                case '\\':
+                    fputs("\\\\", out);
+                    break;
+                case '\n':
+                    fputs("\\n", out);
+                    break;
+                case '\r':
+                    fputs("\\r", out);
+                    break;
+                case '\t':
+                    fputs("\\t", out);
+                    break;
+                default:
+                    if (ch < 0x20) { fprintf(out, "\\u%04x", ch); }
+                    else { fputc(ch, out); }
+                    break;
+            }
+        }
+        fputc('"', out);
+    }
+}
+
+/**
+ * @brief 将二进制日志解码为文本(与文本日志格式相同)或每行一个 JSON 对象
+ * 文件中间出现的文件头(追加写入同一文件时产生)会重置格式串表和基准时间
+ * @param data 日志文件内容
+ * @param len 日志文件长度
+ * @param out 输出文件
+ * @param json 是否输出 JSON
+ * @return 成功返回 0,文件损坏返回 -1
+ */
+int BinLog::Decode(const char *data, size_t len, FILE *out, bool json) {
+    Reader rd = {reinterpret_cast<const uint8_t *>(data), reinterpret_cast<const uint8_t *>(data) + len};
+    std::unordered_map <uint64_t, std::string> formats;
+    std::vector <Arg> args;
+    int64_t usec = 0;
+    bool hasHeader = false;
+
+    while (rd.p < rd.end) {
+        const char *raw;
+        if (static_cast<size_t>(rd.end - rd.p) >= sizeof(MAGIC) && memcmp(rd.p, MAGIC, sizeof(MAGIC)) == 0) {
+            uint64_t base;
+            rd.p += sizeof(MAGIC);
+            if (!rd.Bytes(1, raw) || static_cast<uint8_t>(raw[0]) != VERSION || !rd.Varint(base)) { return -1; }
+            formats.clear();
+            usec = static_cast<int64_t>(base);
+            hasHeader = true;
+            continue;
+        }
+        if (!hasHeader) { return -1; }
+
+        uint8_t type = *rd.p++;
+        if (type == REC_FORMAT) {
+            uint64_t id, n;
+            if (!rd.Varint(id) || !rd.Varint(n) || !rd.Bytes(n, raw)) { return -1; }
+            formats[id] = std::string(raw, n);
+        } else if (type == REC_MESSAGE) {
+            int64_t delta;
+            uint64_t id, argc;
+            if (!rd.Zigzag(delta) || !rd.Varint(id) || !rd.Bytes(1, raw) || !rd.Varint(argc)) { return -1; }
+            int level = static_cast<int8_t>(raw[0]);
+            usec += delta;
+            args.resize(argc);
+            for (uint64_t i = 0; i < argc; i++) {
+                Arg &arg = args[i];
+                if (!rd.Bytes(1, raw)) { return -1; }
+                arg.type = raw[0];
+                switch (arg.type) {
+                    case ARG_INT:
+                        if (!rd.Zigzag(arg.i)) { return -1; }
+                        break;
+                    case ARG_UINT:
+                    case ARG_PTR:
+                        if (!rd.Varint(arg.u)) { return -1; }
+                        break;
+                    case ARG_DOUBLE:
+                        if (!rd.Bytes(sizeof(double), raw)) { return -1; }
+                        memcpy(&arg.f, raw, sizeof(double));
+                        break;
+                    case ARG_STRING: {
+                        uint64_t n;
+                        if (!rd.Varint(n) || !rd.Bytes(n, raw)) { return -1; }
+                        arg.s.assign(raw, n);
+                        break;
+                    }
+                    default:
+                        return -1;
+                }
+            }
+            auto it = formats.find(id);
+            std::string msg = (it == formats.end()) ? "<unknown format " + std::to_string(id) + ">"
+                                                    : Format(it->second, args);
+
+            time_t sec = static_cast<time_t>(usec / 1000000);
+            struct tm t;
+            localtime_r(&sec, &t);
+            char stamp[64];
+            snprintf(stamp, sizeof(stamp), "%d-%02d-%02d %02d:%02d:%02d.%06ld",
+                     t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+                     t.tm_hour, t.tm_min, t.tm_sec, static_cast<long>(usec % 1000000));
+            if (json) {
+                fprintf(out, "{\"time\":\"%s\",\"usec\":%" PRId64 ",\"level\":\"%s\",\"id\":%" PRIu64 ",\"msg\":",
+                        stamp, usec, LevelTitle(level), id);
+                PutJsonString(out, msg);
+                fputs("}\n", out);
+            } else {
+                const char *title = LevelTitle(level);
+                fprintf(out, "%s [%s]%s: %s\n", stamp, title, strlen(title) == 4 ? " " : "", msg.c_str());
+            }
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
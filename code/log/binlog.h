@@ -0,0 +1,72 @@
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "../buffer/buffer.h"
+
+//二进制日志的编码与解码
+//每条日志只记录格式串编号、按类型编码的参数以及相对上一条记录的时间增量,
+//格式串本身在每个文件中首次使用前写入一次,由离线工具 logdecode 还原为文本或 JSON
+//
+//文件布局:
+//  文件头  : MAGIC(4字节) VERSION(1字节) varint(基准时间,微秒)
+//  格式记录: REC_FORMAT varint(编号) varint(长度) 格式串
+//  日志记录: REC_MESSAGE zigzag(时间增量,微秒) varint(编号) 级别(1字节) varint(参数个数) 参数...
+//  参数    : 类型(1字节) 数据, 整数为 varint/zigzag, 浮点为 8 字节, 字符串为 varint(长度)+内容
+class BinLog {
+public:
+    enum RECORD_TYPE {
+        REC_FORMAT = 1,
+        REC_MESSAGE = 2,
+    };
+
+    enum ARG_TYPE {
+        ARG_INT = 'i',
+        ARG_UINT = 'u',
+        ARG_DOUBLE = 'f',
+        ARG_STRING = 's',
+        ARG_PTR = 'p',
+    };
+
+    BinLog();
+
+    ~BinLog() = default;
+
+    uint32_t FormatId(const char *format);
+
+    void Encode(Buffer &buff, int level, int64_t usec, const char *format, va_list vaList);
+
+    size_t WriteRecord(FILE *fp, const char *data, size_t len);
+
+    void ResetFile();
+
+    static int Decode(const char *data, size_t len, FILE *out, bool json);
+
+    static const char MAGIC[4];
+    static const uint8_t VERSION = 1;
+
+private:
+    static void PutVarint_(Buffer &buff, uint64_t value);
+
+    static void PutZigzag_(Buffer &buff, int64_t value);
+
+    static int EncodeArgs_(Buffer &buff, const char *format, va_list vaList);
+
+    std::mutex mtx_;                                    //保护格式串表,编号查询先走线程内缓存,只有新格式串才加锁
+    std::unordered_map<const char *, uint32_t> ids_;    //格式串地址到编号的映射,日志宏传入的都是字符串字面量
+    std::vector <std::string> formats_;                 //按编号保存的格式串
+
+    //以下成员只由写文件的一方访问
+    std::vector<bool> written_;                         //当前文件中已经写出过的格式串
+    bool headerPending_;    //当前文件是否还没有写文件头
+    int64_t lastUsec_;      //当前文件中上一条记录的时间,用于计算时间增量
+    Buffer out_;            //写文件前拼装记录的缓冲区
+};
+
+#endif //BINLOG_H
@@ -1,5 +1,7 @@
 #include "log.h"
 
+#include <dirent.h>
+
 using namespace std;
 
 /**
@@ -7,11 +9,19 @@ using namespace std;
  * 
  */
 Log::Log() {
-    lineCount_ = 0;
+    level_ = 1;
+    isOpen_ = false;
     isAsync_ = false;
+    overflow_ = OVERFLOW_SPILL;
+    dropped_ = 0;
+    isBinary_ = false;
+    maxFileBytes_ = 0;
+    fileBytes_ = 0;
+    fileIndex_ = 0;
     writeThread_ = nullptr;
-    deque_ = nullptr;
+    queue_ = nullptr;
     toDay_ = 0;
+    lastCheck_ = 0;
     fp_ = nullptr;
 }
 
@@ -22,18 +32,15 @@ Log::Log() {
 Log::~Log() {
     //检查是否已经创建写线程
     if (writeThread_ && writeThread_->joinable()) {
-        while (!deque_->empty()) {
-            deque_->flush();
-        };
-        //确保所有的日志消息都被写入磁盘，以避免丢失数据
-        deque_->Close();        //关闭写入队列
+        //关闭队列后写线程会取完剩余的日志再退出，以避免丢失数据
+        queue_->Close();        //关闭写入队列
         writeThread_->join();   //等待写线程退出
     }
     if (fp_) {  //如果文件指针fp_非空
         //加锁以确保线程安全
         lock_guard <mutex> locker(mtx_);
-        flush();    //刷新文件缓冲区
-        fclose(fp_);//关闭文件指针
+        fflush(fp_);    //刷新文件缓冲区
+        fclose(fp_);    //关闭文件指针
     }
 }
 
@@ -43,8 +50,8 @@ Log::~Log() {
  * @return int 
  */
 int Log::GetLevel() {
-    lock_guard <mutex> locker(mtx_);
-    return level_;
+    //每条日志都会调用,使用原子变量避免加锁
+    return level_.load(memory_order_relaxed);
 }
 
 /**
@@ -53,11 +60,8 @@ int Log::GetLevel() {
  * @param level 
  */
 void Log::SetLevel(int level) {
-    //对mtx_进行加锁，以确保线程安全
-    lock_guard <mutex> locker(mtx_);
     //将类成员变量level_设置为参数level，以更改日志级别
     level_ = level;
-    //在函数退出之前，std::lock_guard对象会自动解锁mtx_
 }
 
 /**
@@ -67,18 +71,34 @@ void Log::SetLevel(int level) {
  * @param path 
  * @param suffix 
  * @param maxQueueSize 
+ * @param binary 是否写二进制格式的日志,需要用 logdecode 工具查看
+ * @param maxFileBytes 日志文件超过该大小后滚动到新文件,0 表示只按日期滚动
+ * @param overflow 异步队列写满时的处理方式,见 OVERFLOW_POLICY
+ * @param retention 保留的已滚动文件个数,0 表示不清理
+ * @param compress 是否在后台把已滚动的文件压缩为 .gz
  */
 void Log::init(int level = 1, const char *path, const char *suffix,
-               int maxQueueSize) {
+               int maxQueueSize, bool binary, size_t maxFileBytes, int overflow,
+               int retention, bool compress) {
+    if (queue_) {
+        //重新初始化前先让写线程写完队列中按旧设置生成的日志
+        while (!queue_->empty()) {
+            queue_->Notify();
+            this_thread::yield();
+        }
+    }
     isOpen_ = true;     //表示打开日志文件
     level_ = level;
+    isBinary_ = binary;
+    maxFileBytes_ = maxFileBytes;
+    overflow_ = overflow;
     if (maxQueueSize > 0) {
         //启用异步写入方式
         isAsync_ = true;
-        if (!deque_) {
+        if (!queue_) {
             //使用unique_ptr来管理这些对象的生命周期，以避免内存泄漏
-            unique_ptr <BlockDeque<std::string>> newDeque(new BlockDeque<std::string>);
-            deque_ = move(newDeque);
+            //队列在第一次初始化时按 maxQueueSize 预先分配好全部槽位
+            queue_.reset(new LogRing(maxQueueSize));
 
             std::unique_ptr <std::thread> NewThread(new thread(FlushLogThread));
             writeThread_ = move(NewThread);
@@ -87,160 +107,306 @@ void Log::init(int level = 1, const char *path, const char *suffix,
         //启用同步写入方式
         isAsync_ = false;
     }
-    //将lineCount_计数器重置为0
-    lineCount_ = 0;
-
     //获取当前时间并根据时间设置日志文件名
     time_t timer = time(nullptr);
-    struct tm *sysTime = localtime(&timer);
-    struct tm t = *sysTime;
+    struct tm t;
+    localtime_r(&timer, &t);
     path_ = path;
     suffix_ = suffix;
     char fileName[LOG_NAME_LEN] = {0};
-    //格式化出文件名
-    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s",
-             path_, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, suffix_);
+    //格式化出文件名,当天已经滚动过时接着最后一个序号写,已经压缩的文件不再追加
+    char tail[36] = {0};
+    snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    bool archived = false;
+    fileIndex_ = LastIndex_(tail, archived);
+    if (archived) { fileIndex_++; }
+    if (fileIndex_ == 0) {
+        snprintf(fileName, LOG_NAME_LEN - 1, "%s/%s%s", path_, tail, suffix_);
+    } else {
+        snprintf(fileName, LOG_NAME_LEN - 1, "%s/%s-%d%s", path_, tail, fileIndex_, suffix_);
+    }
     toDay_ = t.tm_mday;
 
     {
         lock_guard <mutex> locker(mtx_);    //对日志对象的互斥量mtx_加锁
-        buff_.RetrieveAll();                //将缓冲区buff_清空并关闭当前打开的文件fp_
-        if (fp_) {
-            flush();
+        if (fp_) {                          //关闭当前打开的文件fp_
+            fflush(fp_);
             fclose(fp_);
         }
 
-        //重新打开一个新的日志文件，如果文件不存在，则需要先创建它
-        fp_ = fopen(fileName, "a");
-        if (fp_ == nullptr) {
-            //如果文件创建失败，则需要使用mkdir函数尝试创建目录，以确保能够正确写入日志
+        //重新打开一个新的日志文件，如果目录不存在，则需要先创建它
+        struct stat st;
+        if (stat(path_, &st) != 0) {
             mkdir(path_, 0777);
-            fp_ = fopen(fileName, "a");
         }
-        assert(fp_ != nullptr);
+        OpenFile_(fileName);
+        lastCheck_ = timer;
+    }
+    if (retention > 0 || compress) {
+        archiver_.Start(path_, suffix_, retention, compress);
+    }
+}
+
+/**
+ * @brief 找出目录中某一天最后滚动出的日志文件序号
+ * @param date 日期 YYYY_MM_DD
+ * @param archived 最后一个文件是否已经压缩
+ * @return 没有滚动过时返回 0
+ */
+int Log::LastIndex_(const char *date, bool &archived) {
+    int last = 0;
+    archived = false;
+    DIR *dir = opendir(path_);
+    if (!dir) { return 0; }
+    string prefix = date;
+    string gzSuffix = string(suffix_) + ".gz";
+    size_t suffixLen = strlen(suffix_);
+    while (struct dirent *ent = readdir(dir)) {
+        string name = ent->d_name;
+        if (name.compare(0, prefix.size(), prefix) != 0) { continue; }
+        bool gz = name.size() > gzSuffix.size() &&
+                  name.compare(name.size() - gzSuffix.size(), gzSuffix.size(), gzSuffix) == 0;
+        bool plain = name.size() > suffixLen &&
+                     name.compare(name.size() - suffixLen, suffixLen, suffix_) == 0;
+        if (!gz && !plain) { continue; }
+        int index = (name.size() > prefix.size() && name[prefix.size()] == '-') ?
+                    atoi(name.c_str() + prefix.size() + 1) : 0;
+        if (index > last || (index == last && gz)) {
+            last = index;
+            archived = gz;
+        }
+    }
+    closedir(dir);
+    return last;
+}
+
+/**
+ * @brief 打开(或追加写入)一个日志文件,调用者需要持有 mtx_
+ * @param fileName
+ */
+void Log::OpenFile_(const char *fileName) {
+    fp_ = fopen(fileName, "a");
+    assert(fp_ != nullptr);
+    struct stat st;
+    fileBytes_ = (stat(fileName, &st) == 0) ? st.st_size : 0;
+    fileName_ = fileName;
+    binLog_.ResetFile();
+}
+
+/**
+ * @brief 日期变化或文件超过 maxFileBytes_ 时滚动到新文件,调用者需要持有 mtx_
+ * 滚动只发生在写文件的一方(异步模式下为写线程),产生日志的线程不会因此停顿;
+ * 关闭的文件交给 archiver_ 在后台压缩和清理
+ */
+void Log::RotateIfNeeded_() {
+    bool newDay = false;
+    struct tm t;
+    time_t now = time(nullptr);
+    if (now != lastCheck_) {
+        lastCheck_ = now;
+        localtime_r(&now, &t);
+        newDay = (t.tm_mday != toDay_);
+    }
+    if (!newDay && (maxFileBytes_ == 0 || fileBytes_ < maxFileBytes_)) {
+        return;
+    }
+    if (!newDay) {
+        localtime_r(&now, &t);
+    }
+
+    char tail[36] = {0};
+    char newFile[LOG_NAME_LEN];
+    // 按照一定的格式生成新的日志文件名
+    snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    if (newDay) {
+        snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
+        toDay_ = t.tm_mday;
+        fileIndex_ = 0;
+    } else {
+        //跳过之前运行时已经用过(可能已被压缩)的序号
+        struct stat st;
+        do {
+            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail, ++fileIndex_, suffix_);
+        } while (stat(newFile, &st) == 0 || stat((string(newFile) + ".gz").c_str(), &st) == 0);
+    }
+
+    string closed = fileName_;
+    fflush(fp_);
+    fclose(fp_);
+    // 打开新的日志文件
+    OpenFile_(newFile);
+    if (closed != fileName_) {
+        archiver_.Submit(closed, fileName_);
     }
 }
 
 /**
  * @brief 往日志中写入一条日志信息
+ * 日志在线程自己的缓冲区中格式化,异步模式下再放入无锁队列,常见情况下不加锁
  * 
  * @param level 指定了日志的等级
  * @param format 指定了日志的具体格式
  * @param ... 
  */
 void Log::write(int level, const char *format, ...) {
+    static thread_local Buffer buff;    //当前线程格式化日志使用的缓冲区
     struct timeval now = {0, 0};
     gettimeofday(&now, nullptr);    //获取当前时间
-    time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
     va_list vaList;
 
-    /* 日志日期 日志行数 */
-    // 判断是否需要在新的文件中写日志
-    if (toDay_ != t.tm_mday || (lineCount_ && (lineCount_ % MAX_LINES == 0))) {
-        unique_lock <mutex> locker(mtx_);
-        locker.unlock();
+    if (isBinary_) {
+        //二进制格式只编码格式串编号和参数,省去时间与文本的格式化
+        va_start(vaList, format);
+        binLog_.Encode(buff, level, now.tv_sec * 1000000LL + now.tv_usec, format, vaList);
+        va_end(vaList);
+        Push_(buff.Peek(), buff.ReadableBytes());
+        buff.RetrieveAll();
+        return;
+    }
 
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = {0};
-        // 按照一定的格式生成新的日志文件名
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    time_t tSec = now.tv_sec;
+    struct tm t;
+    localtime_r(&tSec, &t);
 
-        if (toDay_ != t.tm_mday) {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
-            toDay_ = t.tm_mday;
-            lineCount_ = 0;
-        } else {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail, (lineCount_ / MAX_LINES), suffix_);
-        }
+    buff.EnsureWriteable(128);
+    int n = snprintf(buff.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
+                     t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+                     t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
 
-        locker.lock();
-        flush();
-        fclose(fp_);
-        // 打开新的日志文件
-        fp_ = fopen(newFile, "a");
-        assert(fp_ != nullptr);
-    }
+    buff.HasWritten(n);
+    // 添加日志级别到缓存中
+    AppendLogLevelTitle_(buff, level);
 
-    {
-        unique_lock <mutex> locker(mtx_);
-        lineCount_++;
-        int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
-                         t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-                         t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
+    va_start(vaList, format);
+    va_list vaCopy;
+    va_copy(vaCopy, vaList);
+    int m = vsnprintf(buff.BeginWrite(), buff.WritableBytes(), format, vaList);
+    if (m >= 0 && static_cast<size_t>(m) >= buff.WritableBytes()) {
+        //缓冲区不够时扩容后重新格式化
+        buff.EnsureWriteable(m + 1);
+        m = vsnprintf(buff.BeginWrite(), buff.WritableBytes(), format, vaCopy);
+    }
+    va_end(vaCopy);
+    va_end(vaList);
 
-        buff_.HasWritten(n);
-        // 添加日志级别到缓存中
-        AppendLogLevelTitle_(level);
+    buff.HasWritten(m > 0 ? m : 0);
+    buff.Append("\n", 1);
 
-        va_start(vaList, format);
-        int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
-        va_end(vaList);
-
-        buff_.HasWritten(m);
-        buff_.Append("\n\0", 2);
+    Push_(buff.Peek(), buff.ReadableBytes());
+    buff.RetrieveAll();
+}
 
-        // 如果开启异步模式，则将日志添加到阻塞队列中，否则直接写入文件
-        if (isAsync_ && deque_ && !deque_->full()) {
-            deque_->push_back(buff_.RetrieveAllToStr());
-        } else {
-            fputs(buff_.Peek(), fp_);
+/**
+ * @brief 把格式化好的一条日志交给写线程,同步模式下直接写文件
+ * 异步队列写满时按 overflow_ 处理,超过槽位大小的日志总是直接写文件
+ * @param data
+ * @param len
+ */
+void Log::Push_(const char *data, size_t len) {
+    if (isAsync_ && queue_) {
+        if (queue_->TryPush(data, len)) {
+            return;
+        }
+        if (len <= LogRing::SLOT_DATA) {
+            if (overflow_ == OVERFLOW_DROP) {
+                dropped_++;
+                return;
+            }
+            if (overflow_ == OVERFLOW_BLOCK) {
+                //唤醒写线程并退避等待,直到有空闲槽位
+                for (int spin = 0; !queue_->TryPush(data, len); spin++) {
+                    queue_->Notify();
+                    if (spin < 64) { this_thread::yield(); }
+                    else { this_thread::sleep_for(chrono::microseconds(50)); }
+                }
+                return;
+            }
         }
-        buff_.RetrieveAll();
+    }
+    lock_guard <mutex> locker(mtx_);
+    WriteLocked_(data, len);
+}
+
+/**
+ * @brief 将一条日志写入文件,调用者需要持有 mtx_
+ * @param data
+ * @param len
+ */
+void Log::WriteLocked_(const char *data, size_t len) {
+    RotateIfNeeded_();
+    if (isBinary_) {
+        fileBytes_ += binLog_.WriteRecord(fp_, data, len);
+    } else {
+        fileBytes_ += fwrite(data, 1, len, fp_);
     }
 }
 
 /**
  * @brief 在日志消息中添加与日志级别相对应的前缀
  * 
+ * @param buff 日志缓冲区
  * @param level 日志级别
  */
-void Log::AppendLogLevelTitle_(int level) {
+void Log::AppendLogLevelTitle_(Buffer &buff, int level) {
     switch (level) {
         case 0:
-            buff_.Append("[debug]: ", 9);
+            buff.Append("[debug]: ", 9);
             break;
         case 1:
-            buff_.Append("[info] : ", 9);
+            buff.Append("[info] : ", 9);
             break;
         case 2:
-            buff_.Append("[warn] : ", 9);
+            buff.Append("[warn] : ", 9);
             break;
         case 3:
-            buff_.Append("[error]: ", 9);
+            buff.Append("[error]: ", 9);
             break;
         default:
-            buff_.Append("[info] : ", 9);
+            buff.Append("[info] : ", 9);
             break;
     }
 }
 
 /**
  * @brief 刷新缓冲区中的数据
- * 
+ * 异步模式下只唤醒写线程,由写线程在队列写空时刷新文件
  */
 void Log::flush() {
     if (isAsync_) {
-        //将日志队列中的所有数据刷新到文件
-        deque_->flush();
+        //唤醒写线程把队列中的日志写入文件
+        queue_->Notify();
+        return;
     }
     //将缓冲区中的剩余数据写入文件
+    lock_guard <mutex> locker(mtx_);
     fflush(fp_);
 }
 
 /**
  * @brief 异步写日志
- * 
+ * 每次加锁后连续取出一批日志写入文件,队列写空时刷新文件并短暂等待
  */
 void Log::AsyncWrite_() {
-    string str = "";
-    //使用一个循环不断地从阻塞队列中取出日志信息,直到队列为空
-    while (deque_->pop(str)) {
-        //使用lock_guard保护mtx_的锁
-        lock_guard <mutex> locker(mtx_);
-        //将字符串写入文件
-        fputs(str.c_str(), fp_);
+    char data[LogRing::SLOT_DATA];
+    size_t len = 0;
+    while (true) {
+        int count = 0;
+        {
+            //使用lock_guard保护mtx_的锁
+            lock_guard <mutex> locker(mtx_);
+            while (count < 256 && queue_->TryPop(data, len)) {
+                WriteLocked_(data, len);
+                count++;
+            }
+            if (count == 0) {
+                fflush(fp_);
+            }
+        }
+        if (count == 0) {
+            //队列关闭且已经写空时退出
+            if (queue_->IsClosed() && queue_->empty()) { break; }
+            queue_->Wait(50);
+        }
     }
 }
 
@@ -2,6 +2,7 @@
 #define LOG_H
 
 #include <mutex>
+#include <atomic>
 #include <string>
 #include <thread>
 #include <sys/time.h>
@@ -9,14 +10,28 @@
 #include <stdarg.h>           // vastart va_end
 #include <assert.h>
 #include <sys/stat.h>         //mkdir
-#include "blockqueue.h"
+#include "logring.h"
+#include "binlog.h"
+#include "logarchiver.h"
 #include "../buffer/buffer.h"
 
 class Log {
 public:
+    //异步队列写满时的处理方式
+    enum OVERFLOW_POLICY {
+        OVERFLOW_BLOCK = 0,     //等待写线程腾出空间
+        OVERFLOW_DROP,          //丢弃新日志并计数
+        OVERFLOW_SPILL,         //在调用线程中直接写文件
+    };
+
     void init(int level, const char *path = "./log",
               const char *suffix = ".log",
-              int maxQueueCapacity = 1024);
+              int maxQueueCapacity = 1024,
+              bool binary = false,
+              size_t maxFileBytes = 64 * 1024 * 1024,
+              int overflow = OVERFLOW_SPILL,
+              int retention = 0,
+              bool compress = false);
 
     static Log *Instance();
 
@@ -32,38 +47,56 @@ public:
 
     bool IsOpen() { return isOpen_; }
 
+    uint64_t Dropped() const { return dropped_; }
+
 private:
     Log();
 
-    void AppendLogLevelTitle_(int level);
+    static void AppendLogLevelTitle_(Buffer &buff, int level);
 
     virtual ~Log();
 
     void AsyncWrite_();
 
+    void Push_(const char *data, size_t len);
+
+    void WriteLocked_(const char *data, size_t len);
+
+    void RotateIfNeeded_();
+
+    void OpenFile_(const char *fileName);
+
+    int LastIndex_(const char *date, bool &archived);
+
 private:
     static const int LOG_PATH_LEN = 256;    //日志文件路径的最大长度为256
     static const int LOG_NAME_LEN = 256;    //日志文件名的最大长度为256
-    static const int MAX_LINES = 50000;     //日志缓冲区中最多保存的日志行数为50000
 
     const char *path_;      //日志文件路径的指针
     const char *suffix_;    //日志文件名后缀的指针
 
-    int MAX_LINES_;         //日志缓冲区中最多保存的日志行数
-
-    int lineCount_;         //已经写入日志文件的日志行数
-    int toDay_;             //当前的日期，用于判断是否需要创建新的日志文件
+    int toDay_;             //当前文件的日期，用于判断是否需要创建新的日志文件
+    time_t lastCheck_;      //上一次检查日期的时间，每秒最多检查一次
 
     bool isOpen_;           //日志系统是否打开
 
-    Buffer buff_;           //日志缓冲区，用于存储待写入日志文件的内容
-    int level_;             //日志级别
+    std::atomic<int> level_;        //日志级别
     bool isAsync_;          //是否启用异步写日志
+    int overflow_;          //异步队列写满时的处理方式
+    std::atomic <uint64_t> dropped_;    //因队列写满而丢弃的日志条数
+    bool isBinary_;         //是否写二进制格式的日志
+
+    BinLog binLog_;         //二进制日志的编码器
+    size_t maxFileBytes_;   //日志文件的最大字节数，超过后由写文件的一方滚动到新文件
+    size_t fileBytes_;      //当前日志文件已写入的字节数
+    int fileIndex_;         //当天滚动出的日志文件序号
+    std::string fileName_;  //当前日志文件名
+    LogArchiver archiver_;  //在后台压缩与清理滚动出的日志文件
 
     FILE *fp_;              //日志文件指针，用于向文件中写入日志内容
-    std::unique_ptr <BlockDeque<std::string>> deque_;   //用于在异步写日志时实现线程安全的阻塞队列
+    std::unique_ptr <LogRing> queue_;                   //异步写日志使用的无锁环形队列
     std::unique_ptr <std::thread> writeThread_;         //用于异步写日志的线程指针
-    std::mutex mtx_;        //用于线程安全的互斥锁
+    std::mutex mtx_;        //保护日志文件,只有写文件的一方(写线程或同步写入)需要加锁
 };
 
 //宏LOG_BASE，用于记录日志
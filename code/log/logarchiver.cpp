@@ -0,0 +1,177 @@
+#include "logarchiver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <zlib.h>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * @brief 构造函数
+ */
+LogArchiver::LogArchiver() : retention_(0), compress_(false), isClose_(true) {}
+
+/**
+ * @brief 析构函数,处理完剩余的文件后退出
+ */
+LogArchiver::~LogArchiver() {
+    Stop();
+}
+
+/**
+ * @brief 设置整理参数并启动后台线程,已经启动时只更新参数
+ * @param dir 日志目录
+ * @param suffix 日志文件后缀
+ * @param retention 保留的已滚动文件个数,0 表示不清理
+ * @param compress 是否压缩已滚动的文件
+ */
+void LogArchiver::Start(const string &dir, const string &suffix, int retention, bool compress) {
+    lock_guard <mutex> locker(mtx_);
+    dir_ = dir;
+    suffix_ = suffix;
+    retention_ = retention;
+    compress_ = compress;
+    if (!thread_) {
+        isClose_ = false;
+        thread_.reset(new thread(&LogArchiver::Loop_, this));
+    }
+}
+
+/**
+ * @brief 停止后台线程
+ */
+void LogArchiver::Stop() {
+    {
+        lock_guard <mutex> locker(mtx_);
+        isClose_ = true;
+    }
+    cond_.notify_one();
+    if (thread_ && thread_->joinable()) {
+        thread_->join();
+    }
+    thread_.reset();
+}
+
+/**
+ * @brief 提交一个刚关闭的日志文件
+ * @param closedFile 刚关闭的文件
+ * @param currentFile 新打开的文件
+ */
+void LogArchiver::Submit(const string &closedFile, const string &currentFile) {
+    {
+        lock_guard <mutex> locker(mtx_);
+        current_ = currentFile;
+        files_.push_back(closedFile);
+    }
+    cond_.notify_one();
+}
+
+/**
+ * @brief 后台线程,先把自身调到最低的 CPU 与 IO 优先级
+ */
+void LogArchiver::Loop_() {
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    setpriority(PRIO_PROCESS, tid, 19);
+#ifdef SYS_ioprio_set
+    //IOPRIO_WHO_PROCESS = 1, IOPRIO_CLASS_IDLE = 3
+    syscall(SYS_ioprio_set, 1, tid, 3 << 13);
+#endif
+    unique_lock <mutex> locker(mtx_);
+    while (true) {
+        while (files_.empty() && !isClose_) {
+            cond_.wait(locker);
+        }
+        if (files_.empty()) { break; }
+        string file = files_.front();
+        files_.pop_front();
+        bool compress = compress_;
+        locker.unlock();
+        if (compress) {
+            Compress_(file);
+        }
+        //清理时要遍历目录、删除文件,只在锁内复制参数,滚动日志的写线程调用 Submit 时不会等待
+        locker.lock();
+        string dir = dir_, suffix = suffix_, current = current_;
+        int retention = retention_;
+        locker.unlock();
+        Prune_(dir, suffix, retention, current);
+        locker.lock();
+    }
+}
+
+/**
+ * @brief 把文件压缩为 file.gz 并删除原文件
+ * 先写入临时文件再改名,压缩到一半退出时不会留下损坏的 .gz
+ * @param file
+ * @return
+ */
+bool LogArchiver::Compress_(const string &file) {
+    FILE *in = fopen(file.c_str(), "rb");
+    if (!in) { return false; }
+    string tmp = file + ".gz.tmp";
+    gzFile out = gzopen(tmp.c_str(), "wb6");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+    char buff[65536];
+    size_t n;
+    bool ok = true;
+    while ((n = fread(buff, 1, sizeof(buff), in)) > 0) {
+        if (gzwrite(out, buff, static_cast<unsigned>(n)) != static_cast<int>(n)) {
+            ok = false;
+            break;
+        }
+    }
+    fclose(in);
+    if (gzclose(out) != Z_OK) { ok = false; }
+    if (!ok || rename(tmp.c_str(), (file + ".gz").c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    unlink(file.c_str());
+    return true;
+}
+
+/**
+ * @brief 删除多余的旧日志,只保留最近的 retention 个已滚动文件
+ * 只处理以日期开头、以日志后缀或日志后缀加 .gz 结尾的文件,参数是在锁内复制的副本,调用时不持有 mtx_
+ * 文件名为 YYYY_MM_DD[-N]后缀,按日期和序号排序,同一秒内滚动出的多个文件也能分出先后
+ * @param dirPath 日志目录
+ * @param suffix 日志文件后缀
+ * @param retention 保留的已滚动文件个数,0 表示不清理
+ * @param current 正在写入的日志文件
+ */
+void LogArchiver::Prune_(const string &dirPath, const string &suffix, int retention, const string &current) {
+    if (retention <= 0) { return; }
+    DIR *dir = opendir(dirPath.c_str());
+    if (!dir) { return; }
+    string gzSuffix = suffix + ".gz";
+    vector <pair<pair<string, int>, string>> files;
+    while (struct dirent *ent = readdir(dir)) {
+        string name = ent->d_name;
+        if (name.size() < 10 || !isdigit(name[0])) { continue; }
+        bool match = (name.size() > suffix.size() &&
+                      name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) ||
+                     (name.size() > gzSuffix.size() &&
+                      name.compare(name.size() - gzSuffix.size(), gzSuffix.size(), gzSuffix) == 0);
+        string path = dirPath + "/" + name;
+        if (!match || path == current) { continue; }
+        int index = (name[10] == '-') ? atoi(name.c_str() + 11) : 0;
+        files.emplace_back(make_pair(name.substr(0, 10), index), path);
+    }
+    closedir(dir);
+    if (files.size() <= static_cast<size_t>(retention)) { return; }
+    sort(files.begin(), files.end());
+    for (size_t i = 0; i + retention < files.size(); i++) {
+        unlink(files[i].second.c_str());
+    }
+}
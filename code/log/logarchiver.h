@@ -0,0 +1,47 @@
+#ifndef LOG_ARCHIVER_H
+#define LOG_ARCHIVER_H
+
+#include <mutex>
+#include <deque>
+#include <string>
+#include <thread>
+#include <memory>
+#include <condition_variable>
+
+//滚动出的日志文件的后台整理
+//在低优先级线程中把已关闭的日志文件压缩为 .gz,并只保留最近的 retention 个文件,
+//写日志的线程只需要把文件名交给它,不会因为压缩或删除文件而停顿
+class LogArchiver {
+public:
+    LogArchiver();
+
+    ~LogArchiver();
+
+    void Start(const std::string &dir, const std::string &suffix, int retention, bool compress);
+
+    void Stop();
+
+    void Submit(const std::string &closedFile, const std::string &currentFile);
+
+private:
+    void Loop_();
+
+    static bool Compress_(const std::string &file);
+
+    static void Prune_(const std::string &dirPath, const std::string &suffix, int retention,
+                       const std::string &current);
+
+    std::string dir_;           //日志目录
+    std::string suffix_;        //日志文件后缀
+    std::string current_;       //正在写入的日志文件,不参与清理
+    int retention_;             //保留的已滚动文件个数,0 表示不清理
+    bool compress_;             //是否压缩已滚动的文件
+
+    bool isClose_;
+    std::deque <std::string> files_;    //等待处理的已关闭文件
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::unique_ptr <std::thread> thread_;
+};
+
+#endif //LOG_ARCHIVER_H
@@ -0,0 +1,207 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <new>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+//预先分配的有界多生产者单消费者环形队列,每个槽位保存一条定长上限的日志
+//生产者通过 CAS 领取槽位,只在消费者睡眠时发出一次通知,不需要加锁;
+//消费者在队列为空时才会在条件变量上短暂等待
+class LogRing {
+public:
+    static const size_t SLOT_SIZE = 512;    //每个槽位占用的字节数
+    static const size_t SLOT_DATA = SLOT_SIZE - 2 * sizeof(size_t);  //每个槽位可保存的日志字节数
+
+    explicit LogRing(size_t capacity = 1024);
+
+    ~LogRing();
+
+    LogRing(const LogRing &) = delete;
+
+    LogRing &operator=(const LogRing &) = delete;
+
+    bool TryPush(const char *data, size_t len);
+
+    bool TryPop(char *data, size_t &len);
+
+    void Wait(int timeoutMs);
+
+    void Notify();
+
+    void Close();
+
+    bool IsClosed() const { return isClose_; }
+
+    bool empty() const;
+
+    size_t size() const;
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    //序号 seq 表示槽位状态: 等于写位置时可写,等于写位置+1 时可读
+    //槽位按缓存行对齐,大小是缓存行的整数倍,相邻槽位不会共享缓存行
+    struct alignas(64) Slot {
+        std::atomic <size_t> seq;
+        size_t len;
+        char data[SLOT_DATA];
+    };
+
+    Slot *slots_;                           //槽位数组,容量为 2 的幂,按缓存行对齐分配
+    size_t mask_;                           //容量减一,用于取模
+    char pad0_[64];
+    std::atomic <size_t> enqueuePos_;       //生产者领取的下一个写位置
+    char pad1_[64];
+    std::atomic <size_t> dequeuePos_;       //消费者的下一个读位置,只由消费者修改
+    char pad2_[64];
+    std::atomic<bool> sleeping_;            //消费者是否在等待
+    std::atomic<bool> isClose_;             //队列是否关闭
+
+    std::mutex mtx_;                        //只用于消费者等待
+    std::condition_variable cond_;          //唤醒消费者
+};
+
+/**
+ * @brief 构造函数,容量向上取整为 2 的幂,并初始化每个槽位的序号
+ * @param capacity
+ */
+inline LogRing::LogRing(size_t capacity) : enqueuePos_(0), dequeuePos_(0), sleeping_(false), isClose_(false) {
+    assert(capacity > 0);
+    size_t n = 1;
+    while (n < capacity) { n <<= 1; }
+    //std::vector 与 C++14 的 new 都不保证超过 16 字节的对齐
+    void *mem = nullptr;
+    if (posix_memalign(&mem, alignof(Slot), sizeof(Slot) * n) != 0) { throw std::bad_alloc(); }
+    slots_ = static_cast<Slot *>(mem);
+    mask_ = n - 1;
+    for (size_t i = 0; i < n; i++) {
+        new(&slots_[i]) Slot();
+        slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief 析构函数,槽位只含整数和字符数组,直接释放内存
+ */
+inline LogRing::~LogRing() {
+    free(slots_);
+}
+
+/**
+ * @brief 写入一条日志,队列已满或日志超过槽位大小时返回 false
+ * @param data
+ * @param len
+ * @return
+ */
+inline bool LogRing::TryPush(const char *data, size_t len) {
+    if (len > SLOT_DATA) { return false; }
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+        slot = &slots_[pos & mask_];
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            //槽位可写,尝试领取
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            //消费者还没有取走该槽位,队列已满
+            return false;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+    memcpy(slot->data, data, len);
+    slot->len = len;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief 取出一条日志,只能由唯一的消费者调用
+ * @param data 至少 SLOT_DATA 字节的输出缓冲区
+ * @param len 取出的日志长度
+ * @return 队列为空时返回 false
+ */
+inline bool LogRing::TryPop(char *data, size_t &len) {
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    Slot *slot = &slots_[pos & mask_];
+    size_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq != pos + 1) {
+        return false;
+    }
+    len = slot->len;
+    memcpy(data, slot->data, len);
+    //让出槽位,序号推进一圈后生产者才能再次写入
+    slot->seq.store(pos + mask_ + 1, std::memory_order_release);
+    dequeuePos_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief 消费者在队列为空时等待,最多等待 timeoutMs 毫秒
+ * 先置 sleeping_ 再检查队列,生产者先写入槽位再检查 sleeping_,两边之间都有 seq_cst 栅栏,
+ * 因此至少有一方能看到对方的写入:要么这里看到新日志不再等待,要么生产者看到 sleeping_ 并唤醒;
+ * 超时只是额外的保险
+ * @param timeoutMs
+ */
+inline void LogRing::Wait(int timeoutMs) {
+    std::unique_lock <std::mutex> locker(mtx_);
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (empty() && !isClose_) {
+        cond_.wait_for(locker, std::chrono::milliseconds(timeoutMs));
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 消费者正在等待时将其唤醒,在 TryPush 成功之后调用
+ * 消费者从置 sleeping_ 到开始等待期间一直持有 mtx_,加锁后再通知,通知不会落在这段时间里而丢失;
+ * 只有消费者睡眠时才加锁,平时只多一次栅栏和一次读
+ */
+inline void LogRing::Notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard <std::mutex> locker(mtx_);
+        cond_.notify_one();
+    }
+}
+
+/**
+ * @brief 关闭队列并唤醒消费者,消费者取完剩余的日志后退出
+ */
+inline void LogRing::Close() {
+    isClose_ = true;
+    std::lock_guard <std::mutex> locker(mtx_);
+    cond_.notify_all();
+}
+
+/**
+ * @brief 队列是否为空(消费者视角)
+ * @return
+ */
+inline bool LogRing::empty() const {
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    return slots_[pos & mask_].seq.load(std::memory_order_acquire) != pos + 1;
+}
+
+/**
+ * @brief 队列中大致的日志条数
+ * @return
+ */
+inline size_t LogRing::size() const {
+    size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+    size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+    return enq > deq ? enq - deq : 0;
+}
+
+#endif //LOG_RING_H
@@ -0,0 +1,246 @@
+#include "trafficcapture.h"
+
+#include <time.h>
+#include <assert.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+/**
+ * @brief 以 varint 格式(每字节 7 位,最高位表示后面还有字节)写入一个整数
+ * @param p 至少有 10 字节空间
+ * @param v
+ * @return 写入的字节数
+ */
+size_t PutVarint(char *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = static_cast<char>(v);
+    return n;
+}
+
+/**
+ * @brief 以小端格式写入一个整数
+ * @param p
+ * @param v
+ * @param size 字节数
+ */
+void PutLittle(char *p, uint64_t v, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        p[i] = static_cast<char>(v >> (8 * i));
+    }
+}
+
+}
+
+/**
+ * @brief 构造函数
+ */
+TrafficCapture::TrafficCapture() : isOpen_(false), full_(false), maxBytes_(0), flushIntervalMs_(1000),
+                                   bytes_(0), dropped_(0), nextConn_(0), firstConn_(1), fp_(nullptr) {}
+
+/**
+ * @brief 析构函数,把剩余的记录写入文件
+ */
+TrafficCapture::~TrafficCapture() {
+    Close();
+}
+
+/**
+ * @brief 单例
+ * @return
+ */
+TrafficCapture *TrafficCapture::Instance() {
+    static TrafficCapture inst;
+    return &inst;
+}
+
+/**
+ * @brief 创建录制文件并启动后台刷新线程,已经在录制时先结束原来的录制
+ * @param path 录制文件路径,已经存在时覆盖
+ * @param maxBytes 录制文件的最大字节数,达到后停止录制,0 表示不限制
+ * @param flushIntervalMs 批量写入文件的间隔
+ * @return 文件无法创建时返回 false
+ */
+bool TrafficCapture::Init(const char *path, size_t maxBytes, int flushIntervalMs) {
+    assert(path && flushIntervalMs > 0);
+    Close();
+    fp_ = fopen(path, "w");
+    if (fp_ == nullptr) {
+        //目录不存在时先创建目录
+        string dir(path);
+        size_t idx = dir.find_last_of('/');
+        if (idx != string::npos) {
+            mkdir(dir.substr(0, idx).c_str(), 0777);
+            fp_ = fopen(path, "w");
+        }
+    }
+    if (fp_ == nullptr) { return false; }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    char header[16] = {'W', 'C', 'A', 'P'};
+    PutLittle(header + 4, VERSION, 4);
+    PutLittle(header + 8, static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000, 8);
+    fwrite(header, 1, sizeof(header), fp_);
+
+    start_ = chrono::steady_clock::now();
+    maxBytes_ = maxBytes > 0 ? maxBytes : SIZE_MAX;
+    flushIntervalMs_ = flushIntervalMs;
+    bytes_ = sizeof(header);
+    full_ = false;
+    firstConn_ = nextConn_ + 1;
+    isOpen_ = true;
+    flushThread_.reset(new thread(&TrafficCapture::FlushLoop_, this));
+    return true;
+}
+
+/**
+ * @brief 结束录制,写出剩余记录并关闭文件
+ * 各线程的缓冲区保留给下一次录制使用
+ */
+void TrafficCapture::Close() {
+    if (!isOpen_) { return; }
+    {
+        lock_guard <mutex> locker(mtx_);
+        isOpen_ = false;
+    }
+    cond_.notify_one();
+    if (flushThread_ && flushThread_->joinable()) {
+        flushThread_->join();
+    }
+    flushThread_.reset();
+    fclose(fp_);
+    fp_ = nullptr;
+}
+
+/**
+ * @brief 记录一个新连接
+ * @return 连接编号,没有在录制时返回 0
+ */
+uint64_t TrafficCapture::Open() {
+    if (!isOpen_) { return 0; }
+    uint64_t conn = ++nextConn_;
+    Record_(CAPTURE_OPEN, conn, nullptr, 0);
+    return conn;
+}
+
+/**
+ * @brief 记录连接上一次 read 收到的数据
+ * @param conn Open 返回的连接编号,0 或本次录制开始之前的连接不录制
+ * @param data
+ * @param len
+ */
+void TrafficCapture::Data(uint64_t conn, const char *data, size_t len) {
+    Record_(CAPTURE_DATA, conn, data, len);
+}
+
+/**
+ * @brief 记录连接关闭
+ * @param conn
+ */
+void TrafficCapture::Closed(uint64_t conn) {
+    Record_(CAPTURE_CLOSE, conn, nullptr, 0);
+}
+
+/**
+ * @brief 获取当前线程的缓冲区,第一次调用时登记
+ * @return
+ */
+TrafficCapture::Chunk *TrafficCapture::LocalChunk_() {
+    static thread_local Chunk *chunk = nullptr;
+    if (chunk == nullptr) {
+        lock_guard <mutex> locker(mtx_);
+        chunks_.emplace_back(new Chunk());
+        chunk = chunks_.back().get();
+    }
+    return chunk;
+}
+
+/**
+ * @brief 编码一条记录追加到当前线程的缓冲区,缓冲区或文件已满时丢弃并计数,不会阻塞调用线程
+ * @param type
+ * @param conn
+ * @param data
+ * @param len
+ */
+void TrafficCapture::Record_(uint8_t type, uint64_t conn, const char *data, size_t len) {
+    if (!isOpen_ || full_ || conn < firstConn_) { return; }
+    uint64_t offset = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start_).count();
+    char head[1 + 3 * 10];
+    size_t headLen = 0;
+    head[headLen++] = static_cast<char>(type);
+    headLen += PutVarint(head + headLen, conn);
+    headLen += PutVarint(head + headLen, offset);
+    if (type == CAPTURE_DATA) {
+        headLen += PutVarint(head + headLen, len);
+    }
+    size_t size = headLen + len;
+    if (bytes_.fetch_add(size) + size > maxBytes_) {
+        full_ = true;
+        dropped_++;
+        return;
+    }
+
+    Chunk *chunk = LocalChunk_();
+    lock_guard <mutex> locker(chunk->mtx);
+    //Close 在最后一次取走缓冲区之前已经清除 isOpen_,之后的记录不能留到下一次录制
+    if (!isOpen_) { return; }
+    size_t before = chunk->buff.ReadableBytes();
+    if (before + size > CHUNK_LIMIT) {
+        dropped_++;
+        return;
+    }
+    chunk->buff.Append(head, headLen);
+    if (len > 0) {
+        chunk->buff.Append(data, len);
+    }
+    //缓冲区超过一半时提前唤醒刷新线程
+    if (before < CHUNK_LIMIT / 2 && before + size >= CHUNK_LIMIT / 2) {
+        cond_.notify_one();
+    }
+}
+
+/**
+ * @brief 刷新线程,每隔 flushIntervalMs_ 或被唤醒时批量写出记录
+ */
+void TrafficCapture::FlushLoop_() {
+    while (true) {
+        bool open;
+        {
+            unique_lock <mutex> locker(mtx_);
+            if (isOpen_) {
+                cond_.wait_for(locker, chrono::milliseconds(flushIntervalMs_));
+            }
+            open = isOpen_;
+        }
+        Drain_();
+        if (!open) { break; }
+    }
+}
+
+/**
+ * @brief 取出所有线程缓冲区中的记录,一次写入文件
+ */
+void TrafficCapture::Drain_() {
+    {
+        lock_guard <mutex> locker(mtx_);
+        for (auto &chunk: chunks_) {
+            lock_guard <mutex> chunkLocker(chunk->mtx);
+            if (chunk->buff.ReadableBytes() == 0) { continue; }
+            out_.Append(chunk->buff.Peek(), chunk->buff.ReadableBytes());
+            chunk->buff.RetrieveAll();
+        }
+    }
+    if (out_.ReadableBytes() > 0) {
+        fwrite(out_.Peek(), 1, out_.ReadableBytes(), fp_);
+        fflush(fp_);
+        out_.RetrieveAll();
+    }
+}
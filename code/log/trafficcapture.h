@@ -0,0 +1,86 @@
+#ifndef TRAFFIC_CAPTURE_H
+#define TRAFFIC_CAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+#include "../buffer/buffer.h"
+
+//流量录制: 把连接上收到的原始字节与到达时间写入文件,用 tools/replay 回放
+//文件格式(整数均为小端):
+//  文件头 16 字节: "WCAP" 版本号(uint32) 开始录制时的 Unix 时间(int64,微秒)
+//  之后每条记录: 类型(1 字节) 连接编号(varint) 距开始录制的时间(varint,微秒) [数据长度(varint) 数据]
+//  类型为 CAPTURE_OPEN / CAPTURE_DATA / CAPTURE_CLOSE,只有 CAPTURE_DATA 带数据
+//各线程的记录分别缓存后批量写入,文件中的记录不保证按时间排序,回放时先排序
+class TrafficCapture {
+public:
+    enum RecordType {
+        CAPTURE_OPEN = 1,       //连接建立
+        CAPTURE_DATA = 2,       //一次 read 收到的数据
+        CAPTURE_CLOSE = 3,      //连接关闭
+    };
+
+    static const uint32_t VERSION = 1;
+
+    static TrafficCapture *Instance();
+
+    bool Init(const char *path, size_t maxBytes, int flushIntervalMs = 1000);
+
+    void Close();
+
+    bool IsOpen() const { return isOpen_; }
+
+    uint64_t Open();
+
+    void Data(uint64_t conn, const char *data, size_t len);
+
+    void Closed(uint64_t conn);
+
+    uint64_t Dropped() const { return dropped_; }
+
+private:
+    TrafficCapture();
+
+    ~TrafficCapture();
+
+    //每个线程独占的缓冲区,只在刷新线程取走数据时才有争用
+    struct Chunk {
+        std::mutex mtx;
+        Buffer buff;
+    };
+
+    Chunk *LocalChunk_();
+
+    void Record_(uint8_t type, uint64_t conn, const char *data, size_t len);
+
+    void FlushLoop_();
+
+    void Drain_();
+
+    static const size_t CHUNK_LIMIT = 4 * 1024 * 1024; //单个线程缓存的最大字节数,超过后丢弃并计数
+
+    std::atomic<bool> isOpen_;          //是否正在录制
+    std::atomic<bool> full_;            //是否已经达到 maxBytes_
+    size_t maxBytes_;                   //录制文件的最大字节数
+    int flushIntervalMs_;               //批量写入的间隔
+    std::atomic <uint64_t> bytes_;      //已经录制(包括尚未写入文件)的字节数
+    std::atomic <uint64_t> dropped_;    //缓冲区满或文件达到上限而丢弃的记录数
+    std::atomic <uint64_t> nextConn_;   //下一个连接编号,在多次录制之间递增
+    uint64_t firstConn_;                //本次录制的第一个连接编号,更早建立的连接不录制
+    std::chrono::steady_clock::time_point start_;  //开始录制的时间
+
+    FILE *fp_;                          //录制文件
+    Buffer out_;                        //刷新线程写文件使用的缓冲区
+    std::vector <std::unique_ptr<Chunk>> chunks_;   //所有线程的缓冲区
+    std::mutex mtx_;                    //保护 chunks_ 与刷新线程的等待
+    std::condition_variable cond_;      //唤醒刷新线程
+    std::unique_ptr <std::thread> flushThread_; //后台刷新线程
+};
+
+#endif //TRAFFIC_CAPTURE_H
@@ -1,14 +1,82 @@
 #include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 #include "server/webserver.h"
+#include "server/master.h"
 
-int main() {
+/**
+ * @brief 把相对路径转换为相对于 cwd 的绝对路径,不解析符号链接
+ * @param cwd
+ * @param path
+ * @return
+ */
+static std::string AbsolutePath(const std::string &cwd, const std::string &path) {
+    if (path.empty() || path[0] == '/' || cwd.empty()) { return path; }
+    return cwd + "/" + path;
+}
+
+int main(int argc, char *argv[]) {
     /* 守护进程 后台运行 */
-    //daemon(1, 0); 
+    //daemon(1, 0);
+
+    //默认值 -> 配置文件(-c) -> 环境变量 WEBSERVER_SQL_PWD -> 命令行 --key=value
+    Config config;
+    std::vector <std::string> args;
+    bool printConfig = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            fputs(Config::Usage().c_str(), stdout);
+            return 0;
+        } else if (strcmp(argv[i], "--print-config") == 0) {
+            printConfig = true;
+        } else {
+            args.emplace_back(argv[i]);
+        }
+    }
+    //服务器构造时会切换工作目录,收到 SIGHUP 时再用相对路径就找不到配置文件,这里先转换为绝对路径
+    std::string cwd;
+    if (char *dir = getcwd(nullptr, 0)) {
+        cwd = dir;
+        free(dir);
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+        if ((args[i] == "-c" || args[i] == "--config") && i + 1 < args.size()) {
+            args[i + 1] = AbsolutePath(cwd, args[i + 1]);
+        } else if (args[i].compare(0, 9, "--config=") == 0) {
+            args[i] = "--config=" + AbsolutePath(cwd, args[i].substr(9));
+        }
+    }
+    std::string err;
+    if (!config.ParseArgs(args, err)) {
+        fprintf(stderr, "%s\nsee --help for all options\n", err.c_str());
+        return 1;
+    }
+    if (printConfig) {
+        //输出生效的配置(自动取值的项已替换为实际值),可以直接保存为配置文件
+        fputs(config.Resolved().Dump().c_str(), stdout);
+        return 0;
+    }
+
+    if (config.workers > 0) {
+        //prefork 模式: 本进程作为 master,监管 workers 个运行 WebServer 的工作进程
+        Master master(config, args);
+        return master.Run();
+    }
+
+    //平滑升级时在启动时的目录(上面记下的 cwd)用同样的命令行启动新进程
+    std::vector <std::string> command(argv, argv + argc);
+    //只转换为绝对路径,不解析符号链接: 部署时切换 current -> release-N 后,升级启动的是新版本
+    if (strchr(argv[0], '/')) {
+        command[0] = AbsolutePath(cwd, argv[0]);
+    }
 
-    WebServer server(
-            1316, 3, 60000, false,             /* 端口 ET模式 timeoutMs 优雅退出  */
-            3306, "root", "chen13076167297.", "webserver", /* Mysql配置 */
-            12, 6, true, 1, 1024);             /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+    WebServer server(config);
+    //收到 SIGHUP 时用同样的参数重新读取配置文件
+    server.SetReloader([args](Config &fresh, std::string &reloadErr) {
+        return fresh.ParseArgs(args, reloadErr);
+    });
+    //收到 SIGUSR2 时启动新进程并交出监听套接字(需要设置 upgradeSocket)
+    server.SetUpgradeCommand(cwd, command);
     server.Start();
-} 
-  
\ No newline at end of file
+}
@@ -0,0 +1,79 @@
+#include "histogram.h"
+
+using namespace std;
+
+/**
+ * @brief 构造函数
+ */
+Histogram::Histogram() : count_(0), sum_(0) {
+    for (auto &bucket: buckets_) {
+        bucket.store(0, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief 记录一个值,可以在任意线程中并发调用
+ * @param value
+ */
+void Histogram::Record(uint64_t value) {
+    buckets_[Index(value)].fetch_add(1, memory_order_relaxed);
+    count_.fetch_add(1, memory_order_relaxed);
+    sum_.fetch_add(value, memory_order_relaxed);
+}
+
+/**
+ * @brief 值所在的桶
+ * 小于 SUB_COUNT 的值每个值一个桶;之后最高位为 b 的值按其下面 SUB_BITS 位分到同一区间的 SUB_COUNT 个桶中
+ * @param value
+ * @return
+ */
+int Histogram::Index(uint64_t value) {
+    if (value < static_cast<uint64_t>(SUB_COUNT)) { return static_cast<int>(value); }
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= MAX_BITS) { return BUCKET_COUNT - 1; }
+    int shift = msb - SUB_BITS;
+    return (shift + 1) * SUB_COUNT + static_cast<int>((value >> shift) & (SUB_COUNT - 1));
+}
+
+/**
+ * @brief 桶所代表的值,取桶的中点
+ * @param index
+ * @return
+ */
+uint64_t Histogram::Midpoint(int index) {
+    if (index < SUB_COUNT) { return static_cast<uint64_t>(index); }
+    int shift = index / SUB_COUNT - 1;
+    uint64_t lower = static_cast<uint64_t>(SUB_COUNT + index % SUB_COUNT) << shift;
+    return lower + ((1ULL << shift) >> 1);
+}
+
+/**
+ * @brief 计算一组百分位数,基于同一次遍历,结果之间是一致的
+ * 记录与读取并发时读到的是近似的快照,对监控足够
+ * @param ps 百分位,0~1
+ * @return 与 ps 一一对应的值,没有记录时都为 0
+ */
+vector <uint64_t> Histogram::Percentiles(const vector<double> &ps) const {
+    vector <uint64_t> counts(BUCKET_COUNT);
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] = buckets_[i].load(memory_order_relaxed);
+        total += counts[i];
+    }
+    vector <uint64_t> result(ps.size(), 0);
+    if (total == 0) { return result; }
+    for (size_t k = 0; k < ps.size(); k++) {
+        //第 rank 个值(从 1 开始)所在的桶
+        uint64_t rank = static_cast<uint64_t>(ps[k] * total + 0.5);
+        rank = rank == 0 ? 1 : (rank > total ? total : rank);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                result[k] = Midpoint(i);
+                break;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,40 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+//对数线性分桶的直方图(HDR 风格),记录纳秒级的耗时
+//每个 2 的幂区间再等分为 SUB_COUNT 个桶,相对误差不超过 1/SUB_COUNT(约 6%),
+//从 1ns 到 2^40ns(约 18 分钟)只需要 592 个桶;记录是无锁的,只对一个桶做一次 relaxed 的 fetch_add
+class Histogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_COUNT = 1 << SUB_BITS;     //每个 2 的幂区间中的桶数
+    static const int MAX_BITS = 40;                 //超过 2^MAX_BITS 的值记入最后一个桶
+    static const int BUCKET_COUNT = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+    Histogram();
+
+    ~Histogram() = default;
+
+    void Record(uint64_t value);
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+
+    uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    std::vector <uint64_t> Percentiles(const std::vector<double> &ps) const;
+
+    static int Index(uint64_t value);
+
+    static uint64_t Midpoint(int index);
+
+private:
+    std::atomic <uint64_t> buckets_[BUCKET_COUNT];
+    std::atomic <uint64_t> count_;  //记录的个数
+    std::atomic <uint64_t> sum_;    //记录的值的总和
+};
+
+#endif //HISTOGRAM_H
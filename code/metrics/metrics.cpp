@@ -0,0 +1,204 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <new>
+
+using namespace std;
+
+thread_local Metrics::Shard *Metrics::shard_ = nullptr;
+Histogram Metrics::stages_[Metrics::STAGE_COUNT];
+
+namespace {
+
+//计数器的名称、标签与说明,顺序与 Metrics::Counter 相同
+struct CounterInfo {
+    const char *name;
+    const char *labels;
+    const char *help;
+};
+
+const CounterInfo COUNTERS[Metrics::COUNTER_COUNT] = {
+        {"webserver_http_requests_total",         "",                "Requests parsed successfully."},
+        {"webserver_http_bad_requests_total",     "",                "Requests that failed to parse."},
+        {"webserver_http_responses_total",        "{code=\"1xx\"}",  "Responses fully sent, by status class."},
+        {"webserver_http_responses_total",        "{code=\"2xx\"}",  ""},
+        {"webserver_http_responses_total",        "{code=\"3xx\"}",  ""},
+        {"webserver_http_responses_total",        "{code=\"4xx\"}",  ""},
+        {"webserver_http_responses_total",        "{code=\"5xx\"}",  ""},
+        {"webserver_http_received_bytes_total",   "",                "Bytes read from clients."},
+        {"webserver_http_sent_bytes_total",       "",                "Bytes of responses fully sent."},
+};
+
+//阶段名,顺序与 Metrics::Stage 相同
+const char *const STAGES[Metrics::STAGE_COUNT] = {"accept", "queue", "parse", "file", "write", "total"};
+
+//输出的分位数
+const char *const QUANTILE_LABELS[] = {"0.5", "0.9", "0.99", "0.999"};
+const vector<double> QUANTILES = {0.5, 0.9, 0.99, 0.999};
+
+}
+
+/**
+ * @brief 单例
+ * @return
+ */
+Metrics *Metrics::Instance() {
+    static Metrics metrics;
+    return &metrics;
+}
+
+/**
+ * @brief 为当前线程分配分片,每个线程只调用一次
+ * @return
+ */
+Metrics::Shard *Metrics::Register_() {
+    //C++14 的 new 不保证超过 16 字节的对齐,按缓存行分配,分片之间不会共用缓存行
+    void *mem = nullptr;
+    if (posix_memalign(&mem, alignof(Shard), sizeof(Shard)) != 0) { throw bad_alloc(); }
+    Shard *shard = new(mem) Shard();
+    for (auto &value: shard->values) {
+        value.store(0, memory_order_relaxed);
+    }
+    Metrics *metrics = Instance();
+    lock_guard <mutex> locker(metrics->mtx_);
+    metrics->shards_.push_back(shard);
+    shard_ = shard;
+    return shard;
+}
+
+/**
+ * @brief 记录一个发送完毕的响应
+ * @param code 状态码
+ * @param bytes 响应的字节数
+ */
+void Metrics::AddResponse(int code, uint64_t bytes) {
+    int cls = code / 100;
+    if (cls < 1 || cls > 5) { cls = 5; }
+    Add(static_cast<Counter>(HTTP_RESPONSES_1XX + cls - 1));
+    Add(HTTP_SENT_BYTES, bytes);
+}
+
+/**
+ * @brief 阶段名
+ * @param stage
+ * @return
+ */
+const char *Metrics::StageName(Stage stage) {
+    return STAGES[stage];
+}
+
+/**
+ * @brief 计数器在所有线程中的总和
+ * @param counter
+ * @return
+ */
+uint64_t Metrics::Value(Counter counter) {
+    lock_guard <mutex> locker(mtx_);
+    uint64_t sum = 0;
+    for (Shard *shard: shards_) {
+        sum += shard->values[counter].load(memory_order_relaxed);
+    }
+    return sum;
+}
+
+/**
+ * @brief 注册一个抓取时读取的指标
+ * @param name 指标名
+ * @param type "gauge" 或 "counter"(已有的累计计数)
+ * @param help 说明
+ * @param read 读取当前值,在抓取的线程中调用
+ */
+void Metrics::AddCallback(const string &name, const char *type, const string &help, function<double()> read) {
+    lock_guard <mutex> locker(mtx_);
+    callbacks_.push_back({name, type, help, move(read)});
+}
+
+/**
+ * @brief 注册一个抓取时直接输出若干行指标的函数
+ * @param collect
+ */
+void Metrics::AddCollector(function<void(string &)> collect) {
+    lock_guard <mutex> locker(mtx_);
+    collectors_.push_back(move(collect));
+}
+
+/**
+ * @brief 删除所有回调,回调引用的对象析构之前调用
+ */
+void Metrics::ClearCallbacks() {
+    lock_guard <mutex> locker(mtx_);
+    callbacks_.clear();
+    collectors_.clear();
+}
+
+/**
+ * @brief 按 Prometheus 文本格式输出一个不带标签的指标
+ * @param out
+ * @param name
+ * @param type
+ * @param help
+ * @param value
+ */
+void Metrics::Format(string &out, const string &name, const char *type, const string &help, double value) {
+    char num[32];
+    if (value == floor(value) && fabs(value) < 1e15) {
+        snprintf(num, sizeof(num), "%.0f", value);
+    } else {
+        snprintf(num, sizeof(num), "%.6g", value);
+    }
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+    out += name + " " + num + "\n";
+}
+
+/**
+ * @brief 汇总所有分片并读取回调,生成 Prometheus 文本格式的输出
+ * @return
+ */
+string Metrics::Render() {
+    lock_guard <mutex> locker(mtx_);
+    string out;
+    out.reserve(4096);
+    uint64_t sums[COUNTER_COUNT] = {0};
+    for (Shard *shard: shards_) {
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            sums[i] += shard->values[i].load(memory_order_relaxed);
+        }
+    }
+    char line[256];
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        const CounterInfo &info = COUNTERS[i];
+        //同名的计数器只输出一次 HELP 与 TYPE
+        if (i == 0 || string(COUNTERS[i - 1].name) != info.name) {
+            out += string("# HELP ") + info.name + " " + info.help + "\n";
+            out += string("# TYPE ") + info.name + " counter\n";
+        }
+        snprintf(line, sizeof(line), "%s%s %llu\n", info.name, info.labels, (unsigned long long) sums[i]);
+        out += line;
+    }
+    //各阶段的耗时,以 summary 输出自启动以来的分位数,单位为秒
+    out += "# HELP webserver_request_stage_seconds Time spent in each stage of request handling.\n";
+    out += "# TYPE webserver_request_stage_seconds summary\n";
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const Histogram &histogram = stages_[i];
+        vector <uint64_t> values = histogram.Percentiles(QUANTILES);
+        for (size_t k = 0; k < values.size(); k++) {
+            snprintf(line, sizeof(line), "webserver_request_stage_seconds{stage=\"%s\",quantile=\"%s\"} %.9g\n",
+                     STAGES[i], QUANTILE_LABELS[k], values[k] / 1e9);
+            out += line;
+        }
+        snprintf(line, sizeof(line), "webserver_request_stage_seconds_sum{stage=\"%s\"} %.9g\n"
+                                     "webserver_request_stage_seconds_count{stage=\"%s\"} %llu\n",
+                 STAGES[i], histogram.Sum() / 1e9, STAGES[i], (unsigned long long) histogram.Count());
+        out += line;
+    }
+    for (const Callback &callback: callbacks_) {
+        Format(out, callback.name, callback.type, callback.help, callback.read());
+    }
+    for (const auto &collect: collectors_) {
+        collect(out);
+    }
+    return out;
+}
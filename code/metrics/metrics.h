@@ -0,0 +1,114 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "histogram.h"
+
+//内置的监控指标,以 Prometheus 文本格式输出
+//计数器按线程分片: 每个线程第一次记录时分配一块独占缓存行的分片,之后只写自己的分片,
+//记录一次只是一次线程局部变量访问加一次普通的读和写,没有原子的读改写,也不会与其他线程争用缓存行;
+//只有抓取时才遍历所有分片求和。请求各阶段的耗时记录在无锁的直方图中,抓取时输出分位数。连接数、队列长度等瞬时值,以及各模块已有的计数,在抓取时通过回调读取
+class Metrics {
+public:
+    //按线程分片的计数器,同名不同标签的计数器要相邻
+    enum Counter {
+        HTTP_REQUESTS = 0,      //解析出的请求数
+        HTTP_BAD_REQUESTS,      //解析失败的请求数
+        HTTP_RESPONSES_1XX,     //发送完毕的响应数,按状态码分类
+        HTTP_RESPONSES_2XX,
+        HTTP_RESPONSES_3XX,
+        HTTP_RESPONSES_4XX,
+        HTTP_RESPONSES_5XX,
+        HTTP_RECEIVED_BYTES,    //从客户端读到的字节数
+        HTTP_SENT_BYTES,        //发送完毕的响应的字节数
+        COUNTER_COUNT,
+    };
+
+    //请求处理的各个阶段,耗时以纳秒记录在直方图中
+    enum Stage {
+        STAGE_ACCEPT = 0,       //监听事件就绪到连接加入 epoll
+        STAGE_QUEUE,            //在线程池队列中等待
+        STAGE_PARSE,            //解析请求
+        STAGE_FILE,             //生成响应(查找、stat、mmap 文件或读取缓存)
+        STAGE_WRITE,            //响应生成后到发送完毕,包括等待套接字可写
+        STAGE_TOTAL,            //读到请求到响应发送完毕
+        STAGE_COUNT,
+    };
+
+    static Metrics *Instance();
+
+    /**
+     * @brief 累加计数器,只写当前线程的分片
+     * 分片只有本线程写入,用 relaxed 的读和写代替 fetch_add,抓取线程读到的是某个时刻的完整值
+     * @param counter
+     * @param n
+     */
+    static void Add(Counter counter, uint64_t n = 1) {
+        Shard *shard = shard_;
+        if (shard == nullptr) { shard = Register_(); }
+        std::atomic <uint64_t> &value = shard->values[counter];
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static void AddResponse(int code, uint64_t bytes);
+
+    /**
+     * @brief 记录一个阶段的耗时,可以在任意线程中调用
+     * @param stage
+     * @param ns 纳秒
+     */
+    static void Observe(Stage stage, uint64_t ns) { stages_[stage].Record(ns); }
+
+    static const Histogram &StageHistogram(Stage stage) { return stages_[stage]; }
+
+    static const char *StageName(Stage stage);
+
+    uint64_t Value(Counter counter);
+
+    void AddCallback(const std::string &name, const char *type, const std::string &help,
+                     std::function<double()> read);
+
+    void AddCollector(std::function<void(std::string &)> collect);
+
+    void ClearCallbacks();
+
+    std::string Render();
+
+    static void Format(std::string &out, const std::string &name, const char *type,
+                       const std::string &help, double value);
+
+private:
+    struct alignas(64) Shard {
+        std::atomic <uint64_t> values[COUNTER_COUNT];
+    };
+
+    //抓取时读取的瞬时值或已有的计数
+    struct Callback {
+        std::string name;
+        const char *type;
+        std::string help;
+        std::function<double()> read;
+    };
+
+    Metrics() = default;
+
+    ~Metrics() = default;
+
+    static Shard *Register_();
+
+    static thread_local Shard *shard_;      //当前线程的分片
+    static Histogram stages_[STAGE_COUNT];  //各阶段的耗时
+
+    std::mutex mtx_;
+    std::vector<Shard *> shards_;           //所有线程的分片,线程退出后保留,计数不会丢失
+    std::vector <Callback> callbacks_;
+    std::vector <std::function<void(std::string &)>> collectors_;  //直接输出多行指标,例如带标签的一组值
+};
+
+#endif //METRICS_H
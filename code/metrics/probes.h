@@ -0,0 +1,29 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+//请求生命周期上的 USDT 静态探针,提供者名为 webserver,可以用 perf / bpftrace 挂载
+//使用 <sys/sdt.h>(systemtap-sdt-dev / systemtap-sdt-devel)时,每个探针编译为一条 nop 指令,
+//位置与参数的读取方式记录在 ELF 的 .note.stapsdt 段中,没有挂载时除了准备参数没有额外开销,
+//参数只应是已经算好的整数或指针;没有该头文件或定义了 WEBSERVER_NO_PROBES 时探针为空,参数不会被求值
+#if !defined(WEBSERVER_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define WEBSERVER_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef WEBSERVER_HAVE_PROBES
+#define WEBSERVER_PROBE(name) DTRACE_PROBE(webserver, name)
+#define WEBSERVER_PROBE1(name, a) DTRACE_PROBE1(webserver, name, a)
+#define WEBSERVER_PROBE2(name, a, b) DTRACE_PROBE2(webserver, name, a, b)
+#define WEBSERVER_PROBE3(name, a, b, c) DTRACE_PROBE3(webserver, name, a, b, c)
+#define WEBSERVER_PROBE4(name, a, b, c, d) DTRACE_PROBE4(webserver, name, a, b, c, d)
+#else
+#define WEBSERVER_PROBE(name) do {} while (0)
+#define WEBSERVER_PROBE1(name, a) do {} while (0)
+#define WEBSERVER_PROBE2(name, a, b) do {} while (0)
+#define WEBSERVER_PROBE3(name, a, b, c) do {} while (0)
+#define WEBSERVER_PROBE4(name, a, b, c, d) do {} while (0)
+#endif
+
+#endif //PROBES_H
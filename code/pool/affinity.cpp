@@ -0,0 +1,246 @@
+#include "affinity.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * @brief 解析 CPU 列表,格式与 /sys 和 taskset 相同,如 "0-3,8,10-11"
+ * @param list
+ * @return 排好序的 CPU 编号,格式错误的部分被忽略
+ */
+vector<int> Affinity::ParseCpuList(const string &list) {
+    vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == string::npos) { end = list.size(); }
+        string item = list.substr(pos, end - pos);
+        int first, last;
+        if (sscanf(item.c_str(), "%d-%d", &first, &last) == 2) {
+            for (int cpu = first; cpu <= last && cpu >= 0; cpu++) { cpus.push_back(cpu); }
+        } else if (sscanf(item.c_str(), "%d", &first) == 1 && first >= 0) {
+            cpus.push_back(first);
+        }
+        pos = end + 1;
+    }
+    sort(cpus.begin(), cpus.end());
+    cpus.erase(unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+/**
+ * @brief 把 CPU 编号格式化为紧凑的列表,与 ParseCpuList 互逆
+ * @param cpus 排好序的 CPU 编号
+ * @return
+ */
+string Affinity::FormatCpuList(const vector<int> &cpus) {
+    string list;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) { j++; }
+        if (!list.empty()) { list += ","; }
+        list += to_string(cpus[i]);
+        if (j > i) { list += "-" + to_string(cpus[j]); }
+        i = j + 1;
+    }
+    return list.empty() ? "-" : list;
+}
+
+/**
+ * @brief 进程允许使用的 CPU
+ * @return
+ */
+vector<int> Affinity::AllowedCpus() {
+    vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) { return cpus; }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) { cpus.push_back(cpu); }
+    }
+    return cpus;
+}
+
+/**
+ * @brief 读取 cgroup 的 CPU 配额(CFS quota / period),即进程最多能同时占满几个 CPU
+ * 先找 cgroup v2 的 cpu.max(进程所在的 cgroup,找不到时取挂载点根目录,容器内通常就是容器自己的 cgroup),
+ * 再找 cgroup v1 的 cpu.cfs_quota_us 与 cpu.cfs_period_us
+ * @return 没有限制或无法读取时返回 -1
+ */
+double Affinity::CpuQuota() {
+    vector <string> v2Paths;
+    FILE *fp = fopen("/proc/self/cgroup", "r");
+    if (fp) {
+        char line[1024];
+        while (fgets(line, sizeof(line), fp)) {
+            //cgroup v2 的条目格式为 "0::/path"
+            if (strncmp(line, "0::", 3) == 0) {
+                line[strcspn(line, "\n")] = '\0';
+                v2Paths.push_back(string("/sys/fs/cgroup") + (line + 3) + "/cpu.max");
+            }
+        }
+        fclose(fp);
+    }
+    v2Paths.push_back("/sys/fs/cgroup/cpu.max");
+    for (const string &path: v2Paths) {
+        fp = fopen(path.c_str(), "r");
+        if (!fp) { continue; }
+        char quota[32] = {0};
+        long long period = 0;
+        int n = fscanf(fp, "%31s %lld", quota, &period);
+        fclose(fp);
+        if (n != 2 || strcmp(quota, "max") == 0 || period <= 0) { return -1; }
+        return static_cast<double>(atoll(quota)) / period;
+    }
+    long long quota = -1, period = 0;
+    const char *dirs[] = {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"};
+    for (const char *dir: dirs) {
+        string base(dir);
+        FILE *q = fopen((base + "/cpu.cfs_quota_us").c_str(), "r");
+        FILE *p = fopen((base + "/cpu.cfs_period_us").c_str(), "r");
+        bool ok = q && p && fscanf(q, "%lld", &quota) == 1 && fscanf(p, "%lld", &period) == 1;
+        if (q) { fclose(q); }
+        if (p) { fclose(p); }
+        if (ok) {
+            return (quota > 0 && period > 0) ? static_cast<double>(quota) / period : -1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 进程实际可用的 CPU 数: 允许使用的 CPU 个数与 cgroup CPU 配额(向上取整)中较小的一个
+ * 用来推算线程池与连接池的默认大小
+ * @return 至少为 1
+ */
+int Affinity::AvailableCpus() {
+    int cpus = static_cast<int>(AllowedCpus().size());
+    double quota = CpuQuota();
+    if (quota > 0) {
+        int limit = static_cast<int>(quota);
+        if (limit < quota) { limit++; }
+        if (cpus == 0 || limit < cpus) { cpus = limit; }
+    }
+    return max(cpus, 1);
+}
+
+/**
+ * @brief 每个 NUMA 节点上允许使用的 CPU
+ * 没有 /sys/devices/system/node 时把所有 CPU 视为一个节点
+ * @return 下标为节点编号,没有可用 CPU 的节点为空
+ */
+vector <vector<int>> Affinity::Nodes() {
+    vector<int> allowed = AllowedCpus();
+    vector <vector<int>> nodes;
+    for (int node = 0;; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *fp = fopen(path, "r");
+        if (!fp) { break; }
+        char buff[1024] = {0};
+        if (!fgets(buff, sizeof(buff), fp)) { buff[0] = '\0'; }
+        fclose(fp);
+        buff[strcspn(buff, "\n")] = '\0';
+        vector<int> cpus;
+        for (int cpu: ParseCpuList(buff)) {
+            if (binary_search(allowed.begin(), allowed.end(), cpu)) { cpus.push_back(cpu); }
+        }
+        nodes.push_back(cpus);
+    }
+    if (nodes.empty()) { nodes.push_back(allowed); }
+    return nodes;
+}
+
+/**
+ * @brief 把 CPU 列表平分为 count 份,返回第 index 份;CPU 比份数少时轮流分配一个 CPU
+ * @param cpus
+ * @param index
+ * @param count
+ * @return
+ */
+static vector<int> Partition(const vector<int> &cpus, int index, int count) {
+    if (count <= 1 || cpus.empty()) { return cpus; }
+    size_t n = cpus.size();
+    if (n < static_cast<size_t>(count)) { return vector<int>(1, cpus[index % n]); }
+    size_t begin = n * index / count;
+    size_t end = n * (index + 1) / count;
+    return vector<int>(cpus.begin() + begin, cpus.begin() + end);
+}
+
+/**
+ * @brief 把配置中的 CPU 描述转换为 CPU 列表
+ * "" 表示不绑定;"auto" 选择可用 CPU 最多的节点,事件循环绑定到其中第一个 CPU,
+ * 工作线程绑定到同一节点上的其余 CPU,连接缓冲区与处理它们的线程都在同一个节点上;
+ * 其它取值按 CPU 列表解析。
+ * prefork 模式下 count 个工作进程各取一份: 列表按工作进程平分,事件循环各绑定一个不同的 CPU;
+ * "auto" 把所有节点的 CPU 按节点顺序平分,每个工作进程的事件循环绑定到自己那份的第一个 CPU,
+ * 工作线程使用其余的 CPU
+ * @param spec
+ * @param forLoop 是否为事件循环线程
+ * @param index 工作进程的序号
+ * @param count 工作进程数,单进程时为 1
+ * @return 空表示不绑定
+ */
+vector<int> Affinity::Resolve(const char *spec, bool forLoop, int index, int count) {
+    if (spec == nullptr || spec[0] == '\0') { return vector<int>(); }
+    if (strcmp(spec, "auto") != 0) {
+        vector<int> allowed = AllowedCpus();
+        vector<int> cpus;
+        for (int cpu: ParseCpuList(spec)) {
+            if (binary_search(allowed.begin(), allowed.end(), cpu)) { cpus.push_back(cpu); }
+        }
+        if (forLoop && count > 1 && !cpus.empty()) { return vector<int>(1, cpus[index % cpus.size()]); }
+        return Partition(cpus, index, count);
+    }
+    if (count > 1) {
+        vector<int> all;
+        for (auto &cpus: Nodes()) { all.insert(all.end(), cpus.begin(), cpus.end()); }
+        vector<int> part = Partition(all, index, count);
+        if (part.empty()) { return part; }
+        if (forLoop) { return vector<int>(1, part[0]); }
+        if (part.size() > 1) { part.erase(part.begin()); }
+        return part;
+    }
+    vector<int> best;
+    for (auto &cpus: Nodes()) {
+        if (cpus.size() > best.size()) { best = cpus; }
+    }
+    if (best.empty()) { return best; }
+    if (forLoop) { return vector<int>(1, best[0]); }
+    if (best.size() > 1) { best.erase(best.begin()); }
+    return best;
+}
+
+/**
+ * @brief 把当前线程绑定到一组 CPU 上
+ * @param cpus
+ * @return
+ */
+bool Affinity::PinCurrentThread(const vector<int> &cpus) {
+    if (cpus.empty()) { return false; }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu: cpus) {
+        if (cpu < CPU_SETSIZE) { CPU_SET(cpu, &set); }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/**
+ * @brief 描述检测到的拓扑,用于启动日志
+ * @return 如 "2 node(s), node0: 0-15, node1: 16-31"
+ */
+string Affinity::Describe() {
+    vector <vector<int>> nodes = Nodes();
+    string desc = to_string(nodes.size()) + " node(s)";
+    for (size_t i = 0; i < nodes.size(); i++) {
+        desc += ", node" + to_string(i) + ": " + FormatCpuList(nodes[i]);
+    }
+    return desc;
+}
@@ -0,0 +1,31 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <string>
+#include <vector>
+
+//CPU 亲和性与 NUMA 拓扑
+//拓扑从 /sys/devices/system/node 读取,只考虑进程允许使用的 CPU(sched_getaffinity,包含 cgroup cpuset 的限制);
+//线程在开始工作前绑定,之后分配的线程栈、线程局部缓冲区等内存按首次访问落在本地节点上
+class Affinity {
+public:
+    static std::vector<int> ParseCpuList(const std::string &list);
+
+    static std::string FormatCpuList(const std::vector<int> &cpus);
+
+    static std::vector<int> AllowedCpus();
+
+    static std::vector <std::vector<int>> Nodes();
+
+    static double CpuQuota();
+
+    static int AvailableCpus();
+
+    static std::vector<int> Resolve(const char *spec, bool forLoop, int index = 0, int count = 1);
+
+    static bool PinCurrentThread(const std::vector<int> &cpus);
+
+    static std::string Describe();
+};
+
+#endif //AFFINITY_H
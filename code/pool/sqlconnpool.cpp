@@ -1,4 +1,5 @@
 #include "sqlconnpool.h"
+#include "../metrics/probes.h"
 
 using namespace std;
 
@@ -68,6 +69,7 @@ MYSQL *SqlConnPool::GetConn() {
         return nullptr;
     }
     //先等待信号量semId_的值减一，表示有一个连接被占用
+    WEBSERVER_PROBE(sql_wait);
     sem_wait(&semId_);
     {
         //获取锁并从连接队列connQue_中获取一个连接
@@ -75,6 +77,7 @@ MYSQL *SqlConnPool::GetConn() {
         sql = connQue_.front();
         connQue_.pop();
     }
+    WEBSERVER_PROBE1(sql_acquire, sql);
     //然后将信号量semId_的值加一，表示连接被释放
     //最后返回获取到的连接
     return sql;
@@ -86,6 +89,7 @@ MYSQL *SqlConnPool::GetConn() {
  */
 void SqlConnPool::FreeConn(MYSQL *sql) {
     assert(sql);    //确保sql不是null
+    WEBSERVER_PROBE1(sql_release, sql);
     //通过互斥锁将连接放回队列中
     lock_guard <mutex> locker(mtx_);
     connQue_.push(sql);
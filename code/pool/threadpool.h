@@ -6,6 +6,8 @@
 #include <queue>
 #include <thread>
 #include <functional>
+#include <vector>
+#include "affinity.h"
 
 //实现简单的线程池
 class ThreadPool {
@@ -13,8 +15,10 @@ public:
     /**
      * @brief 构造函数
      * @param threadCount 指定线程池的线程数量,默认是8个线程
+     * @param cpus 工作线程绑定的 CPU,为空时不绑定
      */
-    explicit ThreadPool(size_t threadCount = 8) : pool_(std::make_shared<Pool>()) {
+    explicit ThreadPool(size_t threadCount = 8, const std::vector<int> &cpus = std::vector<int>())
+            : pool_(std::make_shared<Pool>()) {
         //使用了std::make_shared<Pool>()来创建一个共享指针pool_
         //Pool结构体中包含一个互斥量mtx、
         //一个条件变量cond、
@@ -25,7 +29,9 @@ public:
         for (size_t i = 0; i < threadCount; i++) {
             //每个线程执行一个Lambda表达式，
             //Lambda表达式中创建一个std::unique_lockstd::mutex类型的locker对象来锁定互斥量mtx
-            std::thread([pool = pool_] {
+            threads_.emplace_back([pool = pool_, cpus] {
+                //在处理任务之前绑定 CPU,线程之后首次访问的内存分配在本地 NUMA 节点上
+                Affinity::PinCurrentThread(cpus);
                 std::unique_lock <std::mutex> locker(pool->mtx);
                 while (true) {
                     //如果tasks队列不为空
@@ -40,7 +46,7 @@ public:
                         //进入条件变量cond的等待状态，等待其他线程的通知
                     else pool->cond.wait(locker);
                 }
-            }).detach();    //将线程设置为分离状态
+            });
         }
     }
 
@@ -52,6 +58,14 @@ public:
      * 析构函数，在销毁对象时关闭线程池
      */
     ~ThreadPool() {
+        Close();
+    }
+
+    /**
+     * @brief 关闭线程池,等待工作线程执行完队列中的任务后退出
+     * 任务引用了其他对象时,应在销毁这些对象之前调用;执行中的任务仍可以继续添加任务
+     */
+    void Close() {
         //检查线程池的智能指针是否指向了一个有效的 Pool 对象
         if (static_cast<bool>(pool_)) {
             {
@@ -63,6 +77,11 @@ public:
             //唤醒所有被等待在条件变量上的线程
             pool_->cond.notify_all();
         }
+        for (auto &thread: threads_) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
         //这样，线程池就能够被安全地销毁，不会有任何线程在后台运行
     }
 
@@ -84,6 +103,15 @@ public:
         pool_->cond.notify_one();
     }
 
+    /**
+     * @brief 等待执行的任务数
+     * @return
+     */
+    size_t QueueSize() {
+        std::lock_guard <std::mutex> locker(pool_->mtx);
+        return pool_->tasks.size();
+    }
+
 private:
     struct Pool {
         std::mutex mtx;
@@ -92,6 +120,7 @@ private:
         std::queue <std::function<void()>> tasks;
     };
     std::shared_ptr <Pool> pool_;
+    std::vector <std::thread> threads_;    //工作线程,关闭时等待它们退出
 };
 
 
@@ -0,0 +1,115 @@
+#include "userstore.h"
+
+#include <mysql/mysql.h>
+#include "sqlconnpool.h"
+#include "sqlconnRAII.h"
+
+using namespace std;
+
+namespace {
+
+/**
+ * @brief 转义后作为 SQL 字符串字面量
+ * @param sql
+ * @param value
+ * @return
+ */
+string Quote(MYSQL *sql, const string &value) {
+    string escaped(value.size() * 2 + 1, '\0');
+    unsigned long len = mysql_real_escape_string(sql, &escaped[0], value.c_str(), value.size());
+    escaped.resize(len);
+    return "'" + escaped + "'";
+}
+
+/**
+ * @brief 查询用户的密码
+ * @param sql
+ * @param name
+ * @param pwd 用户存在时写入密码
+ * @return 用户是否存在
+ */
+bool FindUser(MYSQL *sql, const string &name, string &pwd) {
+    string order = "SELECT username, password FROM user WHERE username=" + Quote(sql, name) + " LIMIT 1";
+    LOG_DEBUG("%s", order.c_str());
+    if (mysql_query(sql, order.c_str())) { return false; }
+    MYSQL_RES *res = mysql_store_result(sql);
+    if (res == nullptr) { return false; }
+    bool found = false;
+    if (MYSQL_ROW row = mysql_fetch_row(res)) {
+        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
+        pwd = row[1] ? row[1] : "";
+        found = true;
+    }
+    mysql_free_result(res);
+    return found;
+}
+
+}
+
+/**
+ * @brief 全局的当前实现,第一次使用时为 SqlUserStore
+ * @return
+ */
+shared_ptr<UserStore> &UserStore::Global_() {
+    static shared_ptr<UserStore> global(make_shared<SqlUserStore>());
+    return global;
+}
+
+/**
+ * @brief 获取当前的实现,处理请求时调用
+ * @return
+ */
+shared_ptr<UserStore> UserStore::Current() {
+    return atomic_load(&Global_());
+}
+
+/**
+ * @brief 替换当前的实现,正在处理的请求继续使用旧的实现
+ * @param store
+ */
+void UserStore::Set(shared_ptr<UserStore> store) {
+    atomic_store(&Global_(), move(store));
+}
+
+bool SqlUserStore::Verify(const string &name, const string &pwd) {
+    MYSQL *sql;
+    SqlConnRAII conn(&sql, SqlConnPool::Instance());
+    if (sql == nullptr) { return false; }
+    string password;
+    if (!FindUser(sql, name, password)) { return false; }
+    if (pwd != password) {
+        LOG_DEBUG("pwd error!");
+        return false;
+    }
+    return true;
+}
+
+bool SqlUserStore::Register(const string &name, const string &pwd) {
+    MYSQL *sql;
+    SqlConnRAII conn(&sql, SqlConnPool::Instance());
+    if (sql == nullptr) { return false; }
+    string password;
+    if (FindUser(sql, name, password)) {
+        LOG_DEBUG("user used!");
+        return false;
+    }
+    string order = "INSERT INTO user(username, password) VALUES(" + Quote(sql, name) + "," + Quote(sql, pwd) + ")";
+    LOG_DEBUG("%s", order.c_str());
+    if (mysql_query(sql, order.c_str())) {
+        LOG_DEBUG("Insert error!");
+        return false;
+    }
+    LOG_DEBUG("regirster!");
+    return true;
+}
+
+bool MemoryUserStore::Verify(const string &name, const string &pwd) {
+    lock_guard <mutex> locker(mtx_);
+    auto it = users_.find(name);
+    return it != users_.end() && it->second == pwd;
+}
+
+bool MemoryUserStore::Register(const string &name, const string &pwd) {
+    lock_guard <mutex> locker(mtx_);
+    return users_.emplace(name, pwd).second;
+}
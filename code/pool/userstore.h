@@ -0,0 +1,59 @@
+#ifndef USERSTORE_H
+#define USERSTORE_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+//用户账号的存储,登录与注册只通过这个接口访问
+//默认使用数据库连接池中的 MySQL(SqlUserStore);测试和基准中可以换成内存中的实现,不需要数据库
+class UserStore {
+public:
+    virtual ~UserStore() = default;
+
+    /**
+     * @brief 登录: 检查用户名与密码是否匹配
+     * @param name
+     * @param pwd
+     * @return
+     */
+    virtual bool Verify(const std::string &name, const std::string &pwd) = 0;
+
+    /**
+     * @brief 注册: 用户名未被使用时添加用户
+     * @param name
+     * @param pwd
+     * @return 用户名已存在或写入失败时返回 false
+     */
+    virtual bool Register(const std::string &name, const std::string &pwd) = 0;
+
+    static std::shared_ptr<UserStore> Current();
+
+    static void Set(std::shared_ptr<UserStore> store);
+
+private:
+    static std::shared_ptr<UserStore> &Global_();
+};
+
+//保存在 MySQL user 表中的账号,每次访问从 SqlConnPool 取一个连接
+class SqlUserStore : public UserStore {
+public:
+    bool Verify(const std::string &name, const std::string &pwd) override;
+
+    bool Register(const std::string &name, const std::string &pwd) override;
+};
+
+//保存在内存中的账号,进程退出后丢失,用于测试与基准
+class MemoryUserStore : public UserStore {
+public:
+    bool Verify(const std::string &name, const std::string &pwd) override;
+
+    bool Register(const std::string &name, const std::string &pwd) override;
+
+private:
+    std::mutex mtx_;
+    std::unordered_map <std::string, std::string> users_;   //用户名与密码
+};
+
+#endif //USERSTORE_H
@@ -0,0 +1,98 @@
+#include "admission.h"
+
+using namespace std;
+
+/**
+ * @brief 构造函数,默认只限制连接数
+ */
+Admission::Admission() : maxConns_(0), maxQueue_(0), maxP99Us_(0), cur_(0), windowStart_(0), p99Us_(0) {
+    for (auto &window: buckets_) {
+        for (auto &bucket: window) { bucket = 0; }
+    }
+    for (auto &count: shed_) { count = 0; }
+    Init(65536, 0, 0, 1);
+}
+
+/**
+ * @brief 设置各项负载信号的上限,并生成 503 响应
+ * @param maxConns 连接数上限
+ * @param maxQueue 线程池等待队列长度上限,0 表示不检查
+ * @param maxP99Ms 请求耗时 p99 上限(毫秒),0 表示不检查
+ * @param retryAfterSec 503 响应中 Retry-After 的秒数
+ */
+void Admission::Init(int maxConns, size_t maxQueue, int maxP99Ms, int retryAfterSec) {
+    maxConns_ = maxConns;
+    maxQueue_ = maxQueue;
+    maxP99Us_ = maxP99Ms > 0 ? static_cast<uint32_t>(maxP99Ms) * 1000 : 0;
+
+    string body = "<html><title>Error</title><body bgcolor=\"ffffff\">503 : Service Unavailable\n"
+                  "<p>Server busy, please retry later.</p><hr><em>TinyWebServer</em></body></html>";
+    busyResponse_ = "HTTP/1.1 503 Service Unavailable\r\n"
+                    "Retry-After: " + to_string(retryAfterSec) + "\r\n"
+                    "Connection: close\r\n"
+                    "Content-type: text/html\r\n"
+                    "Content-length: " + to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+/**
+ * @brief 判断是否接收一个新连接,只由事件循环线程调用
+ * @param conns 当前连接数
+ * @param queueDepth 线程池等待队列长度
+ * @return DECISION
+ */
+int Admission::Check(int conns, size_t queueDepth) {
+    time_t now = time(nullptr);
+    if (now != windowStart_) {
+        Rotate_(now);
+    }
+    if (conns >= maxConns_) {
+        return SHED_CONNS;
+    }
+    if (maxQueue_ > 0 && queueDepth >= maxQueue_) {
+        return SHED_QUEUE;
+    }
+    if (maxP99Us_ > 0 && p99Us_ > maxP99Us_) {
+        return SHED_LATENCY;
+    }
+    return ADMIT;
+}
+
+/**
+ * @brief 记录一个请求的耗时,可以在任意线程中调用
+ * @param us 从读到请求到响应发送完毕的耗时,微秒
+ */
+void Admission::RecordLatency(uint32_t us) {
+    buckets_[cur_.load(memory_order_relaxed)][Histogram::Index(us)].fetch_add(1, memory_order_relaxed);
+}
+
+/**
+ * @brief 切换统计窗口,并用刚结束的窗口计算 p99
+ * 窗口每秒切换一次,样本太少时沿用之前的结果逐步衰减
+ * @param now
+ */
+void Admission::Rotate_(time_t now) {
+    int old = cur_.load(memory_order_relaxed);
+    cur_.store(1 - old, memory_order_relaxed);
+    windowStart_ = now;
+
+    uint64_t counts[BUCKETS];
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] = buckets_[old][i].exchange(0, memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total < MIN_SAMPLES) {
+        p99Us_ = p99Us_ / 2;
+        return;
+    }
+    uint64_t rank = total - total / 100;   //第 99% 个样本
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            //取桶的中点;按 2 的幂分桶时只能取区间上界,最多会高估一倍
+            p99Us_ = static_cast<uint32_t>(Histogram::Midpoint(i));
+            return;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <string>
+#include "../metrics/histogram.h"
+
+//接入控制,在 accept 时根据实时负载决定是否接收新连接
+//负载信号包括当前连接数、线程池等待队列长度和最近一秒请求耗时的 p99;
+//拒绝时返回预先生成好的 503 响应,而不是让服务器在过载后整体变慢
+class Admission {
+public:
+    enum DECISION {
+        ADMIT = 0,          //接收
+        SHED_CONNS,         //连接数达到上限
+        SHED_QUEUE,         //线程池等待队列过长
+        SHED_LATENCY,       //请求耗时过高
+        DECISION_COUNT,
+    };
+
+    Admission();
+
+    ~Admission() = default;
+
+    void Init(int maxConns, size_t maxQueue, int maxP99Ms, int retryAfterSec);
+
+    int Check(int conns, size_t queueDepth);
+
+    void RecordLatency(uint32_t us);
+
+    /**
+     * @brief 上一个统计周期中请求耗时的 p99,微秒
+     * @return
+     */
+    uint32_t P99Us() const { return p99Us_; }
+
+    /**
+     * @brief 预先生成的 503 响应
+     * @return
+     */
+    const std::string &BusyResponse() const { return busyResponse_; }
+
+    /**
+     * @brief 因某个原因拒绝的连接数
+     * @param decision
+     * @return
+     */
+    uint64_t Shed(int decision) const { return shed_[decision]; }
+
+    void CountShed(int decision) { shed_[decision]++; }
+
+private:
+    void Rotate_(time_t now);
+
+    static const int BUCKETS = Histogram::BUCKET_COUNT; //与 Histogram 相同的对数线性分桶,相对误差约 6%
+    static const uint64_t MIN_SAMPLES = 20; //样本太少时不计算 p99
+
+    int maxConns_;          //连接数上限
+    size_t maxQueue_;       //线程池等待队列长度上限,0 表示不检查
+    uint32_t maxP99Us_;     //请求耗时 p99 上限,0 表示不检查
+    std::string busyResponse_;  //503 响应
+
+    std::atomic<int> cur_;                          //正在记录的统计窗口
+    std::atomic <uint64_t> buckets_[2][BUCKETS];    //两个统计窗口轮流使用
+    time_t windowStart_;                            //当前窗口的开始时间,只由事件循环线程访问
+    std::atomic <uint32_t> p99Us_;                  //上一个窗口的 p99
+    std::atomic <uint64_t> shed_[DECISION_COUNT];   //按原因统计的拒绝次数
+};
+
+#endif //ADMISSION_H
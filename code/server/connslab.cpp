@@ -0,0 +1,53 @@
+#include "connslab.h"
+
+#include <stdlib.h>
+#include <new>
+
+using namespace std;
+
+/**
+ * @brief 构造函数,一次性分配好索引数组,连接对象按需分组分配
+ * @param maxFd 可容纳的最大文件描述符(不含)
+ */
+ConnSlab::ConnSlab(int maxFd) : capacity_(maxFd), index_(maxFd, nullptr),
+                                chunks_((maxFd + CHUNK_SIZE - 1) / CHUNK_SIZE) {
+    assert(maxFd > 0);
+}
+
+/**
+ * @brief 取得 fd 对应的连接对象,所在的一组还未分配时先分配
+ * 只由事件循环线程调用,chunks_ 与 index_ 的大小固定,不会重新分配
+ * @param fd
+ * @return fd 超出范围时返回 nullptr
+ */
+HttpConn *ConnSlab::Acquire(int fd) {
+    if (fd < 0 || fd >= capacity_) { return nullptr; }
+    if (index_[fd] == nullptr) {
+        int chunk = fd / CHUNK_SIZE;
+        assert(!chunks_[chunk]);
+        //C++14 的 new 不保证超过 16 字节的对齐,按缓存行分配,热字段不会跨缓存行
+        void *mem = nullptr;
+        if (posix_memalign(&mem, alignof(HttpConn), sizeof(HttpConn) * CHUNK_SIZE) != 0) { throw bad_alloc(); }
+        HttpConn *conns = static_cast<HttpConn *>(mem);
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            new(conns + i) HttpConn();
+        }
+        chunks_[chunk].reset(conns);
+        int base = chunk * CHUNK_SIZE;
+        for (int i = 0; i < CHUNK_SIZE && base + i < capacity_; i++) {
+            index_[base + i] = &chunks_[chunk][i];
+        }
+    }
+    return index_[fd];
+}
+
+/**
+ * @brief 析构一组连接对象并释放内存
+ * @param conns
+ */
+void ConnSlab::ChunkDeleter::operator()(HttpConn *conns) const {
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        conns[i].~HttpConn();
+    }
+    free(conns);
+}
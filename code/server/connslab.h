@@ -0,0 +1,50 @@
+#ifndef CONN_SLAB_H
+#define CONN_SLAB_H
+
+#include <vector>
+#include <memory>
+#include <assert.h>
+#include "../http/httpconn.h"
+
+//按文件描述符下标索引的连接表,替代 unordered_map<int, HttpConn>
+//热数据是按 fd 连续排列的指针数组,事件循环每次查找只需一次数组访问,不需要哈希;
+//HttpConn 按 CHUNK_SIZE 个一组、按缓存行对齐分配,某个 fd 第一次被使用时分配所在的一组,
+//之后一直复用,地址在整个运行期间保持不变,工作线程持有的指针不会因为插入而失效;
+//每个对象的第一条缓存行只有 fd、状态标记等热字段,缓冲区、请求与响应在其后的缓存行中(见 httpconn.h)
+class ConnSlab {
+public:
+    explicit ConnSlab(int maxFd);
+
+    ~ConnSlab() = default;
+
+    HttpConn *Acquire(int fd);
+
+    /**
+     * @brief 查找 fd 对应的连接对象
+     * @param fd
+     * @return fd 超出范围或从未使用过时返回 nullptr
+     */
+    HttpConn *Get(int fd) const {
+        return (fd >= 0 && fd < capacity_) ? index_[fd] : nullptr;
+    }
+
+    /**
+     * @brief 可容纳的最大文件描述符(不含)
+     * @return
+     */
+    int Capacity() const { return capacity_; }
+
+private:
+    //析构一组连接对象并释放按缓存行对齐分配的内存
+    struct ChunkDeleter {
+        void operator()(HttpConn *conns) const;
+    };
+
+    static const int CHUNK_SIZE = 64;   //每次分配的连接对象个数
+
+    int capacity_;                                      //可容纳的最大文件描述符(不含)
+    std::vector<HttpConn *> index_;                     //热数据: fd -> 连接对象
+    std::vector <std::unique_ptr<HttpConn[], ChunkDeleter>> chunks_;    //按组分配的连接对象
+};
+
+#endif //CONN_SLAB_H
@@ -0,0 +1,187 @@
+#include "handoff.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+using namespace std;
+
+/**
+ * @brief 构造函数
+ */
+Handoff::Handoff() : serveFd_(-1), peerFd_(-1) {}
+
+/**
+ * @brief 析构函数,关闭交接用的套接字(不删除 Unix 套接字文件,它可能已经属于新进程)
+ */
+Handoff::~Handoff() {
+    if (serveFd_ >= 0) { close(serveFd_); }
+    if (peerFd_ >= 0) { close(peerFd_); }
+}
+
+/**
+ * @brief 设置读写超时
+ * @param fd
+ */
+void Handoff::SetTimeout_(int fd) {
+    struct timeval tv = {IO_TIMEOUT_SEC, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * @brief 新进程启动时调用: 连接旧进程并接收监听套接字
+ * 成功后保留连接,初始化完成时调用 Ready 通知旧进程
+ * @param path 旧进程等待交接的 Unix 套接字路径
+ * @param cachedFiles 旧进程已缓存的文件,用于预热文件缓存
+ * @return 监听套接字;没有旧进程在等待交接时返回 -1,此时应正常创建监听套接字
+ */
+int Handoff::TakeOver(const string &path, vector <string> &cachedFiles) {
+    struct sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path)) { return -1; }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) { return -1; }
+    SetTimeout_(fd);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    //第一条消息携带监听套接字
+    char tag;
+    struct iovec iov = {&tag, 1};
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    int listenFd = -1;
+    if (recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) == 1) {
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            memcpy(&listenFd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if (listenFd < 0) {
+        close(fd);
+        return -1;
+    }
+    //之后是换行分隔的已缓存文件列表,旧进程写完后关闭写端
+    string list;
+    char buff[4096];
+    ssize_t n;
+    while ((n = read(fd, buff, sizeof(buff))) > 0) {
+        list.append(buff, n);
+    }
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find('\n', pos);
+        if (end == string::npos) { end = list.size(); }
+        if (end > pos) { cachedFiles.push_back(list.substr(pos, end - pos)); }
+        pos = end + 1;
+    }
+    peerFd_ = fd;
+    return listenFd;
+}
+
+/**
+ * @brief 新进程初始化完成后调用,通知旧进程停止 accept
+ */
+void Handoff::Ready() {
+    if (peerFd_ < 0) { return; }
+    char ready = READY;
+    ssize_t ret = write(peerFd_, &ready, 1);
+    (void) ret;
+    close(peerFd_);
+    peerFd_ = -1;
+}
+
+/**
+ * @brief 在 path 上等待下一次升级的新进程连接
+ * 先删除已有的套接字文件: 它要么是上一个进程留下的,要么属于已经完成交接的旧进程
+ * @param path
+ * @return
+ */
+bool Handoff::Serve(const string &path) {
+    struct sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path)) { return false; }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) { return false; }
+    unlink(path.c_str());
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        close(fd);
+        return false;
+    }
+    if (serveFd_ >= 0) { close(serveFd_); }
+    serveFd_ = fd;
+    return true;
+}
+
+/**
+ * @brief 旧进程在 ServeFd 可读时调用: 接受新进程的连接,发送监听套接字与已缓存的文件列表
+ * 同一时间只交接给一个新进程,等待交接的套接字随即关闭
+ * @param listenFd 监听套接字
+ * @param cachedFiles 已缓存的文件
+ * @return 与新进程的连接,之后在它可读时调用 ReadReady;失败时返回 -1
+ */
+int Handoff::Accept(int listenFd, const vector <string> &cachedFiles) {
+    int fd = accept4(serveFd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) { return -1; }
+    close(serveFd_);
+    serveFd_ = -1;
+    SetTimeout_(fd);
+    char tag = 'L';
+    struct iovec iov = {&tag, 1};
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &listenFd, sizeof(int));
+    bool ok = sendmsg(fd, &msg, MSG_NOSIGNAL) == 1;
+    string list;
+    for (const string &file: cachedFiles) {
+        list += file + "\n";
+    }
+    size_t sent = 0;
+    while (ok && sent < list.size()) {
+        ssize_t n = send(fd, list.data() + sent, list.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) { ok = false; }
+        else { sent += n; }
+    }
+    if (!ok) {
+        close(fd);
+        return -1;
+    }
+    shutdown(fd, SHUT_WR);
+    peerFd_ = fd;
+    return fd;
+}
+
+/**
+ * @brief 旧进程在 PeerFd 可读时调用,读取新进程的回复并关闭连接
+ * @return 新进程已就绪时返回 true;新进程在就绪前退出时返回 false,应当继续服务并重新等待交接
+ */
+bool Handoff::ReadReady() {
+    char reply = 0;
+    ssize_t n = read(peerFd_, &reply, 1);
+    close(peerFd_);
+    peerFd_ = -1;
+    return n == 1 && reply == READY;
+}
@@ -0,0 +1,41 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <string>
+#include <vector>
+
+//平滑升级时在新旧进程之间交接监听套接字
+//旧进程在 Unix 套接字 path 上等待新进程连接,通过 SCM_RIGHTS 把监听套接字交给它,并附上已缓存的文件列表;
+//新进程初始化完成后回复一个字节,旧进程随即停止 accept,处理完已有的连接后退出。
+//交接期间两个进程在同一个监听套接字上 accept,内核的等待队列是共享的,不会丢失连接
+class Handoff {
+public:
+    Handoff();
+
+    ~Handoff();
+
+    int TakeOver(const std::string &path, std::vector <std::string> &cachedFiles);
+
+    void Ready();
+
+    bool Serve(const std::string &path);
+
+    int Accept(int listenFd, const std::vector <std::string> &cachedFiles);
+
+    bool ReadReady();
+
+    int ServeFd() const { return serveFd_; }
+
+    int PeerFd() const { return peerFd_; }
+
+private:
+    static const char READY = 'R';      //新进程初始化完成后发送的字节
+    static const int IO_TIMEOUT_SEC = 5;    //交接时读写的超时,对方卡住时不会一直阻塞
+
+    static void SetTimeout_(int fd);
+
+    int serveFd_;   //旧进程: 等待新进程连接的 Unix 套接字
+    int peerFd_;    //旧进程: 已连接的新进程;新进程: 与旧进程的连接
+};
+
+#endif //HANDOFF_H
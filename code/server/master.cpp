@@ -0,0 +1,198 @@
+#include "master.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+#include "webserver.h"
+#include "../metrics/metrics.h"
+
+using namespace std;
+
+const int Master::RESPAWN_DELAY_MS;
+const int Master::STOP_TIMEOUT_MS;
+
+/**
+ * @brief 构造函数
+ * @param config 运行参数
+ * @param args 命令行参数,工作进程收到 SIGHUP 时用它重新读取配置
+ */
+Master::Master(const Config &config, const vector <string> &args) :
+        config_(config), args_(args), listenFd_(-1), respawnAt_(max(config.workers, 0)) {
+    //平滑升级需要单进程;工作进程共用一个 upgradeSocket 会互相冲突
+    config_.upgradeSocket.clear();
+    sigemptyset(&signals_);
+    sigemptyset(&oldMask_);
+}
+
+/**
+ * @brief 析构函数
+ */
+Master::~Master() {
+    if (listenFd_ >= 0) { close(listenFd_); }
+}
+
+/**
+ * @brief 启动工作进程并监管它们,直到收到 SIGTERM 或 SIGINT
+ * master 只有一个线程,信号全部屏蔽后用 sigtimedwait 同步处理,不需要信号处理函数
+ * @return 进程的退出码
+ */
+int Master::Run() {
+    if (config_.workers <= 0) { return 1; }
+    scoreboard_.reset(new Scoreboard(config_.workers));
+    if (!scoreboard_->Valid()) {
+        fprintf(stderr, "master: create scoreboard error: %s\n", strerror(errno));
+        return 1;
+    }
+    //共享监听套接字: 所有工作进程在同一个等待队列上 accept,某个工作进程退出时排队的连接由其余的接收
+    if (!config_.reusePort) {
+        listenFd_ = WebServer::OpenListenSocket(config_);
+        if (listenFd_ < 0) {
+            fprintf(stderr, "master: listen on port %d error: %s\n", config_.port, strerror(errno));
+            return 1;
+        }
+    }
+    sigaddset(&signals_, SIGCHLD);
+    sigaddset(&signals_, SIGTERM);
+    sigaddset(&signals_, SIGINT);
+    sigaddset(&signals_, SIGHUP);
+    sigaddset(&signals_, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &signals_, &oldMask_);
+    for (int i = 0; i < config_.workers; i++) {
+        Spawn_(i);
+    }
+    fprintf(stderr, "master %d: %d workers on port %d, %s listener\n", (int) getpid(), config_.workers,
+            config_.port, config_.reusePort ? "SO_REUSEPORT" : "shared");
+
+    while (true) {
+        struct timespec wait = {0, RESPAWN_DELAY_MS * 1000000L / 4};
+        int sig = sigtimedwait(&signals_, nullptr, &wait);
+        if (sig == SIGTERM || sig == SIGINT) {
+            break;
+        } else if (sig == SIGCHLD) {
+            Reap_();
+        } else if (sig == SIGHUP) {
+            Broadcast_(SIGHUP);     //每个工作进程各自重新加载配置
+        } else if (sig == SIGUSR1) {
+            fputs(scoreboard_->Format().c_str(), stdout);
+            fflush(stdout);
+        }
+        //重新启动已经退出的工作进程
+        auto now = chrono::steady_clock::now();
+        for (int i = 0; i < config_.workers; i++) {
+            if (scoreboard_->Slot(i)->pid == 0 && now >= respawnAt_[i]) {
+                Spawn_(i);
+            }
+        }
+    }
+    Stop_();
+    fputs(scoreboard_->Format().c_str(), stdout);
+    return 0;
+}
+
+/**
+ * @brief 启动第 index 个工作进程
+ * 子进程恢复信号掩码后构造单进程的 WebServer 并运行,退出时不返回 master 的代码
+ * @param index
+ */
+void Master::Spawn_(int index) {
+    WorkerSlot *slot = scoreboard_->Slot(index);
+    pid_t master = getpid();
+    pid_t pid = fork();
+    if (pid == 0) {
+        //master 退出时工作进程也退出,不会留下没有监管的进程
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() != master) { _exit(0); }
+        sigprocmask(SIG_SETMASK, &oldMask_, nullptr);
+        {
+            WebServer server(config_, listenFd_, slot);
+            //监控指标由处理请求的工作进程返回,附上所有工作进程的统计
+            Scoreboard *scoreboard = scoreboard_.get();
+            Metrics::Instance()->AddCollector([scoreboard](string &out) { scoreboard->Collect(out); });
+            vector <string> args = args_;
+            server.SetReloader([args](Config &fresh, string &err) {
+                if (!fresh.ParseArgs(args, err)) { return false; }
+                fresh.upgradeSocket.clear();
+                return true;
+            });
+            server.Start();
+        }
+        exit(0);
+    }
+    if (pid < 0) {
+        fprintf(stderr, "master: fork worker %d error: %s\n", index, strerror(errno));
+        respawnAt_[index] = chrono::steady_clock::now() + chrono::milliseconds(RESPAWN_DELAY_MS);
+        return;
+    }
+    slot->startTime = time(nullptr);
+    slot->pid = pid;
+}
+
+/**
+ * @brief 回收退出的工作进程,记录退出原因并安排重新启动
+ * 启动后 1 秒内就退出的工作进程(例如初始化失败)延迟 RESPAWN_DELAY_MS 再重新启动,避免不停地 fork
+ */
+void Master::Reap_() {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (int i = 0; i < config_.workers; i++) {
+            WorkerSlot *slot = scoreboard_->Slot(i);
+            if (slot->pid != pid) { continue; }
+            if (WIFSIGNALED(status)) {
+                fprintf(stderr, "master: worker %d (pid %d) killed by signal %d, restarting\n",
+                        i, (int) pid, WTERMSIG(status));
+            } else {
+                fprintf(stderr, "master: worker %d (pid %d) exited with %d, restarting\n",
+                        i, (int) pid, WEXITSTATUS(status));
+            }
+            bool quick = time(nullptr) - slot->startTime <= 1;
+            respawnAt_[i] = chrono::steady_clock::now() +
+                            chrono::milliseconds(quick ? RESPAWN_DELAY_MS : 0);
+            slot->lastExit = status;
+            slot->conns = 0;
+            slot->restarts++;
+            slot->pid = 0;
+            break;
+        }
+    }
+}
+
+/**
+ * @brief 向所有工作进程发送信号
+ * @param sig
+ */
+void Master::Broadcast_(int sig) {
+    for (int i = 0; i < config_.workers; i++) {
+        pid_t pid = scoreboard_->Slot(i)->pid;
+        if (pid > 0) { kill(pid, sig); }
+    }
+}
+
+/**
+ * @brief 让所有工作进程退出并等待它们结束,超过 STOP_TIMEOUT_MS 后强制结束
+ */
+void Master::Stop_() {
+    Broadcast_(SIGTERM);
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(STOP_TIMEOUT_MS);
+    while (true) {
+        pid_t pid;
+        while ((pid = waitpid(-1, nullptr, WNOHANG)) > 0) {
+            for (int i = 0; i < config_.workers; i++) {
+                if (scoreboard_->Slot(i)->pid == pid) { scoreboard_->Slot(i)->pid = 0; }
+            }
+        }
+        if (pid < 0 && errno == ECHILD) { break; }
+        if (chrono::steady_clock::now() >= deadline) {
+            fprintf(stderr, "master: workers did not exit in time, killing\n");
+            Broadcast_(SIGKILL);
+            deadline = chrono::steady_clock::now() + chrono::milliseconds(STOP_TIMEOUT_MS);
+        }
+        struct timespec wait = {0, 100 * 1000000L};
+        sigtimedwait(&signals_, nullptr, &wait);
+    }
+}
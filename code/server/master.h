@@ -0,0 +1,46 @@
+#ifndef MASTER_H
+#define MASTER_H
+
+#include <signal.h>
+#include <sys/types.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "scoreboard.h"
+#include "../config/config.h"
+
+//prefork 模式的 master 进程
+//master 创建监听套接字与共享统计表后 fork 出 workers 个工作进程,每个工作进程运行一个单进程的 WebServer;
+//master 自己不处理连接,只负责监管: 工作进程崩溃后重新启动,转发 SIGHUP/SIGTERM,收到 SIGUSR1 时输出统计表
+class Master {
+public:
+    Master(const Config &config, const std::vector <std::string> &args);
+
+    ~Master();
+
+    int Run();
+
+private:
+    void Spawn_(int index);
+
+    void Reap_();
+
+    void Broadcast_(int sig);
+
+    void Stop_();
+
+    static const int RESPAWN_DELAY_MS = 1000;   //工作进程启动后 1 秒内就退出时,再次启动前等待的时间
+    static const int STOP_TIMEOUT_MS = 10000;   //退出时等待工作进程结束的时间,超时后发送 SIGKILL
+
+    Config config_;                         //运行参数,传给每个工作进程
+    std::vector <std::string> args_;        //命令行参数,工作进程重新加载配置时使用
+    int listenFd_;                          //共享的监听套接字,reusePort 时为 -1
+    std::unique_ptr <Scoreboard> scoreboard_;   //共享统计表
+    std::vector <std::chrono::steady_clock::time_point> respawnAt_;    //每个工作进程最早可以重新启动的时间
+    sigset_t signals_;                      //master 同步等待的信号
+    sigset_t oldMask_;                      //原来的信号掩码,工作进程中恢复
+};
+
+#endif //MASTER_H
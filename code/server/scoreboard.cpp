@@ -0,0 +1,133 @@
+#include "scoreboard.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <new>
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+/**
+ * @brief 构造函数,用匿名共享映射创建统计表,之后 fork 出的进程共享同一块内存
+ * std::atomic 的无锁操作不依赖地址,可以在进程之间使用
+ * @param workers 工作进程数
+ */
+Scoreboard::Scoreboard(int workers) : size_(workers), slots_(nullptr) {
+    void *mem = mmap(nullptr, sizeof(WorkerSlot) * workers, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) { return; }
+    slots_ = static_cast<WorkerSlot *>(mem);
+    for (int i = 0; i < workers; i++) {
+        WorkerSlot *slot = new(&slots_[i]) WorkerSlot();
+        slot->index = i;
+        slot->pid = 0;
+        slot->startTime = 0;
+        slot->restarts = 0;
+        slot->lastExit = 0;
+        slot->conns = 0;
+        slot->accepted = 0;
+        slot->requests = 0;
+        slot->shed = 0;
+        slot->cacheHits = 0;
+        slot->cacheMisses = 0;
+    }
+}
+
+/**
+ * @brief 析构函数,解除映射;工作进程继承的映射在各自退出时解除
+ */
+Scoreboard::~Scoreboard() {
+    if (slots_) {
+        munmap(slots_, sizeof(WorkerSlot) * size_);
+    }
+}
+
+/**
+ * @brief 把工作进程的计数发布到它的槽中
+ * 只累加与上次发布之间的增量,工作进程重新启动后槽中的计数继续增长,不会回到 0
+ * @param slot
+ * @param conns 当前的连接数
+ * @param current 当前的累计计数
+ * @param published 上次发布时的累计计数,发布后更新
+ */
+void Scoreboard::Publish(WorkerSlot *slot, int conns, const WorkerStats &current, WorkerStats &published) {
+    slot->conns.store(conns, memory_order_relaxed);
+    slot->accepted.fetch_add(current.accepted - published.accepted, memory_order_relaxed);
+    slot->requests.fetch_add(current.requests - published.requests, memory_order_relaxed);
+    slot->shed.fetch_add(current.shed - published.shed, memory_order_relaxed);
+    slot->cacheHits.fetch_add(current.cacheHits - published.cacheHits, memory_order_relaxed);
+    slot->cacheMisses.fetch_add(current.cacheMisses - published.cacheMisses, memory_order_relaxed);
+    published = current;
+}
+
+/**
+ * @brief 输出每个工作进程的统计和汇总
+ * @return
+ */
+string Scoreboard::Format() const {
+    string out;
+    char line[256];
+    snprintf(line, sizeof(line), "%-6s %-8s %8s %8s %8s %12s %12s %8s %8s\n",
+             "worker", "pid", "uptime", "restarts", "conns", "accepted", "requests", "shed", "hit%");
+    out += line;
+    int64_t now = time(nullptr);
+    long long conns = 0;
+    unsigned long long accepted = 0, requests = 0, shed = 0, hits = 0, misses = 0, restarts = 0;
+    for (int i = 0; i < size_; i++) {
+        const WorkerSlot &slot = slots_[i];
+        pid_t pid = slot.pid;
+        uint64_t h = slot.cacheHits, m = slot.cacheMisses;
+        snprintf(line, sizeof(line), "%-6d %-8d %8lld %8llu %8d %12llu %12llu %8llu %7.1f%%\n",
+                 i, (int) pid, pid > 0 ? (long long) (now - slot.startTime) : 0LL,
+                 (unsigned long long) slot.restarts, slot.conns.load(),
+                 (unsigned long long) slot.accepted, (unsigned long long) slot.requests,
+                 (unsigned long long) slot.shed, h + m > 0 ? 100.0 * h / (h + m) : 0.0);
+        out += line;
+        conns += slot.conns;
+        accepted += slot.accepted;
+        requests += slot.requests;
+        shed += slot.shed;
+        hits += h;
+        misses += m;
+        restarts += slot.restarts;
+    }
+    snprintf(line, sizeof(line), "%-6s %-8s %8s %8llu %8lld %12llu %12llu %8llu %7.1f%%\n",
+             "total", "-", "-", restarts, conns, accepted, requests, shed,
+             hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0);
+    out += line;
+    return out;
+}
+
+/**
+ * @brief 以 Prometheus 文本格式输出每个工作进程的计数,标签 worker 为工作进程的编号
+ * @param out
+ */
+void Scoreboard::Collect(string &out) const {
+    struct Field {
+        const char *name;
+        const char *type;
+        const char *help;
+        function<unsigned long long(const WorkerSlot &)> read;
+    };
+    const Field fields[] = {
+            {"webserver_worker_connections", "gauge", "Open connections of each worker.",
+                    [](const WorkerSlot &s) { return (unsigned long long) max(s.conns.load(), 0); }},
+            {"webserver_worker_accepted_total", "counter", "Connections accepted by each worker.",
+                    [](const WorkerSlot &s) { return (unsigned long long) s.accepted; }},
+            {"webserver_worker_requests_total", "counter", "Requests handled by each worker.",
+                    [](const WorkerSlot &s) { return (unsigned long long) s.requests; }},
+            {"webserver_worker_restarts_total", "counter", "Restarts of each worker.",
+                    [](const WorkerSlot &s) { return (unsigned long long) s.restarts; }},
+    };
+    char line[128];
+    for (const Field &field: fields) {
+        out += string("# HELP ") + field.name + " " + field.help + "\n";
+        out += string("# TYPE ") + field.name + " " + field.type + "\n";
+        for (int i = 0; i < size_; i++) {
+            snprintf(line, sizeof(line), "%s{worker=\"%d\"} %llu\n", field.name, i, field.read(slots_[i]));
+            out += line;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef SCOREBOARD_H
+#define SCOREBOARD_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+#include <string>
+
+//prefork 模式下一个工作进程的统计,位于 master 创建的共享内存中
+//由工作进程的事件循环线程写入,master 随时读取;每个槽独占缓存行,工作进程之间不会互相干扰
+struct alignas(64) WorkerSlot {
+    int index;                              //工作进程的编号,创建后不变
+    std::atomic <pid_t> pid;                //当前的工作进程,0 表示没有运行
+    std::atomic <int64_t> startTime;        //当前工作进程的启动时间
+    std::atomic <uint64_t> restarts;        //重新启动的次数,由 master 写入
+    std::atomic <int> lastExit;             //上一个工作进程的退出状态(waitpid 的 status)
+    std::atomic <int> conns;                //当前的连接数
+    std::atomic <uint64_t> accepted;        //accept 到的连接数
+    std::atomic <uint64_t> requests;        //处理的请求数
+    std::atomic <uint64_t> shed;            //过载时拒绝的连接数
+    std::atomic <uint64_t> cacheHits;       //文件缓存命中次数
+    std::atomic <uint64_t> cacheMisses;     //文件缓存未命中次数
+};
+
+//工作进程自己的累计计数,发布到 WorkerSlot 时只加上与上次发布之间的增量
+struct WorkerStats {
+    uint64_t accepted = 0;
+    uint64_t requests = 0;
+    uint64_t shed = 0;
+    uint64_t cacheHits = 0;
+    uint64_t cacheMisses = 0;
+};
+
+//master 与工作进程共享的统计表,在 fork 之前创建,所有工作进程继承同一块共享内存
+//计数只在各自的槽中累加,汇总时才求和,不需要跨进程的锁
+class Scoreboard {
+public:
+    explicit Scoreboard(int workers);
+
+    ~Scoreboard();
+
+    Scoreboard(const Scoreboard &) = delete;
+
+    Scoreboard &operator=(const Scoreboard &) = delete;
+
+    bool Valid() const { return slots_ != nullptr; }
+
+    int Size() const { return size_; }
+
+    WorkerSlot *Slot(int index) { return &slots_[index]; }
+
+    std::string Format() const;
+
+    void Collect(std::string &out) const;
+
+    static void Publish(WorkerSlot *slot, int conns, const WorkerStats &current, WorkerStats &published);
+
+private:
+    int size_;              //工作进程数
+    WorkerSlot *slots_;     //共享内存中的槽
+};
+
+#endif //SCOREBOARD_H
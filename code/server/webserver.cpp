@@ -1,55 +1,149 @@
 #include "webserver.h"
+#include "../metrics/probes.h"
+
+#include <sys/syscall.h>
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69  //较旧的头文件中没有定义,值与内核一致
+#endif
 
 using namespace std;
 
+atomic<int> WebServer::notifyTarget_(-1);
+atomic<unsigned> WebServer::pending_(0);
+
 /**
  * @brief 构造函数,初始化服务器
  *
- * @param port 服务器监听端口号
- * @param trigMode 触发模式
- * @param timeoutMS 连接超时时间
- * @param OptLinger 是否使用linger选项
- * @param sqlPort 数据库端口号
- * @param sqlUser 数据库用户名
- * @param sqlPwd 数据库密码
- * @param dbName 数据库名称
- * @param connPoolNum 连接池大小
- * @param threadNum 线程池大小
- * @param openLog 是否打开日志系统
- * @param logLevel 日志等级
- * @param logQueSize 日志缓存长度
- */
-WebServer::WebServer(
-        int port, int trigMode, int timeoutMS, bool OptLinger,
-        int sqlPort, const char *sqlUser, const char *sqlPwd,
-        const char *dbName, int connPoolNum, int threadNum,
-        bool openLog, int logLevel, int logQueSize) :
-        port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-        timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller()) {
+ * @param config 运行参数,threadNum 与 connPoolNum 为 0 时按可用 CPU 数自动设置
+ * @param listenFd 已经在监听的套接字(prefork 模式下由 master 创建),-1 表示自己创建
+ * @param slot prefork 模式下本工作进程在共享统计表中的槽,日志文件也按工作进程分开
+ */
+WebServer::WebServer(const Config &config, int listenFd, WorkerSlot *slot) :
+        config_(config.Resolved()), port_(config_.port), openLinger_(config_.optLinger),
+        timeoutMS_(config_.timeoutMs), isClose_(false), listenFd_(listenFd), timer_(new HeapTimer()),
+        threadpool_(new ThreadPool(config_.threadNum, Affinity::Resolve(config_.workerCpus.c_str(), false,
+                                                                        slot ? slot->index : 0,
+                                                                        slot ? config_.workers : 1))),
+        epoller_(new Epoller()),
+        acceptCount_(0), acceptFull_(0), overflowBase_(ListenOverflows_()), startTime_(time(nullptr)),
+        evictCount_(0), busyPolls_(0), busyHits_(0), busyBlocks_(0), spinUs_(0), tuneWarned_(false),
+        inlineCount_(0), offloadCount_(0), notifyFd_(-1), reloadCount_(0),
+        inherited_(false), upgradePid_(-1), draining_(false), idleDrained_(false),
+        timerSize_(0), slot_(slot), users_(MAX_FD) {
+    //事件循环运行在构造服务器的线程中,先绑定 CPU,之后分配的连接对象与缓冲区都在本地 NUMA 节点上;
+    //prefork 模式下各工作进程分到不同的 CPU
+    int cpuIndex = slot ? slot->index : 0;
+    int cpuCount = slot ? config_.workers : 1;
+    vector<int> loopCpus = Affinity::Resolve(config_.loopCpus.c_str(), true, cpuIndex, cpuCount);
+    vector<int> workerCpus = Affinity::Resolve(config_.workerCpus.c_str(), false, cpuIndex, cpuCount);
+    bool loopPinned = Affinity::PinCurrentThread(loopCpus);
     chdir("..");    //切换到上一级目录
     //srcDir_保存资源文件的路径,使用getcwd()函数获取当前工作目录
     srcDir_ = getcwd(nullptr, 256);
     assert(srcDir_);
     strncat(srcDir_, "/staticResources/", 16);
     HttpConn::userCount = 0;
+    HttpConn::draining = false;
+    HttpConn::slowRequestMs = config_.slowRequestMs;
     HttpConn::srcDir = srcDir_;
-    SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
+    SqlConnPool::Instance()->Init(config_.sqlHost.c_str(), config_.sqlPort, config_.sqlUser.c_str(),
+                                  config_.sqlPwd.c_str(), config_.dbName.c_str(), config_.connPoolNum);
+    FileCache::Instance()->Init(config_.fileCacheBytes, config_.fileCacheMaxFile);
+    int maxConns = MAX_FD;
+    if (config_.maxConnections > 0 && config_.maxConnections < maxConns) {
+        maxConns = config_.maxConnections;
+    }
+    admission_.Init(maxConns, config_.shedQueueDepth, config_.shedP99Ms, config_.retryAfterSec);
 
-    InitEventMode_(trigMode);               //初始化触发模式
+    InitEventMode_(config_.trigMode);               //初始化触发模式
     if (!InitSocket_()) { isClose_ = true; }//初始化套接字连接
+    if (!isClose_ && !InitNotify_()) { isClose_ = true; }
 
-    if (openLog) {
-        Log::Instance()->init(logLevel, "./log", ".log", logQueSize);
+    if (config_.openLog) {
+        //日志只保存后缀的指针;多个工作进程各写各的文件,滚动与清理互不干扰
+        static string logSuffix;
+        logSuffix = slot_ ? ".w" + to_string(slot_->index) : "";
+        logSuffix += config_.logBinary ? ".blog" : ".log";
+        Log::Instance()->init(config_.logLevel, "./log", logSuffix.c_str(), config_.logQueSize,
+                              config_.logBinary, config_.logFileMaxBytes, config_.logOverflow,
+                              config_.logRetention, config_.logCompress);
         if (isClose_) { LOG_ERROR("========== Server init error!=========="); }
         else {
             LOG_INFO("========== Server init ==========");
-            LOG_INFO("Port:%d, OpenLinger: %s", port_, OptLinger ? "true" : "false");
+            LOG_INFO("Port:%d, OpenLinger: %s", port_, openLinger_ ? "true" : "false");
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s",
                      (listenEvent_ & EPOLLET ? "ET" : "LT"),
                      (connEvent_ & EPOLLET ? "ET" : "LT"));
-            LOG_INFO("LogSys level: %d", logLevel);
+            LOG_INFO("LogSys level: %d, format: %s", config_.logLevel, config_.logBinary ? "binary" : "text");
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d, available CPUs: %d",
+                     config_.connPoolNum, config_.threadNum, Affinity::AvailableCpus());
+            LOG_INFO("CPU topology: %s", Affinity::Describe().c_str());
+            LOG_INFO("Loop CPUs: %s, worker CPUs: %s",
+                     loopPinned ? Affinity::FormatCpuList(loopCpus).c_str() : "unpinned",
+                     workerCpus.empty() ? "unpinned" : Affinity::FormatCpuList(workerCpus).c_str());
+            LOG_INFO("Listen backlog: %d, accept batch: %d, defer accept: %ds, socket: %s",
+                     config_.listenBacklog, config_.acceptBatch, config_.deferAcceptSec,
+                     inherited_ ? "inherited" : "new");
+            LOG_INFO("Admission max conns: %d, queue: %d, p99: %dms",
+                     maxConns, config_.shedQueueDepth, config_.shedP99Ms);
+            if (config_.busyPollUs > 0 || config_.sockBusyPollUs > 0) {
+                LOG_INFO("Busy poll: spin %dus, SO_BUSY_POLL %dus, prefer %s", config_.busyPollUs,
+                         config_.sockBusyPollUs, config_.preferBusyPoll ? "on" : "off");
+            }
+            LOG_INFO("TCP nodelay: %s, sndbuf: %d, rcvbuf: %d, notsent lowat: %d, keepalive: %ds/%ds/%d",
+                     config_.tcpNoDelay ? "on" : "off", config_.sndBufBytes, config_.rcvBufBytes,
+                     config_.notSentLowat, config_.keepAliveIdleSec, config_.keepAliveIntvlSec,
+                     config_.keepAliveCnt);
+            LOG_INFO("Inline dispatch: %s, FileCache: %zu bytes",
+                     config_.inlineDispatch ? "on" : "off", config_.fileCacheBytes);
+        }
+    }
+    string err;
+    if (!SiteTables::Load(config_.mimeTypesFile, config_.htmlPages, err)) {
+        LOG_ERROR("Load site tables error: %s", err.c_str());
+        isClose_ = true;
+    }
+    //路由表在启动时建立,之后只读:登录与注册表单、监控指标,其余请求读取静态文件
+    shared_ptr<Router> router = make_shared<Router>();
+    bool routed = AddDefaultRoutes(*router, err);
+    if (routed && !config_.metricsPath.empty()) {
+        routed = router->Add("GET", config_.metricsPath, make_shared<MetricsHandler>(), err);
+    }
+    if (!routed) {
+        LOG_ERROR("Init router error: %s", err.c_str());
+        isClose_ = true;
+    } else {
+        Router::Install(router);
+        LOG_INFO("Router: %zu routes, metrics: %s", router->Size(),
+                 config_.metricsPath.empty() ? "off" : config_.metricsPath.c_str());
+    }
+    if (config_.accessLog && !isClose_) {
+        string accessLogPath = config_.accessLogPath + (slot_ ? ".w" + to_string(slot_->index) : "");
+        AccessLog::Instance()->Init(accessLogPath.c_str(), config_.accessLogSampleRate, config_.accessLogFlushMs);
+        LOG_INFO("AccessLog: %s, sample 1/%d", accessLogPath.c_str(), config_.accessLogSampleRate);
+    }
+    if (!config_.captureFile.empty() && !isClose_) {
+        StartCapture_(config_);
+    }
+    if (!isClose_) {
+        InitMetrics_();
+    }
+    if (!config_.upgradeSocket.empty() && !isClose_) {
+        if (inherited_) {
+            //先预热文件缓存再通知旧进程,接手流量时缓存已经和旧进程相同
+            size_t warmed = FileCache::Instance()->Warm(inheritedFiles_);
+            LOG_INFO("Upgrade: took over listen socket, warmed %zu / %zu cached files",
+                     warmed, inheritedFiles_.size());
+            inheritedFiles_.clear();
+            handoff_.Ready();
+        }
+        //等待下一次升级;初始化失败时不会走到这里,旧进程收不到就绪通知,继续服务
+        if (handoff_.Serve(config_.upgradeSocket) && epoller_->AddFd(handoff_.ServeFd(), EPOLLIN)) {
+            LOG_INFO("Upgrade socket: %s", config_.upgradeSocket.c_str());
+        } else {
+            LOG_WARN("Upgrade socket %s error: %s", config_.upgradeSocket.c_str(), strerror(errno));
         }
     }
 }
@@ -59,9 +153,55 @@ WebServer::WebServer(
  *
  */
 WebServer::~WebServer() {
+    //先等待工作线程执行完已经提交的任务,任务引用了本对象、连接与资源路径
+    threadpool_->Close();
+    Metrics::Instance()->ClearCallbacks();  //回调引用了本对象
+    if (notifyFd_ >= 0) {
+        signal(SIGHUP, SIG_DFL);
+        signal(SIGUSR2, SIG_DFL);
+        notifyTarget_ = -1;
+        close(notifyFd_);
+    }
     close(listenFd_);       //关闭服务器监听文件描述符
     isClose_ = true;        //标记服务器已经关闭
     free(srcDir_);    //释放资源文件路径
+    time_t upTime = max<time_t>(time(nullptr) - startTime_, 1);
+    LOG_INFO("Accepted: %llu (%.1f/s), accept batch full: %llu, listen overflows: %llu",
+             (unsigned long long) acceptCount_, (double) acceptCount_ / upTime,
+             (unsigned long long) acceptFull_, (unsigned long long) (ListenOverflows_() - overflowBase_));
+    LOG_INFO("Shed conns: %llu, queue: %llu, latency: %llu, idle evicted: %llu",
+             (unsigned long long) admission_.Shed(Admission::SHED_CONNS),
+             (unsigned long long) admission_.Shed(Admission::SHED_QUEUE),
+             (unsigned long long) admission_.Shed(Admission::SHED_LATENCY),
+             (unsigned long long) evictCount_);
+    if (config_.busyPollUs > 0) {
+        //轮询占用的 CPU 时间比例与命中率,用来权衡延迟收益和 CPU 开销
+        LOG_INFO("Busy poll: spin %.1f%% of uptime, hits %llu / %llu polls, blocked %llu, last p99 %uus",
+                 spinUs_ / (upTime * 1e4), (unsigned long long) busyHits_, (unsigned long long) busyPolls_,
+                 (unsigned long long) busyBlocks_, admission_.P99Us());
+    }
+    LOG_INFO("Dispatch inline: %llu, offload: %llu, FileCache hit: %llu, miss: %llu",
+             (unsigned long long) inlineCount_, (unsigned long long) offloadCount_,
+             (unsigned long long) FileCache::Instance()->Hits(),
+             (unsigned long long) FileCache::Instance()->Misses());
+    //各阶段耗时的分位数
+    string stages;
+    for (int stage = 0; stage < Metrics::STAGE_COUNT; stage++) {
+        const Histogram &histogram = Metrics::StageHistogram(static_cast<Metrics::Stage>(stage));
+        vector <uint64_t> us = histogram.Percentiles({0.5, 0.99, 0.999});
+        char item[96];
+        snprintf(item, sizeof(item), "%s%s %llu/%llu/%llu", stages.empty() ? "" : ", ",
+                 Metrics::StageName(static_cast<Metrics::Stage>(stage)), (unsigned long long) us[0] / 1000,
+                 (unsigned long long) us[1] / 1000, (unsigned long long) us[2] / 1000);
+        stages += item;
+    }
+    LOG_INFO("Stage p50/p99/p999 us: %s", stages.c_str());
+    AccessLog::Instance()->Close();         //写出剩余的访问记录
+    if (TrafficCapture::Instance()->IsOpen()) {
+        TrafficCapture::Instance()->Close();    //写出剩余的录制数据
+        LOG_INFO("Capture closed, dropped records: %llu",
+                 (unsigned long long) TrafficCapture::Instance()->Dropped());
+    }
     SqlConnPool::Instance()->ClosePool();   //关闭数据库连接池
 }
 
@@ -94,6 +234,294 @@ void WebServer::InitEventMode_(int trigMode) {
     HttpConn::isET = (connEvent_ & EPOLLET);    //检测以EPOLLET的形式使能的连接事件
 }
 
+/**
+ * @brief 设置重新加载时读取配置的方法,一般是用启动时的命令行参数重新解析配置文件
+ * 没有设置时重新加载只会清空文件缓存并重建 MIME 类型表与页面路径表
+ * @param reloader 把配置读入第一个参数,失败时返回 false 并在第二个参数中给出原因
+ */
+void WebServer::SetReloader(std::function<bool(Config &, std::string &)> reloader) {
+    reloader_ = std::move(reloader);
+}
+
+/**
+ * @brief 设置平滑升级时启动新进程的命令,一般是启动时的工作目录与命令行
+ * 没有设置时收到 SIGUSR2 不会启动新进程,但仍可以手动启动新进程接手
+ * @param cwd 新进程的工作目录
+ * @param argv 新进程的命令行,argv[0] 是可执行文件,替换了磁盘上的文件后启动的就是新版本
+ */
+void WebServer::SetUpgradeCommand(const std::string &cwd, const std::vector <std::string> &argv) {
+    upgradeCwd_ = cwd;
+    upgradeArgv_ = argv;
+}
+
+/**
+ * @brief 通知事件循环处理请求,只写 eventfd,可以在信号处理函数中调用
+ * @param what NOTIFY_*
+ */
+void WebServer::Notify_(unsigned what) {
+    pending_.fetch_or(what);
+    int fd = notifyTarget_.load();
+    if (fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = write(fd, &one, sizeof(one));
+        (void) ret;
+    }
+}
+
+/**
+ * @brief 请求事件循环重新加载配置,可以在任意线程或信号处理函数中调用
+ * 实际的加载在事件循环线程中进行
+ */
+void WebServer::RequestReload() {
+    Notify_(NOTIFY_RELOAD);
+}
+
+/**
+ * @brief 请求事件循环启动新进程并交出监听套接字,可以在任意线程或信号处理函数中调用
+ */
+void WebServer::RequestUpgrade() {
+    Notify_(NOTIFY_UPGRADE);
+}
+
+/**
+ * @brief 请求事件循环停止 accept,处理完已有的连接后退出,可以在任意线程或信号处理函数中调用
+ * 退出时析构服务器,日志、访问日志和流量录制的缓冲区都会写入文件
+ */
+void WebServer::RequestStop() {
+    Notify_(NOTIFY_STOP);
+}
+
+/**
+ * @brief 创建通知用的 eventfd 并注册到 epoll,收到 SIGHUP(重新加载)、SIGUSR2(平滑升级)或 SIGTERM(退出)时写入它
+ * @return
+ */
+bool WebServer::InitNotify_() {
+    notifyFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notifyFd_ < 0 || epoller_->AddFd(notifyFd_, EPOLLIN) == 0) {
+        LOG_ERROR("Init notify eventfd error!");
+        return false;
+    }
+    notifyTarget_ = notifyFd_;
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = [](int) { RequestReload(); };
+    act.sa_flags = SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGHUP, &act, nullptr);
+    act.sa_handler = [](int) { RequestUpgrade(); };
+    sigaction(SIGUSR2, &act, nullptr);
+    act.sa_handler = [](int) { RequestStop(); };
+    sigaction(SIGTERM, &act, nullptr);
+    return true;
+}
+
+/**
+ * @brief 在事件循环线程中处理信号处理函数发来的请求
+ */
+void WebServer::DealNotify_() {
+    uint64_t count;
+    while (read(notifyFd_, &count, sizeof(count)) > 0) {}
+    unsigned what = pending_.exchange(0);
+    if (what & NOTIFY_RELOAD) { Reload_(); }
+    if (what & NOTIFY_UPGRADE) { Upgrade_(); }
+    if ((what & NOTIFY_STOP) && !draining_) {
+        LOG_INFO("Stop: received SIGTERM");
+        StartDrain_(config_.drainTimeoutMs < STOP_DRAIN_MS ? config_.drainTimeoutMs : STOP_DRAIN_MS);
+    }
+}
+
+/**
+ * @brief 启动新进程接手监听套接字
+ * 新进程用同样的命令行启动,通过 upgradeSocket 连接本进程取得监听套接字,
+ * 初始化完成后通知本进程,本进程随即停止 accept 并开始排空,见 DealHandoff_
+ */
+void WebServer::Upgrade_() {
+    if (config_.upgradeSocket.empty() || upgradeArgv_.empty()) {
+        LOG_WARN("Upgrade: upgradeSocket or upgrade command not set, ignored");
+        return;
+    }
+    if (draining_ || handoff_.ServeFd() < 0) {
+        LOG_WARN("Upgrade: already in progress, ignored");
+        return;
+    }
+    while (waitpid(-1, nullptr, WNOHANG) > 0) {}    //回收之前启动失败的新进程
+    //fork 之后子进程中只能调用异步信号安全的函数,参数提前准备好
+    vector<char *> argv;
+    for (string &arg: upgradeArgv_) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+    const char *cwd = upgradeCwd_.c_str();
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (*cwd && chdir(cwd) < 0) { _exit(127); }
+        //不让新进程继承 epoll、日志文件、数据库连接等描述符
+#ifdef SYS_close_range
+        if (syscall(SYS_close_range, 3, ~0U, 0) < 0)
+#endif
+        {
+            for (int fd = 3; fd < MAX_FD; fd++) { close(fd); }
+        }
+        if (strchr(argv[0], '/')) { execv(argv[0], argv.data()); }
+        else { execvp(argv[0], argv.data()); }
+        _exit(127);
+    }
+    if (pid < 0) {
+        LOG_ERROR("Upgrade: fork error: %s", strerror(errno));
+        return;
+    }
+    upgradePid_ = pid;
+    LOG_INFO("Upgrade: started new process %d", (int) pid);
+}
+
+/**
+ * @brief 处理交接用的 Unix 套接字上的事件
+ * 新进程连接后把监听套接字和已缓存的文件列表交给它;新进程回复就绪后开始排空,
+ * 新进程在就绪前退出时继续服务并重新等待交接
+ * @param fd ServeFd 或 PeerFd
+ */
+void WebServer::DealHandoff_(int fd) {
+    epoller_->DelFd(fd);
+    if (fd == handoff_.ServeFd()) {
+        int peer = handoff_.Accept(listenFd_, FileCache::Instance()->Paths());
+        if (peer >= 0 && epoller_->AddFd(peer, EPOLLIN)) {
+            LOG_INFO("Upgrade: new process connected, listen socket sent");
+            return;
+        }
+        LOG_WARN("Upgrade: hand over listen socket error: %s", strerror(errno));
+    } else if (handoff_.ReadReady()) {
+        LOG_INFO("Upgrade: new process ready");
+        StartDrain_(config_.drainTimeoutMs);
+        return;
+    } else {
+        LOG_WARN("Upgrade: new process exited before ready, keep serving");
+        if (upgradePid_ > 0 && waitpid(upgradePid_, nullptr, WNOHANG) == upgradePid_) { upgradePid_ = -1; }
+    }
+    if (handoff_.Serve(config_.upgradeSocket)) {
+        epoller_->AddFd(handoff_.ServeFd(), EPOLLIN);
+    }
+}
+
+/**
+ * @brief 停止 accept,处理完已有的连接后退出;平滑升级时新进程已经在同一个监听套接字上 accept
+ * 等待队列属于监听套接字,由两个进程共享,关闭本进程的描述符不会丢失排队的连接;
+ * 之后的响应都带 Connection: close,客户端发送下一个请求时会连接到新进程
+ * @param timeoutMs 最长等待时间,超时后关闭剩余的连接
+ */
+void WebServer::StartDrain_(int timeoutMs) {
+    draining_ = true;
+    HttpConn::draining = true;
+    drainDeadline_ = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    epoller_->DelFd(listenFd_);
+    close(listenFd_);
+    listenFd_ = -1;
+    LOG_INFO("Drain: stop accepting, draining %d conns", (int) HttpConn::userCount);
+}
+
+/**
+ * @brief 处理排空开始时的空闲长连接,在处理完一批事件之后调用,这一批中可能还有这些连接的事件
+ * 直接关闭空闲连接时,恰好在发送请求的客户端会收到连接重置,只能重试;
+ * 因此开启超时时只把空闲连接的超时缩短到 DRAIN_IDLE_MS,期间发来的请求照常处理(响应带 Connection: close),
+ * 一直没有请求的才由定时器关闭
+ */
+void WebServer::DrainIdle_() {
+    int idle = 0;
+    int idleMs = DRAIN_IDLE_MS;
+    for (int fd = 0; fd < users_.Capacity(); fd++) {
+        HttpConn *client = users_.Get(fd);
+        if (client == nullptr || client->IsClosed() || !client->IsIdle()) { continue; }
+        if (timeoutMS_ > 0) {
+            timer_->adjust(fd, min(timeoutMS_, idleMs));
+        } else {
+            CloseConn_(client);
+        }
+        idle++;
+    }
+    LOG_INFO("Drain: %d idle conns %s", idle, timeoutMS_ > 0 ? "will close if no request" : "closed");
+}
+
+/**
+ * @brief 在事件循环线程中重新加载配置
+ * 运行参数只在事件循环线程中读取,直接替换即可;工作线程使用的 MIME 类型表、页面路径表与文件缓存
+ * 通过快照和代数整体替换,正在处理的请求继续使用旧的表和已经取到的文件内容。
+ * 新的参数对之后 accept 的连接和之后的请求生效;端口、线程数、数据库、日志文件等需要重启才能修改的参数保持原值
+ */
+void WebServer::Reload_() {
+    //可以在运行时修改的参数
+    static const unordered_set <string> RELOADABLE = {
+            "timeoutMs", "logLevel", "listenBacklog", "acceptBatch", "deferAcceptSec",
+            "tcpNoDelay", "sndBufBytes", "rcvBufBytes", "notSentLowat",
+            "keepAliveIdleSec", "keepAliveIntvlSec", "keepAliveCnt",
+            "maxConnections", "shedQueueDepth", "shedP99Ms", "retryAfterSec", "evictBatch",
+            "busyPollUs", "sockBusyPollUs", "preferBusyPoll",
+            "inlineDispatch", "fileCacheBytes", "fileCacheMaxFile", "htmlPages", "mimeTypesFile",
+            "slowRequestMs", "captureFile", "captureMaxBytes", "drainTimeoutMs",
+    };
+    Config fresh = config_;
+    string err;
+    if (reloader_) {
+        fresh = Config();
+        if (!reloader_(fresh, err)) {
+            LOG_ERROR("Reload config error: %s, keep the current config", err.c_str());
+            return;
+        }
+        fresh = fresh.Resolved();
+    }
+    string changed;
+    for (const string &key: config_.Diff(fresh)) {
+        //定时器只在开启超时时使用,在 0 与非 0 之间切换需要重启
+        bool reloadable = RELOADABLE.count(key) == 1 &&
+                          (key != "timeoutMs" || (config_.timeoutMs > 0 && fresh.timeoutMs > 0));
+        if (!reloadable) {
+            LOG_WARN("Reload: %s changed, restart required", key.c_str());
+            fresh.Set(key, config_.Get(key), err);
+            continue;
+        }
+        changed += changed.empty() ? key : ", " + key;
+    }
+    //先重建工作线程使用的表,失败时保留原来的表与相关参数
+    if (!SiteTables::Load(fresh.mimeTypesFile, fresh.htmlPages, err)) {
+        LOG_ERROR("Reload site tables error: %s, keep the current tables", err.c_str());
+        fresh.mimeTypesFile = config_.mimeTypesFile;
+        fresh.htmlPages = config_.htmlPages;
+    }
+    //清空文件缓存,磁盘上修改过的静态文件在下一次请求时重新读取
+    FileCache::Instance()->Init(fresh.fileCacheBytes, fresh.fileCacheMaxFile);
+
+    //监听套接字上的参数,之后 accept 的连接会继承缓冲区大小
+    if (fresh.sndBufBytes > 0) {
+        setsockopt(listenFd_, SOL_SOCKET, SO_SNDBUF, &fresh.sndBufBytes, sizeof(int));
+    }
+    if (fresh.rcvBufBytes > 0) {
+        setsockopt(listenFd_, SOL_SOCKET, SO_RCVBUF, &fresh.rcvBufBytes, sizeof(int));
+    }
+    if (fresh.deferAcceptSec != config_.deferAcceptSec) {
+        setsockopt(listenFd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &fresh.deferAcceptSec, sizeof(int));
+    }
+    if (fresh.listenBacklog != config_.listenBacklog) {
+        listen(listenFd_, fresh.listenBacklog);     //对已经在监听的套接字再次调用只修改队列长度
+    }
+    int maxConns = MAX_FD;
+    if (fresh.maxConnections > 0 && fresh.maxConnections < maxConns) {
+        maxConns = fresh.maxConnections;
+    }
+    admission_.Init(maxConns, fresh.shedQueueDepth, fresh.shedP99Ms, fresh.retryAfterSec);
+    evictCandidates_.clear();
+    if (fresh.openLog) {
+        Log::Instance()->SetLevel(fresh.logLevel);
+    }
+    HttpConn::slowRequestMs = fresh.slowRequestMs;
+    //开始、结束或换一个文件重新录制
+    if (fresh.captureFile != config_.captureFile || fresh.captureMaxBytes != config_.captureMaxBytes) {
+        StartCapture_(fresh);
+    }
+    timeoutMS_ = fresh.timeoutMs;
+    config_ = fresh;
+    reloadCount_++;
+    LOG_INFO("Config reloaded (#%llu), changed: %s", (unsigned long long) reloadCount_,
+             changed.empty() ? "none" : changed.c_str());
+}
+
 /**
  * @brief 服务器启动函数
  * 循环检测是否关闭服务器
@@ -104,6 +532,7 @@ void WebServer::InitEventMode_(int trigMode) {
  */
 void WebServer::Start() {
     int timeMS = -1;  /* epoll wait timeout == -1 无事件将阻塞 */
+    loopThread_ = this_thread::get_id();
     //循环检测是否关闭服务器
     if (!isClose_) {
         LOG_INFO("========== Server start ==========");
@@ -112,28 +541,115 @@ void WebServer::Start() {
         if (timeoutMS_ > 0) {
             //设置Epoll的超时时间
             timeMS = timer_->GetNextTick();
+            timerSize_.store(timer_->Size(), memory_order_relaxed);
+        }
+        if (draining_ && (timeMS < 0 || timeMS > DRAIN_CHECK_MS)) {
+            timeMS = DRAIN_CHECK_MS;    //排空期间定期检查连接是否已经处理完
         }
         //调用Epoll的Wait函数等待事件
-        int eventCnt = epoller_->Wait(timeMS);
+        if (slot_) {
+            PublishStats_();
+        }
+        int eventCnt = config_.busyPollUs > 0 ? BusyWait_(timeMS) : epoller_->Wait(timeMS);
         for (int i = 0; i < eventCnt; i++) {
             /* 处理事件 */
             int fd = epoller_->GetEventFd(i);
             uint32_t events = epoller_->GetEvents(i);
             if (fd == listenFd_) {      //处理监听事件
                 DealListen_();
+            } else if (fd == notifyFd_) {   //重新加载配置或平滑升级
+                DealNotify_();
+            } else if (fd == handoff_.ServeFd() || fd == handoff_.PeerFd()) {   //交接监听套接字
+                DealHandoff_(fd);
             } else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {   //处理关闭事件
-                assert(users_.count(fd) > 0);
-                CloseConn_(&users_[fd]);
+                assert(users_.Get(fd));
+                CloseConn_(users_.Get(fd));
             } else if (events & EPOLLIN) {  //处理读取请求
-                assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
+                assert(users_.Get(fd));
+                DealRead_(users_.Get(fd));
             } else if (events & EPOLLOUT) { //处理写入请求
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
+                assert(users_.Get(fd));
+                DealWrite_(users_.Get(fd));
             } else {
                 LOG_ERROR("Unexpected event");
             }
         }
+        if (draining_ && !idleDrained_) {
+            DrainIdle_();
+            idleDrained_ = true;
+        }
+        if (draining_ && (HttpConn::userCount == 0 || chrono::steady_clock::now() >= drainDeadline_)) {
+            LOG_INFO("Drain: done, %d conns left, exit", (int) HttpConn::userCount);
+            isClose_ = true;
+        }
+    }
+}
+
+/**
+ * @brief 忙轮询模式下等待事件
+ * 先用 epoll_wait(0) 轮询至多 busyPollUs 微秒,期间等到事件就立即返回,
+ * 省去线程睡眠与唤醒的延迟;轮询时长用完后再阻塞等待剩余的时间
+ * @param timeoutMs 最长等待时间,-1 表示一直等待
+ * @return 就绪的事件数
+ */
+int WebServer::BusyWait_(int timeoutMs) {
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    auto budget = microseconds(config_.busyPollUs);
+    if (timeoutMs >= 0 && milliseconds(timeoutMs) < budget) {
+        budget = milliseconds(timeoutMs);
+    }
+    auto deadline = start + budget;
+    int eventCnt = 0;
+    auto now = start;
+    do {
+        eventCnt = epoller_->Wait(0);
+        busyPolls_++;
+        now = steady_clock::now();
+    } while (eventCnt == 0 && now < deadline);
+    spinUs_ += duration_cast<microseconds>(now - start).count();
+    if (eventCnt != 0) {
+        busyHits_++;
+        return eventCnt;
+    }
+    busyBlocks_++;
+    if (timeoutMs >= 0) {
+        timeoutMs = max(0, timeoutMs - static_cast<int>(duration_cast<milliseconds>(now - start).count()));
+    }
+    return epoller_->Wait(timeoutMs);
+}
+
+/**
+ * @brief 按配置设置新连接的 TCP 参数
+ * 发送与接收缓冲区已经在监听套接字上设置,由新连接继承;
+ * 这里设置 TCP_NODELAY、TCP_NOTSENT_LOWAT、保活探测与内核忙轮询,任何一项失败都只记录一次警告
+ * @param fd
+ */
+void WebServer::TuneSocket_(int fd) {
+    bool ok = true;
+    int optval = 1;
+    if (config_.tcpNoDelay) {
+        ok = setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(int)) == 0 && ok;
+    }
+    if (config_.notSentLowat > 0) {
+        ok = setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &config_.notSentLowat, sizeof(int)) == 0 && ok;
+    }
+    if (config_.keepAliveIdleSec > 0) {
+        ok = setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(int)) == 0 && ok;
+        ok = setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &config_.keepAliveIdleSec, sizeof(int)) == 0 && ok;
+        ok = setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &config_.keepAliveIntvlSec, sizeof(int)) == 0 && ok;
+        ok = setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &config_.keepAliveCnt, sizeof(int)) == 0 && ok;
+    }
+    //内核忙轮询: 读取数据时内核直接轮询网卡队列,而不是等待中断
+    if (config_.sockBusyPollUs > 0) {
+        ok = setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &config_.sockBusyPollUs, sizeof(int)) == 0 && ok;
+    }
+    if (config_.preferBusyPoll) {
+        ok = setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &optval, sizeof(int)) == 0 && ok;
+    }
+    if (!ok && !tuneWarned_) {
+        tuneWarned_ = true;
+        LOG_WARN("set socket option error: %s", strerror(errno));
     }
 }
 
@@ -145,8 +661,11 @@ void WebServer::Start() {
  */
 void WebServer::SendError_(int fd, const char *info) {
     assert(fd > 0);
+    //先取走客户端已经发来的数据,否则关闭时内核会发送 RST,客户端可能收不到响应
+    char discard[4096];
+    while (recv(fd, discard, sizeof(discard), MSG_DONTWAIT) > 0) {}
     //使用send函数发送错误信息info到客户端
-    int ret = send(fd, info, strlen(info), 0);
+    int ret = send(fd, info, strlen(info), MSG_NOSIGNAL);
     if (ret < 0) {  //发送失败
         //则记录日志
         LOG_WARN("send error to client[%d] error!", fd);
@@ -155,6 +674,36 @@ void WebServer::SendError_(int fd, const char *info) {
     close(fd);
 }
 
+/**
+ * @brief 关闭最久没有活动的一个空闲连接,为新连接腾出位置
+ * 只考虑正在等待下一个请求的连接,正在处理请求的连接不受影响;
+ * 查找需要遍历定时器堆,因此一次找出 evictBatch 个候选,之后逐个使用
+ * @return 是否关闭了连接
+ */
+bool WebServer::EvictIdle_() {
+    if (timeoutMS_ <= 0) { return false; }  //没有定时器时无法判断空闲时间
+    auto isIdle = [this](int fd) {
+        HttpConn *client = users_.Get(fd);
+        return client && !client->IsClosed() && client->IsIdle();
+    };
+    for (int round = 0; round < 2; round++) {
+        while (!evictCandidates_.empty()) {
+            int fd = evictCandidates_.back();
+            evictCandidates_.pop_back();
+            if (!isIdle(fd)) { continue; }  //候选连接在这期间已经收到了新请求
+            LOG_INFO("Client[%d] evicted!", fd);
+            timer_->doWork(fd);     //触发定时器回调关闭连接,并删除定时器
+            evictCount_++;
+            return true;
+        }
+        if (round == 0) {
+            evictCandidates_ = timer_->Earliest(max(config_.evictBatch, 1), isIdle);
+            reverse(evictCandidates_.begin(), evictCandidates_.end());  //最空闲的放在末尾
+        }
+    }
+    return false;
+}
+
 /**
  * @brief 关闭每一个客户端的连接
  *
@@ -163,6 +712,7 @@ void WebServer::SendError_(int fd, const char *info) {
 void WebServer::CloseConn_(HttpConn *client) {
     assert(client);
     LOG_INFO("Client[%d] quit!", client->GetFd());  //记录日志
+    WEBSERVER_PROBE1(conn_close, client->GetFd());
     epoller_->DelFd(client->GetFd());               //使用epoller类删除文件描述符
     client->Close();
 }
@@ -174,48 +724,109 @@ void WebServer::CloseConn_(HttpConn *client) {
  *
  * @param fd 客户端连接的文件描述符
  * @param addr 客户端连接的地址信息addr
+ * @param ready 监听事件就绪的时间,用于统计 accept 阶段的耗时
+ * @return 文件描述符超出连接表的范围时返回 false,连接已经关闭
  */
-void WebServer::AddClient_(int fd, sockaddr_in addr) {
+bool WebServer::AddClient_(int fd, sockaddr_in addr, chrono::steady_clock::time_point ready) {
     assert(fd > 0);
-    users_[fd].init(fd, addr);  //初始化客户端连接
+    HttpConn *client = users_.Acquire(fd);
+    if (client == nullptr) {
+        //文件描述符超出了连接表的范围
+        SendError_(fd, "Server busy!");
+        LOG_WARN("Client fd[%d] out of range!", fd);
+        return false;
+    }
+    client->init(fd, addr);  //初始化客户端连接
     if (timeoutMS_ > 0) {
         //添加一个定时器，定时器会在指定的超时时间后关闭该客户端连接
-        //使用std::bind绑定WebServer对象和HttpConn对象的引用，以便在CloseConn_函数中可以访问HttpConn对象的成员
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+        //使用std::bind绑定WebServer对象和HttpConn对象的指针，以便在CloseConn_函数中可以访问HttpConn对象的成员
+        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, client));
     }
+    TuneSocket_(fd);
     //添加到epoll实例中，注册EPOLLIN事件，即可读事件，并将事件类型(connEvent_)加入到epoll事件表中
+    //fd 由 accept4 创建时已经是非阻塞的
     epoller_->AddFd(fd, EPOLLIN | connEvent_);
-    SetFdNonblock(fd);  //设置为非阻塞模式，以便异步IO操作
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    client->RecordAccept(ready);
+    WEBSERVER_PROBE3(conn_accept, fd, addr.sin_addr.s_addr, ntohs(addr.sin_port));
+    LOG_INFO("Client[%d] in!", client->GetFd());
+    return true;
 }
 
 /**
  * @brief 用于处理监听socket的事件
- *
+ * LT 与 ET 模式下都连续 accept,每次最多 acceptBatch 个,避免连接风暴时等待队列积压,
+ * 同时不会让事件循环长时间停在 accept 上
  */
 void WebServer::DealListen_() {
+    auto ready = chrono::steady_clock::now();
     struct sockaddr_in addr;     //存储新连接的地址信息
-    socklen_t len = sizeof(addr);//存储addr变量的长度
-    //监听新的客户端连接
-    do {
-        int fd = accept(listenFd_, (struct sockaddr *) &addr, &len);
-        //如果accept函数返回的文件描述符fd小于等于0，就直接返回，表示没有新的连接到来
-        if (fd <= 0) { return; }
-            //如果当前连接的数量(HttpConn::userCount)已经超过了Web服务器可以处理的最大连接数(MAX_FD)，
-            //就调用SendError_函数向新的连接返回错误信息，然后记录一个日志表示连接已满，
-            //然后直接返回，不再处理该连接
-        else if (HttpConn::userCount >= MAX_FD) {
-            SendError_(fd, "Server busy!");
-            LOG_WARN("Clients is full!");
-            return;
+    int batch = max(config_.acceptBatch, 1);
+    size_t queueDepth = threadpool_->QueueSize();
+    int i = 0;
+    for (; i < batch; i++) {
+        socklen_t len = sizeof(addr);//存储addr变量的长度
+        //accept4 直接创建非阻塞、exec 时关闭的套接字,省去一次 fcntl
+        int fd = accept4(listenFd_, (struct sockaddr *) &addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            //EAGAIN 表示等待队列已经取空
+            if (errno == EMFILE || errno == ENFILE) {
+                LOG_WARN("accept error: %s", strerror(errno));
+            }
+            break;
         }
-        //如果当前连接数量还没有达到最大值，
-        //就调用WebServer类的AddClient_函数，
-        //将新的连接添加到Web服务器中，处理该连接
-        AddClient_(fd, addr);
-        //使用EPOLLET事件模式时，如果还有新的连接在等待，就继续进行循环，等待新的连接到来
-    } while (listenEvent_ & EPOLLET);
-    //否则退出循环。EPOLLET是WebServer类的成员变量，表示是否启用边缘触发模式
+        //根据连接数、线程池等待队列和请求耗时决定是否接收该连接
+        int decision = admission_.Check(HttpConn::userCount, queueDepth);
+        if (decision == Admission::SHED_CONNS && EvictIdle_()) {
+            //连接数达到上限时先关闭最空闲的长连接
+            decision = admission_.Check(HttpConn::userCount, queueDepth);
+        }
+        if (decision != Admission::ADMIT) {
+            //返回预先生成的 503 响应,让客户端稍后重试
+            admission_.CountShed(decision);
+            SendError_(fd, admission_.BusyResponse().c_str());
+            LOG_WARN("Clients is busy, shed reason %d!", decision);
+            continue;
+        }
+        //将新的连接添加到Web服务器中，处理该连接;拒绝的连接由 admission_ 单独计数
+        if (AddClient_(fd, addr, ready)) { acceptCount_++; }
+    }
+    if (i == batch) {
+        //队列中可能还有连接,ET 模式下不会再收到通知,重新设置一次监听事件让 epoll 再报告一次
+        acceptFull_++;
+        if (listenEvent_ & EPOLLET) {
+            epoller_->ModFd(listenFd_, listenEvent_ | EPOLLIN);
+        }
+    }
+}
+
+/**
+ * @brief 读取内核统计的监听队列溢出次数(/proc/net/netstat 中的 TcpExt ListenOverflows)
+ * 这是整个网络命名空间的计数,服务器只关心它在运行期间的增量
+ * @return 无法读取时返回 0
+ */
+uint64_t WebServer::ListenOverflows_() {
+    FILE *fp = fopen("/proc/net/netstat", "r");
+    if (!fp) { return 0; }
+    char names[4096], values[4096];
+    uint64_t result = 0;
+    //文件中每个分组占两行,第一行是字段名,第二行是对应的值
+    while (fgets(names, sizeof(names), fp) && fgets(values, sizeof(values), fp)) {
+        if (strncmp(names, "TcpExt:", 7) != 0) { continue; }
+        char *nameSave, *valueSave;
+        char *name = strtok_r(names, " \n", &nameSave);
+        char *value = strtok_r(values, " \n", &valueSave);
+        while (name && value) {
+            if (strcmp(name, "ListenOverflows") == 0) {
+                result = strtoull(value, nullptr, 10);
+                break;
+            }
+            name = strtok_r(nullptr, " \n", &nameSave);
+            value = strtok_r(nullptr, " \n", &valueSave);
+        }
+        break;
+    }
+    fclose(fp);
+    return result;
 }
 
 /**
@@ -226,9 +837,31 @@ void WebServer::DealListen_() {
 void WebServer::DealRead_(HttpConn *client) {
     assert(client);         //检查client指针是否为空
     ExtentTime_(client);    //更新客户端连接的超时时间
+    client->SetIdle(false);
+    if (config_.inlineDispatch) {
+        //在事件循环线程中直接读取(套接字是非阻塞的),命中文件缓存的请求就地处理,
+        //省去一次入队、唤醒工作线程和线程切换;可能阻塞的请求(数据库、未缓存的文件)仍交给线程池
+        int readErrno = 0;
+        ssize_t ret = client->read(&readErrno);
+        if (ret <= 0 && readErrno != EAGAIN) {
+            CloseConn_(client);
+            return;
+        }
+        if (client->CanServeInline()) {
+            inlineCount_++;
+            OnProcess(client);
+        } else {
+            offloadCount_++;
+            client->MarkQueued();
+            threadpool_->AddTask(std::bind(&WebServer::OnProcess, this, client));
+        }
+        return;
+    }
+    offloadCount_++;
     //将一个任务添加到线程池中,该任务是一个绑定到OnRead_函数上的函数对象
     //绑定的对象是WebServer对象本身和client指针
     //以便在OnRead_函数中可以访问到HttpConn对象的成员
+    client->MarkQueued();
     threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client));
 }
 
@@ -240,6 +873,11 @@ void WebServer::DealRead_(HttpConn *client) {
 void WebServer::DealWrite_(HttpConn *client) {
     assert(client);     //检查client指针是否为空
     ExtentTime_(client);//更新客户端连接的超时时间
+    if (config_.inlineDispatch && client->IsCachedResponse()) {
+        //响应内容在内存中,非阻塞写不会等待磁盘,直接在事件循环线程中发送
+        OnWrite_(client);
+        return;
+    }
     //将一个任务添加到线程池中,该任务是一个绑定到OnWrite_函数上的函数对象
     //绑定的对象是WebServer对象本身和client指针
     //以便在OnWrite_函数中可以访问到HttpConn对象的成员
@@ -266,6 +904,7 @@ void WebServer::ExtentTime_(HttpConn *client) {
  */
 void WebServer::OnRead_(HttpConn *client) {
     assert(client);
+    client->MarkDequeued();
     int ret = -1;
     int readErrno = 0;
     //将读取到的数据保存到client对象的inBuf_成员变量中
@@ -280,145 +919,331 @@ void WebServer::OnRead_(HttpConn *client) {
 
 /**
  * @brief 处理客户端连接的请求
- *
+ * 依次处理读缓冲区中的请求,每生成一个响应就立即发送;
+ * 连续处理 PIPELINE_BUDGET 个请求后把连接交给线程池,不会一直占用当前线程
  * @param client 需要处理的客户端连接
  */
 void WebServer::OnProcess(HttpConn *client) {
-    if (client->process()) {    //如果client对象的process函数返回值为true，表示该客户端连接需要进行写操作
-        //修改客户端连接的文件描述符的事件类型为可写，从而让Epoll监控该客户端连接的可写事件
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-    } else {                    //如果process函数返回值为false，表示该客户端连接需要进行读操作
-        //修改客户端连接的文件描述符的事件类型为可读，从而让Epoll监控该客户端连接的可读事件
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+    client->MarkDequeued();
+    //如果client对象的process函数返回值为true，表示该客户端连接需要进行写操作
+    for (int served = 1; client->process(); served++) {
+        //套接字几乎总是可写的,生成响应后立即尝试发送,省去一次 epoll_ctl、epoll_wait 唤醒和线程池调度,
+        //只有内核发送缓冲区已满(EAGAIN)时才会注册可写事件
+        if (!SendResponse_(client) || YieldConn_(client, served)) { return; }
+    }
+    //如果process函数返回值为false，表示该客户端连接需要进行读操作
+    if (HttpConn::draining) {
+        //平滑升级中,最后一个响应已经带了 Connection: close
+        CloseConn_(client);
+        return;
     }
+    //没有未处理的请求,在重新注册读事件之前标记为空闲
+    client->SetIdle(true);
+    //修改客户端连接的文件描述符的事件类型为可读，从而让Epoll监控该客户端连接的可读事件
+    epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
 }
 
 /**
- * @brief 处理客户端连接的写操作
+ * @brief 处理客户端连接的写事件,发送完毕后继续处理读缓冲区中的下一个请求
  *
  * @param client 表示需要进行写操作的客户端连接
  */
 void WebServer::OnWrite_(HttpConn *client) {
     assert(client);
+    if (SendResponse_(client) && !YieldConn_(client, 0)) {
+        //继续处理该客户端连接的下一个请求
+        OnProcess(client);
+    }
+}
+
+/**
+ * @brief 发送客户端连接的响应
+ * 没有发送完时注册可写事件,出错或不保持连接时关闭连接
+ * @param client
+ * @return 响应已经发送完毕并且连接保持打开
+ */
+bool WebServer::SendResponse_(HttpConn *client) {
     int ret = -1;
     int writeErrno = 0;
     ret = client->write(&writeErrno);
     //检查客户端连接还有没有未发送完的数据
     if (client->ToWriteBytes() == 0) {  //所有数据都已经发送完毕
         /* 传输完成 */
+        admission_.RecordLatency(client->LastLatencyUs());
         //客户端连接的HTTP协议版本和是否支持持久连接
         if (client->IsKeepAlive()) {
-            //继续处理该客户端连接的下一个请求
-            OnProcess(client);
-            return;
-        }
-    } else if (ret < 0) {   //还有数据未发送完毕
-        if (writeErrno == EAGAIN) { //当前写缓冲区已满
-            /* 继续传输 */
-            //修改客户端连接的文件描述符的事件类型为可写，从而让Epoll监控该客户端连接的可写事件
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-            return;
+            return true;
         }
+    } else if (ret > 0 || writeErrno == EAGAIN) {   //还有数据未发送完毕
+        //当前写缓冲区已满,或 LT 模式下只发送了一部分
+        /* 继续传输 */
+        //修改客户端连接的文件描述符的事件类型为可写，从而让Epoll监控该客户端连接的可写事件
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+        return false;
     }
     //如果write函数返回的错误信息不是EAGAIN，那么说明写操作发生了严重错误
     CloseConn_(client);
+    return false;
+}
+
+/**
+ * @brief 发送完一个响应后,判断是否要把读缓冲区中剩下的请求交给线程池
+ * 连续处理的请求数达到 PIPELINE_BUDGET 时让出当前线程,避免一个流水线连接长期占用线程、加深调用栈;
+ * 在事件循环线程中,下一个请求同样只有命中缓存时才就地处理,登录注册、未缓存的文件仍交给线程池
+ * @param client
+ * @param served 本次调度中已经处理的请求数
+ * @return 是否已经交给线程池
+ */
+bool WebServer::YieldConn_(HttpConn *client, int served) {
+    if (!client->HasPendingRequest()) { return false; }
+    bool onLoop = this_thread::get_id() == loopThread_;
+    if (served < PIPELINE_BUDGET && !(onLoop && !client->CanServeInline())) { return false; }
+    offloadCount_++;
+    client->MarkQueued();
+    threadpool_->AddTask(std::bind(&WebServer::OnProcess, this, client));
+    return true;
 }
 
 /**
  * @brief 初始化服务器的Soccket
- *
+ * 使用 master 交给的监听套接字,或平滑升级时从旧进程接手,否则创建新的监听套接字
  */
 /* Create listenFd */
 bool WebServer::InitSocket_() {
+    if (listenFd_ >= 0) {
+        inherited_ = true;
+        return AdoptSocket_();
+    }
+    //平滑升级: 先尝试从旧进程接手监听套接字,两个进程在交接期间共用同一个等待队列
+    if (!config_.upgradeSocket.empty()) {
+        listenFd_ = handoff_.TakeOver(config_.upgradeSocket, inheritedFiles_);
+        if (listenFd_ >= 0) {
+            sockaddr_in bound;
+            socklen_t len = sizeof(bound);
+            if (getsockname(listenFd_, (struct sockaddr *) &bound, &len) == 0 && ntohs(bound.sin_port) == port_) {
+                inherited_ = true;
+                return AdoptSocket_();
+            }
+            //端口改变了,旧进程交接完成后停止在原来的端口上 accept
+            close(listenFd_);
+            listenFd_ = -1;
+        }
+        inheritedFiles_.clear();
+    }
+
+    listenFd_ = OpenListenSocket(config_);
+    if (listenFd_ < 0) { return false; }
+    //8.开始监听该套接字
+    int ret = epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
+    if (ret == 0) {
+        LOG_ERROR("Add listen error!");
+        close(listenFd_);
+        return false;
+    }
+    //9.记录服务器启动的信息,并返回 true
+    LOG_INFO("Server port:%d", port_);
+    return true;
+}
+
+/**
+ * @brief 使用已经绑定并在监听的套接字,只应用可以修改的参数
+ * @return
+ */
+bool WebServer::AdoptSocket_() {
+    if (config_.sndBufBytes > 0) {
+        setsockopt(listenFd_, SOL_SOCKET, SO_SNDBUF, &config_.sndBufBytes, sizeof(int));
+    }
+    if (config_.rcvBufBytes > 0) {
+        setsockopt(listenFd_, SOL_SOCKET, SO_RCVBUF, &config_.rcvBufBytes, sizeof(int));
+    }
+    setsockopt(listenFd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &config_.deferAcceptSec, sizeof(int));
+    listen(listenFd_, config_.listenBacklog);
+    if (epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN) == 0) {
+        LOG_ERROR("Add listen error!");
+        close(listenFd_);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 按配置创建监听套接字,prefork 模式下 master 在 fork 之前调用,工作进程共享同一个套接字
+ * @param config
+ * @return 非阻塞、exec 时关闭的监听套接字,失败时返回 -1
+ */
+int WebServer::OpenListenSocket(const Config &config) {
     int ret;
     struct sockaddr_in addr;
     //1.检查指定的端口是否合法
-    if (port_ > 65535 || port_ < 1024) {
-        LOG_ERROR("Port:%d error!", port_);
-        return false;
+    if (config.port > 65535 || config.port < 1024) {
+        LOG_ERROR("Port:%d error!", config.port);
+        return -1;
     }
     //2.初始化 sockaddr_in 结构体变量
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr.sin_port = htons(port_);
+    addr.sin_port = htons(config.port);
     struct linger optLinger = {0};
     //3.如果开启了优雅关闭选项，则设置 SO_LINGER 套接字选项
-    if (openLinger_) {
+    if (config.optLinger) {
         /* 优雅关闭: 直到所剩数据发送完毕或超时 */
         optLinger.l_onoff = 1;
         optLinger.l_linger = 1;
     }
 
-    //4.创建一个 SOCK_STREAM
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (listenFd_ < 0) {
-        LOG_ERROR("Create socket error!", port_);
-        return false;
+    //4.创建一个非阻塞的 SOCK_STREAM
+    int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        LOG_ERROR("Create socket error!", config.port);
+        return -1;
     }
 
 
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if (ret < 0) {
-        close(listenFd_);
-        LOG_ERROR("Init linger error!", port_);
-        return false;
+        close(listenFd);
+        LOG_ERROR("Init linger error!", config.port);
+        return -1;
     }
 
     int optval = 1;
     //5.设置 SO_REUSEADDR 套接字选项
     /* 端口复用 */
     /* 只有最后一个套接字会正常接收数据。 */
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void *) &optval, sizeof(int));
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const void *) &optval, sizeof(int));
     if (ret == -1) {
         LOG_ERROR("set socket setsockopt error !");
-        close(listenFd_);
-        return false;
+        close(listenFd);
+        return -1;
+    }
+    //SO_REUSEPORT: 多个进程各自绑定同一个端口,内核按连接的四元组把新连接分给其中一个套接字
+    if (config.reusePort &&
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, (const void *) &optval, sizeof(int)) < 0) {
+        LOG_ERROR("set SO_REUSEPORT error!");
+        close(listenFd);
+        return -1;
+    }
+
+    //缓冲区大小需要在 listen 之前设置: 接收缓冲区决定了握手时协商的窗口扩大因子,新连接会继承这两项设置
+    if (config.sndBufBytes > 0 &&
+        setsockopt(listenFd, SOL_SOCKET, SO_SNDBUF, &config.sndBufBytes, sizeof(int)) < 0) {
+        LOG_WARN("set SO_SNDBUF error!");
+    }
+    if (config.rcvBufBytes > 0 &&
+        setsockopt(listenFd, SOL_SOCKET, SO_RCVBUF, &config.rcvBufBytes, sizeof(int)) < 0) {
+        LOG_WARN("set SO_RCVBUF error!");
     }
 
     //6.将套接字绑定到指定的地址
-    ret = bind(listenFd_, (struct sockaddr *) &addr, sizeof(addr));
+    ret = bind(listenFd, (struct sockaddr *) &addr, sizeof(addr));
     if (ret < 0) {
-        LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
-        return false;
+        LOG_ERROR("Bind Port:%d error!", config.port);
+        close(listenFd);
+        return -1;
+    }
+
+    //TCP_DEFER_ACCEPT: 客户端发来数据后内核才把连接交给 accept,只建立连接不发请求的客户端不会唤醒事件循环
+    if (config.deferAcceptSec > 0) {
+        ret = setsockopt(listenFd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &config.deferAcceptSec, sizeof(int));
+        if (ret < 0) {
+            LOG_WARN("set TCP_DEFER_ACCEPT error!");
+        }
     }
 
     //7.开始监听该套接字
-    ret = listen(listenFd_, 6);
+    ret = listen(listenFd, config.listenBacklog);
     if (ret < 0) {
-        LOG_ERROR("Listen port:%d error!", port_);
-        close(listenFd_);
-        return false;
+        LOG_ERROR("Listen port:%d error!", config.port);
+        close(listenFd);
+        return -1;
     }
+    return listenFd;
+}
 
-    //8.开始监听该套接字
-    ret = epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
-    if (ret == 0) {
-        LOG_ERROR("Add listen error!");
-        close(listenFd_);
-        return false;
+/**
+ * @brief 按配置开始录制流量,captureFile 为空时结束录制
+ * prefork 模式下每个工作进程录制到各自的文件,文件名加上 .w<序号>;之后建立的连接才会被录制
+ * @param config
+ */
+void WebServer::StartCapture_(const Config &config) {
+    TrafficCapture *capture = TrafficCapture::Instance();
+    if (config.captureFile.empty()) {
+        if (capture->IsOpen()) {
+            capture->Close();
+            LOG_INFO("Capture stopped, dropped records: %llu", (unsigned long long) capture->Dropped());
+        }
+        return;
+    }
+    string path = config.captureFile + (slot_ ? ".w" + to_string(slot_->index) : "");
+    if (capture->Init(path.c_str(), config.captureMaxBytes)) {
+        LOG_INFO("Capture: %s, max %zu bytes", path.c_str(), config.captureMaxBytes);
+    } else {
+        LOG_ERROR("Capture %s error: %s", path.c_str(), strerror(errno));
     }
-    //9.将套接字设置为非阻塞模式
-    SetFdNonblock(listenFd_);
-    //10.记录服务器启动的信息,并返回 true
-    LOG_INFO("Server port:%d", port_);
-    return true;
 }
 
 /**
- * @brief 将文件描述符 fd 设置为非阻塞模式
- * 在调用读写函数时，如果没有数据可以读取或写入，
- * 则函数会立即返回，而不是一直等待数据的到来或写入完成
- *
- * @param fd
- * @return int
+ * @brief 注册抓取时读取的监控指标: 连接数、线程池与数据库连接池、定时器,以及各处已有的计数
+ * 回调在处理 metricsPath 请求的工作线程中调用,只读取原子变量或自带锁的接口
  */
-int WebServer::SetFdNonblock(int fd) {
-    assert(fd > 0);
-    //调用 fcntl 函数，并传递 F_SETFL 和 O_NONBLOCK 两个参数实现
-    //F_SETFL 用于设置文件描述符的状态标志
-    //O_NONBLOCK 则表示将文件描述符设置为非阻塞模式
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
+void WebServer::InitMetrics_() {
+    Metrics *metrics = Metrics::Instance();
+    metrics->AddCallback("webserver_start_time_seconds", "gauge", "Start time of the server since unix epoch.",
+                         [this] { return static_cast<double>(startTime_); });
+    metrics->AddCallback("webserver_connections", "gauge", "Open client connections.",
+                         [] { return static_cast<double>(HttpConn::userCount); });
+    metrics->AddCallback("webserver_connections_accepted_total", "counter", "Connections accepted and served, excluding shed ones.",
+                         [this] { return static_cast<double>(acceptCount_); });
+    metrics->AddCallback("webserver_connections_evicted_total", "counter",
+                         "Idle keep-alive connections closed to admit new ones.",
+                         [this] { return static_cast<double>(evictCount_); });
+    int threads = config_.threadNum;
+    metrics->AddCallback("webserver_threadpool_threads", "gauge", "Worker threads.",
+                         [threads] { return static_cast<double>(threads); });
+    metrics->AddCallback("webserver_threadpool_queue_depth", "gauge", "Tasks waiting in the thread pool queue.",
+                         [this] { return static_cast<double>(threadpool_->QueueSize()); });
+    metrics->AddCallback("webserver_sql_free_connections", "gauge", "Idle connections in the SQL pool.",
+                         [] { return static_cast<double>(SqlConnPool::Instance()->GetFreeConnCount()); });
+    metrics->AddCallback("webserver_timer_heap_size", "gauge", "Connections with an idle timer.",
+                         [this] { return static_cast<double>(timerSize_.load(memory_order_relaxed)); });
+    metrics->AddCallback("webserver_filecache_hits_total", "counter", "File cache hits.",
+                         [] { return static_cast<double>(FileCache::Instance()->Hits()); });
+    metrics->AddCallback("webserver_filecache_misses_total", "counter", "File cache misses.",
+                         [] { return static_cast<double>(FileCache::Instance()->Misses()); });
+    metrics->AddCallback("webserver_config_reloads_total", "counter", "Configuration reloads.",
+                         [this] { return static_cast<double>(reloadCount_); });
+    //带标签的计数,同一个指标名只输出一次 HELP 与 TYPE
+    metrics->AddCollector([this](string &out) {
+        char line[256];
+        out += "# HELP webserver_dispatch_total Requests handled in the event loop or the thread pool.\n";
+        out += "# TYPE webserver_dispatch_total counter\n";
+        snprintf(line, sizeof(line), "webserver_dispatch_total{mode=\"inline\"} %llu\n"
+                                     "webserver_dispatch_total{mode=\"offload\"} %llu\n",
+                 (unsigned long long) inlineCount_, (unsigned long long) offloadCount_);
+        out += line;
+        out += "# HELP webserver_connections_shed_total Connections rejected with 503, by reason.\n";
+        out += "# TYPE webserver_connections_shed_total counter\n";
+        snprintf(line, sizeof(line), "webserver_connections_shed_total{reason=\"conns\"} %llu\n"
+                                     "webserver_connections_shed_total{reason=\"queue\"} %llu\n"
+                                     "webserver_connections_shed_total{reason=\"latency\"} %llu\n",
+                 (unsigned long long) admission_.Shed(Admission::SHED_CONNS),
+                 (unsigned long long) admission_.Shed(Admission::SHED_QUEUE),
+                 (unsigned long long) admission_.Shed(Admission::SHED_LATENCY));
+        out += line;
+    });
 }
 
-
+/**
+ * @brief 把本工作进程的计数发布到共享统计表,每次等待事件之前调用
+ */
+void WebServer::PublishStats_() {
+    WorkerStats current;
+    current.accepted = acceptCount_;
+    current.requests = inlineCount_ + offloadCount_;
+    for (int decision = Admission::SHED_CONNS; decision < Admission::DECISION_COUNT; decision++) {
+        current.shed += admission_.Shed(decision);
+    }
+    current.cacheHits = FileCache::Instance()->Hits();
+    current.cacheMisses = FileCache::Instance()->Misses();
+    Scoreboard::Publish(slot_, HttpConn::userCount, current, published_);
+}
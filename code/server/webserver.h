@@ -1,53 +1,101 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
-#include <unordered_map>
 #include <fcntl.h>       // fcntl()
 #include <unistd.h>      // close()
 #include <assert.h>
 #include <errno.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h> // TCP_DEFER_ACCEPT
 #include <arpa/inet.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <functional>
+#include <thread>
+#include <unordered_set>
 
 #include "epoller.h"
+#include "connslab.h"
+#include "admission.h"
+#include "handoff.h"
+#include "scoreboard.h"
 #include "../log/log.h"
 #include "../timer/heaptimer.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
 #include "../pool/sqlconnRAII.h"
 #include "../http/httpconn.h"
+#include "../http/handlers.h"
+#include "../config/config.h"
 
 //定义了WebServer类,该类用于构建WebServer。使用Epoller来监听新连接
 //并使用回调函数来创建HttpConn对象来处理连接的读写事件,最后使用线程池将
 //客户端任务与数据库任务加入工作队列中进行后续处理
 class WebServer {
 public:
-    WebServer(
-            int port, int trigMode, int timeoutMS, bool OptLinger,
-            int sqlPort, const char *sqlUser, const char *sqlPwd,
-            const char *dbName, int connPoolNum, int threadNum,
-            bool openLog, int logLevel, int logQueSize);
+    explicit WebServer(const Config &config = Config(), int listenFd = -1, WorkerSlot *slot = nullptr);
 
     ~WebServer();
 
     void Start();
 
+    void SetReloader(std::function<bool(Config &, std::string &)> reloader);
+
+    void SetUpgradeCommand(const std::string &cwd, const std::vector <std::string> &argv);
+
+    static void RequestReload();
+
+    static void RequestUpgrade();
+
+    static void RequestStop();
+
+    static int OpenListenSocket(const Config &config);
+
 private:
     bool InitSocket_();
 
+    bool AdoptSocket_();
+
     void InitEventMode_(int trigMode);
 
-    void AddClient_(int fd, sockaddr_in addr);
+    bool InitNotify_();
+
+    void DealNotify_();
+
+    void Reload_();
+
+    void Upgrade_();
+
+    void DealHandoff_(int fd);
+
+    void StartDrain_(int timeoutMs);
+
+    void DrainIdle_();
+
+    void PublishStats_();
+
+    void InitMetrics_();
+
+    void StartCapture_(const Config &config);
+
+    bool AddClient_(int fd, sockaddr_in addr, std::chrono::steady_clock::time_point ready);
 
     void DealListen_();
 
+    int BusyWait_(int timeoutMs);
+
+    void TuneSocket_(int fd);
+
     void DealWrite_(HttpConn *client);
 
     void DealRead_(HttpConn *client);
 
     void SendError_(int fd, const char *info);
 
+    bool EvictIdle_();
+
     void ExtentTime_(HttpConn *client);
 
     void CloseConn_(HttpConn *client);
@@ -58,10 +106,25 @@ private:
 
     void OnProcess(HttpConn *client);
 
+    bool SendResponse_(HttpConn *client);
+
+    bool YieldConn_(HttpConn *client, int served);
+
     static const int MAX_FD = 65536;
+    static const int PIPELINE_BUDGET = 16;      //一次调度中在同一个连接上最多连续处理的请求数
+
+    static uint64_t ListenOverflows_();
+
+    static void Notify_(unsigned what);
 
-    static int SetFdNonblock(int fd);
+    static const unsigned NOTIFY_RELOAD = 1;    //重新加载配置
+    static const unsigned NOTIFY_UPGRADE = 2;   //平滑升级
+    static const unsigned NOTIFY_STOP = 4;      //停止 accept,处理完已有的连接后退出
+    static const int STOP_DRAIN_MS = 5000;      //收到 SIGTERM 后最多等待已有连接的时间,小于 master 强制结束前等待的时间
+    static const int DRAIN_CHECK_MS = 100;      //排空期间检查剩余连接数的间隔
+    static const int DRAIN_IDLE_MS = 1000;      //排空开始后空闲长连接最多再等待下一个请求的时间
 
+    Config config_;   //表示服务器的运行参数,自动取值的项已经替换为实际值
     int port_;        //表示服务器监听的端口号
     bool openLinger_; //表示是否开启优雅关闭连接
     int timeoutMS_;   //表示客户端连接的超时时间（毫秒）
@@ -75,7 +138,43 @@ private:
     std::unique_ptr <HeapTimer> timer_;         //表示 Web 服务器使用的定时器，用于超时检测
     std::unique_ptr <ThreadPool> threadpool_;   //表示 Web 服务器使用的线程池，用于处理客户端请求
     std::unique_ptr <Epoller> epoller_;         //表示 Web 服务器使用的 epoll 实例，用于监听和处理事件
-    std::unordered_map<int, HttpConn> users_;   //表示当前所有的客户端连接，其中键为文件描述符，值为 HttpConn 类型的对象
+    std::atomic <uint64_t> acceptCount_;    //接收并开始服务的连接数,不含拒绝(503)的连接
+    std::atomic <uint64_t> acceptFull_;     //一次监听事件 accept 满 acceptBatch 个的次数,说明等待队列有积压
+    uint64_t overflowBase_;                 //启动时内核 ListenOverflows 计数
+    time_t startTime_;                      //启动时间,用于计算 accept 速率
+    Admission admission_;                   //接入控制
+    std::atomic <uint64_t> evictCount_;     //因连接数达到上限而关闭的空闲长连接数
+    std::vector<int> evictCandidates_;      //待关闭的空闲连接,最空闲的在末尾
+    uint64_t busyPolls_;                    //忙轮询时调用 epoll_wait(0) 的次数
+    uint64_t busyHits_;                     //忙轮询期间等到事件的次数
+    uint64_t busyBlocks_;                   //轮询时长用完后阻塞等待的次数
+    uint64_t spinUs_;                       //忙轮询花费的时间,微秒
+    bool tuneWarned_;                       //设置连接的套接字选项失败时只记录一次日志
+    std::atomic <uint64_t> inlineCount_;    //在事件循环线程中直接处理的请求数
+    std::atomic <uint64_t> offloadCount_;   //交给线程池处理的请求数
+    std::thread::id loopThread_;            //运行事件循环的线程,Start 时记下
+
+    int notifyFd_;                          //信号处理函数通知事件循环的 eventfd,注册在 epoll 中
+    std::function<bool(Config &, std::string &)> reloader_;   //重新读取配置的方法,由 main 提供
+    std::atomic <uint64_t> reloadCount_;    //重新加载的次数
+    static std::atomic<int> notifyTarget_;  //信号处理函数写入的 eventfd
+    static std::atomic<unsigned> pending_;  //等待事件循环处理的请求,NOTIFY_* 的组合
+
+    Handoff handoff_;                       //平滑升级时与新旧进程交接监听套接字
+    bool inherited_;                        //监听套接字是否由旧进程交接而来
+    std::vector <std::string> inheritedFiles_;  //旧进程已缓存的文件,用于预热文件缓存
+    std::string upgradeCwd_;                //启动时的工作目录,新进程在这里启动
+    std::vector <std::string> upgradeArgv_; //启动新进程的命令行
+    pid_t upgradePid_;                      //最近一次启动的新进程
+    bool draining_;                         //已交出监听套接字,正在等待已有连接处理完
+    bool idleDrained_;                      //是否已经处理过排空开始时的空闲连接
+    std::chrono::steady_clock::time_point drainDeadline_;  //等待已有连接的截止时间
+
+    std::atomic <size_t> timerSize_;        //定时器堆的大小,由事件循环线程更新,抓取监控指标时读取
+    WorkerSlot *slot_;                      //prefork 模式下本工作进程在共享统计表中的槽,单进程模式为 nullptr
+    WorkerStats published_;                 //上次发布到 slot_ 的计数
+
+    ConnSlab users_;    //表示所有的客户端连接，按文件描述符下标索引，对象地址在运行期间不变
 };
 
 
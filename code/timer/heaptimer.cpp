@@ -1,4 +1,5 @@
 #include "heaptimer.h"
+#include "../metrics/probes.h"
 
 /**
  * @brief 向上调整堆,heap_为存储堆节点的容器,
@@ -172,6 +173,7 @@ void HeapTimer::tick() {
         if (std::chrono::duration_cast<MS>(node.expires - Clock::now()).count() > 0) {
             break;
         }
+        WEBSERVER_PROBE1(timer_expire, node.id);
         node.cb();
         pop();
     }
@@ -210,4 +212,27 @@ int HeapTimer::GetNextTick() {
     }
     //返回计算结果
     return res;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 找出最早到期(即最久没有活动)的若干个定时器
+ * 需要遍历整个堆,只在过载时调用
+ * @param n 最多返回的个数
+ * @param filter 只考虑 filter 返回 true 的 id
+ * @return 按到期时间从早到晚排列的 id
+ */
+std::vector<int> HeapTimer::Earliest(size_t n, const std::function<bool(int)> &filter) const {
+    std::vector <std::pair<TimeStamp, int>> nodes;
+    for (auto &node: heap_) {
+        if (filter(node.id)) {
+            nodes.emplace_back(node.expires, node.id);
+        }
+    }
+    n = std::min(n, nodes.size());
+    std::partial_sort(nodes.begin(), nodes.begin() + n, nodes.end());
+    std::vector<int> ids;
+    for (size_t i = 0; i < n; i++) {
+        ids.push_back(nodes[i].second);
+    }
+    return ids;
+}
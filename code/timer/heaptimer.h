@@ -50,6 +50,10 @@ public:
 
     int GetNextTick();
 
+    std::vector<int> Earliest(size_t n, const std::function<bool(int)> &filter) const;
+
+    size_t Size() const { return heap_.size(); }
+
 private:
     void del_(size_t i);
 
@@ -0,0 +1,77 @@
+#include "connharness.h"
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include "../code/http/handlers.h"
+#include "../code/http/sitetables.h"
+#include "../code/pool/userstore.h"
+
+using namespace std;
+
+/**
+ * @brief 构造函数,建立一对非阻塞的 Unix 套接字并初始化连接
+ * @param srcDir 静态文件目录,以 / 结尾
+ */
+ConnHarness::ConnHarness(const char *srcDir) {
+    HttpConn::srcDir = srcDir;
+    HttpConn::isET = true;      //读写到 EAGAIN 为止,与服务器的默认触发模式相同
+    UserStore::Set(make_shared<MemoryUserStore>());
+    string err;
+    SiteTables::Load("", "/index,/register,/login,/welcome,/video,/picture", err);
+    shared_ptr<Router> router = make_shared<Router>();
+    AddDefaultRoutes(*router, err);
+    Router::Install(router);
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds);
+    clientFd_ = fds[0];
+    sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    conn_.init(fds[1], addr);
+}
+
+ConnHarness::~ConnHarness() {
+    conn_.Close();
+    close(clientFd_);
+}
+
+/**
+ * @brief 发送一个请求,由 HttpConn 读取、处理并写回,返回收到的完整响应(头部与正文)
+ * 套接字缓冲区放不下的响应边写边读,不会阻塞
+ * @param request
+ * @param response
+ * @return 连接出错时返回 false
+ */
+bool ConnHarness::RoundTrip(const string &request, string &response) {
+    response.clear();
+    if (write(clientFd_, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+        return false;
+    }
+    int err = 0;
+    if (conn_.read(&err) <= 0 && err != EAGAIN) { return false; }
+    if (!conn_.process()) { return false; }
+    while (conn_.ToWriteBytes() > 0) {
+        if (conn_.write(&err) < 0 && err != EAGAIN) { return false; }
+        if (!Drain_(response)) { return false; }
+    }
+    return Drain_(response);
+}
+
+/**
+ * @brief 读出客户端一端已经收到的数据
+ * @param response
+ * @return
+ */
+bool ConnHarness::Drain_(string &response) {
+    char buf[65536];
+    while (true) {
+        ssize_t n = read(clientFd_, buf, sizeof(buf));
+        if (n > 0) {
+            response.append(buf, n);
+        } else {
+            return n < 0 && errno == EAGAIN;
+        }
+    }
+}
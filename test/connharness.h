@@ -0,0 +1,26 @@
+#ifndef CONN_HARNESS_H
+#define CONN_HARNESS_H
+
+#include <string>
+#include "../code/http/httpconn.h"
+
+//在进程内通过 socketpair 驱动 HttpConn 的 read / process / write,不需要监听套接字、epoll 与 MySQL
+//构造时把账号存储换成 MemoryUserStore,登录与注册请求只访问内存;结果只取决于请求与静态文件,适合基准与回归
+class ConnHarness {
+public:
+    explicit ConnHarness(const char *srcDir);
+
+    ~ConnHarness();
+
+    bool RoundTrip(const std::string &request, std::string &response);
+
+    HttpConn &Conn() { return conn_; }
+
+private:
+    bool Drain_(std::string &response);
+
+    int clientFd_;      //模拟客户端的一端
+    HttpConn conn_;     //持有服务器一端
+};
+
+#endif //CONN_HARNESS_H
@@ -0,0 +1,352 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "connharness.h"
+#include "../code/buffer/buffer.h"
+#include "../code/http/filecache.h"
+#include "../code/http/handlers.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/sitetables.h"
+#include "../code/log/log.h"
+#include "../code/pool/userstore.h"
+#include "../code/pool/threadpool.h"
+#include "../code/timer/heaptimer.h"
+
+//各模块的微基准,基于 Google Benchmark
+//默认在控制台输出的同时把结果以 JSON 写入 microbench.json,两个版本的结果可以用
+//Google Benchmark 自带的 tools/compare.py benchmarks old.json new.json 对比
+
+namespace {
+
+/* Buffer */
+
+void BM_BufferAppend(benchmark::State &state) {
+    Buffer buff;
+    std::string data(state.range(0), 'x');
+    for (auto _: state) {
+        buff.Append(data);
+        buff.RetrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BufferAppend)->Arg(16)->Arg(256)->Arg(4096)->Arg(65536);
+
+//每次从 socketpair 读出对端写入的 range(0) 字节,超过缓冲区可写空间的部分经过 ReadFd 的栈上额外缓冲区
+void BM_BufferReadFd(benchmark::State &state) {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    int size = static_cast<int>(state.range(0));
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    std::string data(state.range(0), 'x');
+    Buffer buff;
+    int err = 0;
+    for (auto _: state) {
+        state.PauseTiming();
+        if (write(fds[0], data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+            state.SkipWithError("short write");
+            break;
+        }
+        state.ResumeTiming();
+        size_t got = 0;
+        while (got < data.size()) {
+            ssize_t n = buff.ReadFd(fds[1], &err);
+            if (n <= 0) { break; }
+            got += n;
+        }
+        buff.RetrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    close(fds[0]);
+    close(fds[1]);
+}
+BENCHMARK(BM_BufferReadFd)->Arg(512)->Arg(16384)->Arg(131072);
+
+/* HttpRequest::parse */
+
+//典型的请求: 最简单的 GET、浏览器发出的带常见头部的 GET、表单 POST(不经过登录与注册,不访问数据库)
+const char *const CORPUS[] = {
+        "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n",
+
+        "GET /picture.html HTTP/1.1\r\n"
+        "Host: 127.0.0.1:1316\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+        "Chrome/110.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Cookie: session=7f3a9c2e41b84d6f; theme=dark\r\n"
+        "\r\n",
+
+        "POST /welcome.html HTTP/1.1\r\n"
+        "Host: 127.0.0.1:1316\r\n"
+        "Connection: keep-alive\r\n"
+        "Content-Type: application/x-www-form-urlencoded\r\n"
+        "Content-Length: 43\r\n"
+        "\r\n"
+        "username=%E5%BC%A0%E4%B8%89&password=abc123",
+};
+
+void BM_HttpRequestParse(benchmark::State &state) {
+    std::string err;
+    SiteTables::Load("", "/index,/register,/login,/welcome,/video,/picture", err);
+    const char *request = CORPUS[state.range(0)];
+    size_t len = strlen(request);
+    Buffer buff;
+    HttpRequest req;
+    for (auto _: state) {
+        buff.Append(request, len);
+        req.Init();
+        bool ok = req.parse(buff);
+        benchmark::DoNotOptimize(ok);
+        buff.RetrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(BM_HttpRequestParse)->ArgName("corpus")->DenseRange(0, 2);
+
+/* Router::Match */
+
+//自带的路由加上监控指标与几条带参数的路由: 表单 POST、回退到静态文件的 GET、监控指标、带参数的路径
+const char *const ROUTE_METHODS[] = {"POST", "GET", "GET", "GET"};
+const char *const ROUTE_PATHS[] = {"/login", "/images/profile-image.jpg", "/metrics", "/api/user/42/posts"};
+
+void BM_RouterMatch(benchmark::State &state) {
+    Router router;
+    std::string err;
+    AddDefaultRoutes(router, err);
+    router.Add("GET", "/metrics", std::make_shared<MetricsHandler>(), err);
+    router.Add("GET", "/api/user/:id", std::make_shared<StaticHandler>(), err);
+    router.Add("GET", "/api/user/:id/posts", std::make_shared<StaticHandler>(), err);
+    router.Add("GET", "/api/static/*file", std::make_shared<StaticHandler>(), err);
+    std::string method = ROUTE_METHODS[state.range(0)];
+    std::string path = ROUTE_PATHS[state.range(0)];
+    RouteParams params;
+    for (auto _: state) {
+        Handler *handler = router.Match(method, path, params);
+        benchmark::DoNotOptimize(handler);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RouterMatch)->ArgName("route")->DenseRange(0, 3);
+
+/* HttpConn,经过 socketpair 的完整请求处理 */
+
+//先处理一次请求,检查状态码与正文中的页面标题;返回的是错误页面时跳过测试,不把它的耗时当作结果
+bool CheckResponse(benchmark::State &state, ConnHarness &harness, const std::string &request, const char *title) {
+    std::string response;
+    if (!harness.RoundTrip(request, response)) {
+        state.SkipWithError("round trip failed");
+        return false;
+    }
+    if (response.compare(0, 15, "HTTP/1.1 200 OK") != 0) {
+        state.SkipWithError(("unexpected status: " + response.substr(0, response.find('\r'))).c_str());
+        return false;
+    }
+    if (response.find(title) == std::string::npos) {
+        state.SkipWithError(("unexpected page, expected " + std::string(title)).c_str());
+        return false;
+    }
+    return true;
+}
+
+//range(0): 0 不缓存文件(每次 stat 与 mmap) 1 使用文件缓存
+void BM_HttpConnGet(benchmark::State &state) {
+    FileCache::Instance()->Init(state.range(0) ? 64 * 1024 * 1024 : 0, 1024 * 1024);
+    ConnHarness harness(STATIC_DIR);
+    std::string request = "GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n";
+    if (!CheckResponse(state, harness, request, "<title>MARK-首页")) {
+        FileCache::Instance()->Init(0, 0);
+        return;
+    }
+    std::string response;
+    for (auto _: state) {
+        if (!harness.RoundTrip(request, response)) {
+            state.SkipWithError("round trip failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * response.size());
+    FileCache::Instance()->Init(0, 0);
+}
+BENCHMARK(BM_HttpConnGet)->ArgName("cached")->Arg(0)->Arg(1);
+
+//登录请求,账号存储为 MemoryUserStore
+void BM_HttpConnLogin(benchmark::State &state) {
+    ConnHarness harness(STATIC_DIR);
+    UserStore::Current()->Register("user", "secret");
+    std::string body = "username=user&password=secret";
+    std::string request = "POST /login HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n"
+                          "Content-Type: application/x-www-form-urlencoded\r\n"
+                          "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    //登录失败时返回的 error.html 同样是 200,需要检查是欢迎页面
+    if (!CheckResponse(state, harness, request, "<title>MARK-欢迎")) { return; }
+    std::string response;
+    for (auto _: state) {
+        if (!harness.RoundTrip(request, response)) {
+            state.SkipWithError("round trip failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HttpConnLogin);
+
+/* HeapTimer */
+
+//添加 range(0) 个定时器
+void BM_HeapTimerAdd(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    HeapTimer timer;
+    for (auto _: state) {
+        for (int id = 0; id < n; id++) {
+            timer.add(id, 60000 + id % 1000, [] {});
+        }
+        state.PauseTiming();
+        timer.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_HeapTimerAdd)->Range(1 << 10, 1 << 16);
+
+//在 range(0) 个定时器中随机延长一个,相当于每次读写事件的 ExtentTime_
+void BM_HeapTimerAdjust(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    HeapTimer timer;
+    for (int id = 0; id < n; id++) {
+        timer.add(id, 60000 + id % 1000, [] {});
+    }
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> pick(0, n - 1);
+    for (auto _: state) {
+        timer.adjust(pick(rng), 60000);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HeapTimerAdjust)->Range(1 << 10, 1 << 16);
+
+//range(0) 个定时器全部到期,一次 tick 依次回调并弹出
+void BM_HeapTimerTick(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    HeapTimer timer;
+    int fired = 0;
+    for (auto _: state) {
+        state.PauseTiming();
+        for (int id = 0; id < n; id++) {
+            timer.add(id, 0, [&fired] { fired++; });
+        }
+        state.ResumeTiming();
+        timer.tick();
+    }
+    benchmark::DoNotOptimize(fired);
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_HeapTimerTick)->Range(1 << 10, 1 << 16);
+
+/* Log */
+
+//range(0): 0 同步写 1 异步写(队列写满时在调用线程中写文件,与服务器的默认设置相同);range(1): 0 文本 1 二进制
+//多个线程同时写时只由 Setup 初始化一次日志
+void LogSetup(const benchmark::State &state) {
+    bool async = state.range(0) != 0;
+    bool binary = state.range(1) != 0;
+    mkdir("./microbench_log", 0777);
+    Log::Instance()->init(1, "./microbench_log", binary ? ".blog" : ".log", async ? 1024 : 0, binary,
+                          0, Log::OVERFLOW_SPILL);
+}
+
+void LogTeardown(const benchmark::State &) {
+    Log::Instance()->flush();
+}
+
+void BM_LogWrite(benchmark::State &state) {
+    int i = 0;
+    for (auto _: state) {
+        LOG_INFO("Client[%d](%s:%d) in, userCount:%d", i, "127.0.0.1", 40000 + i % 20000, i % 1000);
+        i++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogWrite)->ArgNames({"async", "binary"})->Args({0, 0})->Args({1, 0})->Args({0, 1})->Args({1, 1})
+        ->Setup(LogSetup)->Teardown(LogTeardown)->ThreadRange(1, 4)->UseRealTime();
+
+/* ThreadPool */
+
+//提交一个任务并等待它执行完,测量入队、唤醒工作线程与通知的往返开销
+void BM_ThreadPoolRoundTrip(benchmark::State &state) {
+    ThreadPool pool(state.range(0));
+    std::mutex mtx;
+    std::condition_variable cond;
+    bool done = false;
+    for (auto _: state) {
+        pool.AddTask([&] {
+            std::lock_guard <std::mutex> locker(mtx);
+            done = true;
+            cond.notify_one();
+        });
+        std::unique_lock <std::mutex> locker(mtx);
+        cond.wait(locker, [&done] { return done; });
+        done = false;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadPoolRoundTrip)->ArgName("threads")->Arg(1)->Arg(4)->UseRealTime();
+
+//一次提交 1000 个空任务并等待全部完成,测量队列在争用下的吞吐
+void BM_ThreadPoolThroughput(benchmark::State &state) {
+    const int BATCH = 1000;
+    ThreadPool pool(state.range(0));
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::atomic<int> remaining(0);
+    for (auto _: state) {
+        remaining = BATCH;
+        for (int i = 0; i < BATCH; i++) {
+            pool.AddTask([&] {
+                if (--remaining == 0) {
+                    std::lock_guard <std::mutex> locker(mtx);
+                    cond.notify_one();
+                }
+            });
+        }
+        std::unique_lock <std::mutex> locker(mtx);
+        cond.wait(locker, [&remaining] { return remaining == 0; });
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+BENCHMARK(BM_ThreadPoolThroughput)->ArgName("threads")->Arg(1)->Arg(4)->UseRealTime();
+
+}
+
+int main(int argc, char **argv) {
+    //没有指定输出文件时把 JSON 结果写入 microbench.json
+    std::vector<char *> args(argv, argv + argc);
+    bool hasOut = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--benchmark_out=", 16) == 0) { hasOut = true; }
+    }
+    char out[] = "--benchmark_out=microbench.json";
+    char format[] = "--benchmark_out_format=json";
+    if (!hasOut) {
+        args.push_back(out);
+        args.push_back(format);
+    }
+    int count = static_cast<int>(args.size());
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) { return 1; }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
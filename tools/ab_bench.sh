@@ -0,0 +1,41 @@
+#!/bin/sh
+# 交替运行两组服务器参数,用 wrk 对比吞吐和延迟,affinity_bench.sh 与 tcp_bench.sh 都通过它运行
+# 用法: tools/ab_bench.sh <构建目录> <并发连接数> <每轮秒数> <轮数> <路径> <名称A> <参数A> <名称B> <参数B>
+# 参数A/B 是传给 server 的一组参数,以空格分隔,可以为空字符串(使用默认参数)
+# 依赖 wrk;服务器与正常运行时一样需要能连接 MySQL,其余参数可以通过 SERVER_ARGS 传入(如 "-c webserver.conf"),端口为 1316
+set -e
+
+[ $# -eq 9 ] || { echo "usage: $0 <build-dir> <connections> <seconds> <rounds> <path> <name-a> <args-a> <name-b> <args-b>" >&2; exit 1; }
+BUILD=$1
+CONNS=$2
+SECONDS_PER_RUN=$3
+ROUNDS=$4
+URL=http://127.0.0.1:1316/${5#/}
+NAME_A=$6
+ARGS_A=$7
+NAME_B=$8
+ARGS_B=$9
+
+command -v wrk >/dev/null || { echo "wrk not found" >&2; exit 1; }
+cd "$BUILD/code"
+
+run() {
+    ./server $SERVER_ARGS "$@" >/dev/null 2>&1 &
+    pid=$!
+    sleep 1
+    #只取吞吐与延迟分位数
+    wrk -t2 -c"$CONNS" -d"${SECONDS_PER_RUN}s" --latency "$URL" |
+        awk '/Requests\/sec/ {rps=$2} /^ +50%/ {p50=$2} /^ +99%/ {p99=$2}
+             END {printf "%12s %10s %10s\n", rps, p50, p99}'
+    kill "$pid"
+    wait "$pid" 2>/dev/null || true
+}
+
+printf "%-10s %12s %10s %10s\n" profile req/s p50 p99
+i=1
+while [ "$i" -le "$ROUNDS" ]; do
+    #两组参数交替运行,减少机器状态变化带来的偏差
+    printf "%-10s " "$NAME_A"; run $ARGS_A
+    printf "%-10s " "$NAME_B"; run $ARGS_B
+    i=$((i + 1))
+done
@@ -0,0 +1,10 @@
+#!/bin/sh
+# 对比绑定 CPU(server --loopCpus=auto --workerCpus=auto)与不绑定时的吞吐和延迟
+# 用法: tools/affinity_bench.sh <构建目录> [并发连接数] [每轮秒数] [轮数]
+# 压测由 tools/ab_bench.sh 完成,依赖与 SERVER_ARGS 的用法见该脚本
+set -e
+
+BUILD=${1:?usage: $0 <build-dir> [connections] [seconds] [rounds]}
+exec "$(dirname "$0")/ab_bench.sh" "$BUILD" "${2:-256}" "${3:-15}" "${4:-3}" index.html \
+    unpinned "" \
+    pinned "--loopCpus=auto --workerCpus=auto"
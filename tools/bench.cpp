@@ -0,0 +1,615 @@
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+//HTTP 压测工具: 每个线程一个 epoll 实例,管理若干非阻塞连接
+//闭环(默认): 每个连接保持 pipeline 个在途请求,收到一个响应就发送下一个;
+//开环(--rate): 请求按固定的总速率排程,延迟从排定的发送时间算起,服务器变慢时请求在客户端排队的时间也计入延迟,
+//不会因为协调遗漏(coordinated omission)而低估分位数。闭环的 corrected 一行按 HdrHistogram 的方法补上被遗漏的样本
+//用法见 Usage()
+
+namespace {
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+//请求组合中的一种请求
+struct RequestType {
+    int weight;
+    std::string method;
+    std::string path;
+    std::string raw;        //完整的请求报文
+};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 1316;
+    int connections = 64;
+    int threads = 1;
+    int durationSec = 10;
+    double rate = 0;        //每秒的总请求数,0 表示闭环
+    bool keepAlive = true;
+    int pipeline = 1;       //每个连接的在途请求数
+    bool csv = false;
+    std::vector <RequestType> mix;
+};
+
+//一个线程的统计
+struct Result {
+    std::vector <uint64_t> service;     //从实际发出到收到完整响应,纳秒
+    std::vector <uint64_t> scheduled;   //开环时从排定的发送时间到收到完整响应,纳秒
+    uint64_t responses[6] = {0};        //按状态码分类,下标为状态码 / 100
+    uint64_t bytes = 0;
+    uint64_t connects = 0;              //建立的连接数
+    uint64_t connectErrors = 0;
+    uint64_t closedErrors = 0;          //连接被关闭时尚未收到响应的请求
+    uint64_t unfinished = 0;            //压测结束时尚未完成或尚未发出的请求
+};
+
+class Worker {
+public:
+    Worker(const Options &opts, int firstConn, int connCount, uint64_t startNs, uint64_t endNs)
+            : opts_(opts), firstConn_(firstConn), connCount_(connCount), startNs_(startNs), endNs_(endNs),
+              seed_(0x9e3779b97f4a7c15ULL * (firstConn + 1)) {}
+
+    void Run();
+
+    Result result;
+
+private:
+    struct Inflight {
+        uint64_t intended;  //排定的发送时间
+        uint64_t sent;      //实际发出的时间
+    };
+
+    struct Conn {
+        int fd = -1;
+        bool connecting = false;
+        bool wantWrite = false;         //是否注册了可写事件
+        bool closing = false;           //服务器要求在当前响应后关闭连接
+        uint64_t retryAt = 0;           //连接失败后下一次重连的时间
+        uint64_t next = 0;              //开环时下一个请求排定的发送时间
+        std::string out;
+        size_t outOff = 0;
+        std::string in;
+        std::deque <Inflight> inflight;
+        std::deque <uint64_t> backlog;  //开环时已经到期但还没有发出的请求
+    };
+
+    void Connect_(Conn &c, uint64_t now);
+
+    void Fill_(Conn &c, uint64_t now);
+
+    bool Flush_(Conn &c);
+
+    bool Read_(Conn &c);
+
+    bool Parse_(Conn &c, uint64_t now);
+
+    void Close_(Conn &c);
+
+    void Watch_(Conn &c, bool write);
+
+    const RequestType &Pick_();
+
+    const Options &opts_;
+    int firstConn_;                     //本线程第一个连接的全局序号
+    int connCount_;
+    uint64_t startNs_;
+    uint64_t endNs_;
+    uint64_t seed_;
+    int epollFd_ = -1;
+    int totalWeight_ = 0;
+    uint64_t interval_ = 0;             //开环时每个连接的请求间隔
+    std::vector <Conn> conns_;
+};
+
+/**
+ * @brief 按权重随机选择一种请求
+ * @return
+ */
+const RequestType &Worker::Pick_() {
+    if (opts_.mix.size() == 1) { return opts_.mix[0]; }
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 7;
+    seed_ ^= seed_ << 17;
+    int r = static_cast<int>(seed_ % totalWeight_);
+    for (const RequestType &type: opts_.mix) {
+        if (r < type.weight) { return type; }
+        r -= type.weight;
+    }
+    return opts_.mix.back();
+}
+
+void Worker::Watch_(Conn &c, bool write) {
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN | EPOLLRDHUP | (write ? EPOLLOUT : 0);
+    ev.data.ptr = &c;
+    epoll_ctl(epollFd_, EPOLL_CTL_MOD, c.fd, &ev);
+    c.wantWrite = write;
+}
+
+/**
+ * @brief 发起非阻塞连接,完成时收到可写事件
+ * @param c
+ * @param now
+ */
+void Worker::Connect_(Conn &c, uint64_t now) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opts_.port);
+    inet_pton(AF_INET, opts_.host.c_str(), &addr.sin_addr);
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c.fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        result.connectErrors++;
+        close(c.fd);
+        c.fd = -1;
+        c.retryAt = now + 100 * 1000000ULL;
+        return;
+    }
+    c.connecting = true;
+    c.closing = false;
+    struct epoll_event ev = {0};
+    ev.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = &c;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, c.fd, &ev);
+    c.wantWrite = true;
+}
+
+/**
+ * @brief 关闭连接,尚未收到响应的请求记为错误;开环时还没发出的请求留在 backlog 中,重连后发出
+ * @param c
+ */
+void Worker::Close_(Conn &c) {
+    result.closedErrors += c.inflight.size();
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, c.fd, nullptr);
+    close(c.fd);
+    c.fd = -1;
+    c.connecting = false;
+    c.out.clear();
+    c.outOff = 0;
+    c.in.clear();
+    c.inflight.clear();
+}
+
+/**
+ * @brief 在在途请求数允许的范围内发出请求
+ * @param c
+ * @param now
+ */
+void Worker::Fill_(Conn &c, uint64_t now) {
+    int depth = opts_.keepAlive ? opts_.pipeline : 1;
+    bool added = false;
+    while (!c.closing && static_cast<int>(c.inflight.size()) < depth) {
+        uint64_t intended = now;
+        if (interval_ > 0) {
+            if (c.backlog.empty()) { break; }
+            intended = c.backlog.front();
+            c.backlog.pop_front();
+        }
+        c.out += Pick_().raw;
+        c.inflight.push_back({intended, now});
+        added = true;
+    }
+    if (added && !Flush_(c)) {
+        Close_(c);
+    }
+}
+
+/**
+ * @brief 写出待发送的请求,写不完时注册可写事件
+ * @param c
+ * @return 连接出错时返回 false
+ */
+bool Worker::Flush_(Conn &c) {
+    while (c.outOff < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN) { break; }
+            return false;
+        }
+        c.outOff += n;
+    }
+    if (c.outOff == c.out.size()) {
+        c.out.clear();
+        c.outOff = 0;
+    }
+    bool pending = !c.out.empty();
+    if (pending != c.wantWrite) { Watch_(c, pending); }
+    return true;
+}
+
+/**
+ * @brief 读出套接字中的全部数据
+ * @param c
+ * @return 对端关闭或出错时返回 false
+ */
+bool Worker::Read_(Conn &c) {
+    char buf[65536];
+    while (true) {
+        ssize_t n = read(c.fd, buf, sizeof(buf));
+        if (n > 0) {
+            c.in.append(buf, n);
+            result.bytes += n;
+            continue;
+        }
+        return n < 0 && errno == EAGAIN;
+    }
+}
+
+/**
+ * @brief 解析收到的完整响应,记录延迟
+ * @param c
+ * @param now
+ * @return 收到无法解析或多余的响应时返回 false
+ */
+bool Worker::Parse_(Conn &c, uint64_t now) {
+    size_t pos = 0;
+    while (true) {
+        size_t headerEnd = c.in.find("\r\n\r\n", pos);
+        if (headerEnd == std::string::npos) { break; }
+        if (c.inflight.empty() || c.in.compare(pos, 5, "HTTP/") != 0) { return false; }
+        //头部字段名不区分大小写,服务器发送的是 Content-length
+        std::string header = c.in.substr(pos, headerEnd - pos);
+        std::transform(header.begin(), header.end(), header.begin(), ::tolower);
+        size_t length = 0;
+        size_t field = header.find("\r\ncontent-length:");
+        if (field != std::string::npos) {
+            length = strtoul(header.c_str() + field + 17, nullptr, 10);
+        }
+        size_t end = headerEnd + 4 + length;
+        if (c.in.size() < end) { break; }
+
+        size_t space = header.find(' ');
+        int code = space == std::string::npos ? 0 : atoi(header.c_str() + space + 1);
+        result.responses[code >= 100 && code < 600 ? code / 100 : 0]++;
+        Inflight done = c.inflight.front();
+        c.inflight.pop_front();
+        result.service.push_back(now - done.sent);
+        if (interval_ > 0) {
+            result.scheduled.push_back(now - done.intended);
+        }
+        if (header.find("\r\nconnection: close") != std::string::npos) {
+            c.closing = true;
+        }
+        pos = end;
+    }
+    c.in.erase(0, pos);
+    return true;
+}
+
+/**
+ * @brief 事件循环,运行到结束时间
+ */
+void Worker::Run() {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    for (const RequestType &type: opts_.mix) { totalWeight_ += type.weight; }
+    conns_.resize(connCount_);
+    if (opts_.rate > 0) {
+        //每个连接的速率相同,各连接的起始时间错开,请求均匀分布
+        interval_ = static_cast<uint64_t>(opts_.connections * 1e9 / opts_.rate);
+        for (int i = 0; i < connCount_; i++) {
+            conns_[i].next = startNs_ + interval_ * (firstConn_ + i) / opts_.connections;
+        }
+    }
+    std::vector <struct epoll_event> events(std::max(connCount_, 1));
+    while (true) {
+        uint64_t now = NowNs();
+        if (now >= endNs_) { break; }
+        uint64_t wake = now + 100 * 1000000ULL;
+        for (Conn &c: conns_) {
+            if (interval_ > 0) {
+                while (c.next <= now) {
+                    c.backlog.push_back(c.next);
+                    c.next += interval_;
+                }
+                wake = std::min(wake, c.next);
+            }
+            if (c.fd < 0) {
+                if (c.retryAt <= now) {
+                    Connect_(c, now);
+                } else {
+                    wake = std::min(wake, c.retryAt);
+                }
+            } else if (!c.connecting) {
+                Fill_(c, now);
+            }
+        }
+        //epoll_wait 的超时以毫秒为单位,向上取整,到期的请求在醒来后一并发出
+        wake = std::min(wake, endNs_);
+        int timeout = wake > now ? static_cast<int>((wake - now + 999999) / 1000000) : 0;
+        int n = epoll_wait(epollFd_, events.data(), static_cast<int>(events.size()), timeout);
+        now = NowNs();
+        for (int i = 0; i < n; i++) {
+            Conn &c = *static_cast<Conn *>(events[i].data.ptr);
+            if (c.fd < 0) { continue; }
+            if (c.connecting) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0 || (events[i].events & (EPOLLERR | EPOLLHUP))) {
+                    result.connectErrors++;
+                    Close_(c);
+                    c.retryAt = now + 100 * 1000000ULL;
+                    continue;
+                }
+                c.connecting = false;
+                result.connects++;
+                Watch_(c, false);
+                Fill_(c, now);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                if (!Flush_(c)) {
+                    Close_(c);
+                    continue;
+                }
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                bool open = Read_(c);
+                if (!Parse_(c, now) || !open) {
+                    Close_(c);
+                    continue;
+                }
+                if ((c.closing || !opts_.keepAlive) && c.inflight.empty()) {
+                    //短连接或服务器要求关闭: 收完响应后重新连接
+                    Close_(c);
+                    continue;
+                }
+                Fill_(c, now);
+            }
+        }
+    }
+    for (Conn &c: conns_) {
+        result.unfinished += c.inflight.size() + c.backlog.size();
+        c.inflight.clear();
+        if (c.fd >= 0) { Close_(c); }
+    }
+    close(epollFd_);
+}
+
+/**
+ * @brief 按 HdrHistogram 的 recordValueWithExpectedInterval 补上闭环压测中被遗漏的样本:
+ * 一个耗时 v 的请求期间,本应按 interval 发出的请求都被推迟了,补上 v - interval, v - 2 * interval, ...
+ * @param samples
+ * @param interval 连接上两个请求之间预期的间隔
+ * @return
+ */
+std::vector <uint64_t> Correct(const std::vector <uint64_t> &samples, uint64_t interval) {
+    //单个样本补上的个数有上限,避免极长的停顿占满内存
+    const uint64_t MAX_FILL = 100000;
+    std::vector <uint64_t> corrected(samples);
+    if (interval == 0) { return corrected; }
+    for (uint64_t v: samples) {
+        uint64_t filled = 0;
+        for (uint64_t missing = v > interval ? v - interval : 0;
+             missing >= interval && filled < MAX_FILL; missing -= interval, filled++) {
+            corrected.push_back(missing);
+        }
+    }
+    return corrected;
+}
+
+void PrintPercentiles(const char *label, std::vector <uint64_t> samples) {
+    static const double PS[] = {0.5, 0.9, 0.99, 0.999, 0.9999};
+    printf("  %-12s", label);
+    if (samples.empty()) {
+        printf("%9s\n", "-");
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    for (double p: PS) {
+        size_t rank = static_cast<size_t>(p * samples.size());
+        printf("%9.1f", samples[std::min(rank, samples.size() - 1)] / 1e3);
+    }
+    printf("%9.1f\n", samples.back() / 1e3);
+}
+
+uint64_t Percentile(std::vector <uint64_t> &sorted, double p) {
+    if (sorted.empty()) { return 0; }
+    return sorted[std::min(static_cast<size_t>(p * sorted.size()), sorted.size() - 1)];
+}
+
+/**
+ * @brief 解析一种请求: "[权重] 方法 路径 [请求体]",如 "8 GET /index.html" 或 "1 POST /login user=a&password=b"
+ * @param spec
+ * @param opts
+ * @param type
+ * @return
+ */
+bool ParseRequest(const std::string &spec, const Options &opts, RequestType &type) {
+    //依次取出空格分隔的字段,剩余部分整体作为请求体
+    size_t pos = 0;
+    auto next = [&spec, &pos]() {
+        while (pos < spec.size() && spec[pos] == ' ') { pos++; }
+        size_t space = spec.find(' ', pos);
+        if (space == std::string::npos) { space = spec.size(); }
+        std::string field = spec.substr(pos, space - pos);
+        pos = space;
+        return field;
+    };
+    std::string field = next();
+    type.weight = 1;
+    if (!field.empty() && isdigit(static_cast<unsigned char>(field[0]))) {
+        type.weight = atoi(field.c_str());
+        field = next();
+    }
+    type.method = field;
+    type.path = next();
+    while (pos < spec.size() && spec[pos] == ' ') { pos++; }
+    std::string body = spec.substr(pos);
+    if (type.weight <= 0 || type.method.empty() || type.path.empty() || type.path[0] != '/') { return false; }
+    type.raw = type.method + " " + type.path + " HTTP/1.1\r\nHost: " + opts.host + ":" + std::to_string(opts.port) +
+               "\r\nConnection: " + (opts.keepAlive ? "keep-alive" : "close") + "\r\n";
+    if (!body.empty() || type.method == "POST") {
+        type.raw += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+                    std::to_string(body.size()) + "\r\n";
+    }
+    type.raw += "\r\n" + body;
+    return true;
+}
+
+void Usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -H, --host=ADDR        server IPv4 address (127.0.0.1)\n"
+            "  -p, --port=PORT        server port (1316)\n"
+            "  -c, --connections=N    concurrent connections (64)\n"
+            "  -t, --threads=N        client threads, each with its own epoll (1)\n"
+            "  -d, --duration=SEC     test duration (10)\n"
+            "  -R, --rate=N           open loop at N requests/s in total; 0 = closed loop (0)\n"
+            "  -P, --pipeline=N       requests in flight per connection (1)\n"
+            "  -C, --close            one request per connection (Connection: close)\n"
+            "  -r, --req=SPEC         request in the mix, repeatable: \"[weight] METHOD /path [body]\"\n"
+            "                         (default \"1 GET /index.html\")\n"
+            "      --csv              print one CSV row instead of the report\n",
+            prog);
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    std::vector <std::string> specs;
+    static const struct option LONG_OPTIONS[] = {
+            {"host",        required_argument, nullptr, 'H'},
+            {"port",        required_argument, nullptr, 'p'},
+            {"connections", required_argument, nullptr, 'c'},
+            {"threads",     required_argument, nullptr, 't'},
+            {"duration",    required_argument, nullptr, 'd'},
+            {"rate",        required_argument, nullptr, 'R'},
+            {"pipeline",    required_argument, nullptr, 'P'},
+            {"close",       no_argument,       nullptr, 'C'},
+            {"req",         required_argument, nullptr, 'r'},
+            {"csv",         no_argument,       nullptr, 'v'},
+            {"help",        no_argument,       nullptr, 'h'},
+            {nullptr, 0,                       nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "H:p:c:t:d:R:P:Cr:h", LONG_OPTIONS, nullptr)) != -1) {
+        switch (opt) {
+            case 'H': opts.host = optarg; break;
+            case 'p': opts.port = atoi(optarg); break;
+            case 'c': opts.connections = atoi(optarg); break;
+            case 't': opts.threads = atoi(optarg); break;
+            case 'd': opts.durationSec = atoi(optarg); break;
+            case 'R': opts.rate = atof(optarg); break;
+            case 'P': opts.pipeline = atoi(optarg); break;
+            case 'C': opts.keepAlive = false; break;
+            case 'r': specs.emplace_back(optarg); break;
+            case 'v': opts.csv = true; break;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    struct in_addr probe;
+    if (opts.connections <= 0 || opts.threads <= 0 || opts.durationSec <= 0 || opts.pipeline <= 0 ||
+        opts.rate < 0 || inet_pton(AF_INET, opts.host.c_str(), &probe) != 1) {
+        Usage(argv[0]);
+        return 2;
+    }
+    opts.threads = std::min(opts.threads, opts.connections);
+    if (specs.empty()) { specs.emplace_back("1 GET /index.html"); }
+    for (const std::string &spec: specs) {
+        RequestType type;
+        if (!ParseRequest(spec, opts, type)) {
+            fprintf(stderr, "bad request spec: %s\n", spec.c_str());
+            return 2;
+        }
+        opts.mix.push_back(type);
+    }
+
+    uint64_t start = NowNs();
+    uint64_t end = start + static_cast<uint64_t>(opts.durationSec) * 1000000000ULL;
+    std::vector <Worker *> workers;
+    std::vector <std::thread> threads;
+    int first = 0;
+    for (int i = 0; i < opts.threads; i++) {
+        int conns = opts.connections / opts.threads + (i < opts.connections % opts.threads ? 1 : 0);
+        workers.push_back(new Worker(opts, first, conns, start, end));
+        first += conns;
+    }
+    for (Worker *worker: workers) {
+        threads.emplace_back(&Worker::Run, worker);
+    }
+    for (std::thread &thread: threads) { thread.join(); }
+    double elapsed = (NowNs() - start) / 1e9;
+
+    Result total;
+    for (Worker *worker: workers) {
+        Result &r = worker->result;
+        total.service.insert(total.service.end(), r.service.begin(), r.service.end());
+        total.scheduled.insert(total.scheduled.end(), r.scheduled.begin(), r.scheduled.end());
+        for (int i = 0; i < 6; i++) { total.responses[i] += r.responses[i]; }
+        total.bytes += r.bytes;
+        total.connects += r.connects;
+        total.connectErrors += r.connectErrors;
+        total.closedErrors += r.closedErrors;
+        total.unfinished += r.unfinished;
+        delete worker;
+    }
+    size_t requests = total.service.size();
+    uint64_t errors = total.connectErrors + total.closedErrors + total.responses[0] +
+                      total.responses[4] + total.responses[5];
+    std::vector <uint64_t> corrected;
+    if (opts.rate > 0) {
+        corrected = total.scheduled;
+    } else if (requests > 0) {
+        //闭环时连接上两个请求之间的预期间隔取平均服务时间除以在途请求数
+        uint64_t sum = 0;
+        for (uint64_t v: total.service) { sum += v; }
+        int depth = opts.keepAlive ? opts.pipeline : 1;
+        corrected = Correct(total.service, sum / requests / depth);
+    }
+
+    if (opts.csv) {
+        std::sort(total.service.begin(), total.service.end());
+        std::sort(corrected.begin(), corrected.end());
+        printf("rps,p50_us,p90_us,p99_us,p999_us,corrected_p99_us,corrected_p999_us,errors\n");
+        printf("%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%llu\n", requests / elapsed,
+               Percentile(total.service, 0.5) / 1e3, Percentile(total.service, 0.9) / 1e3,
+               Percentile(total.service, 0.99) / 1e3, Percentile(total.service, 0.999) / 1e3,
+               Percentile(corrected, 0.99) / 1e3, Percentile(corrected, 0.999) / 1e3,
+               (unsigned long long) errors);
+        return 0;
+    }
+    printf("%s:%d, %d threads, %d connections, %s, %s, pipeline %d, %ds\n",
+           opts.host.c_str(), opts.port, opts.threads, opts.connections,
+           opts.rate > 0 ? ("open loop " + std::to_string(static_cast<long long>(opts.rate)) + " req/s").c_str()
+                         : "closed loop",
+           opts.keepAlive ? "keep-alive" : "close", opts.keepAlive ? opts.pipeline : 1, opts.durationSec);
+    printf("  requests:   %zu in %.2fs, %.1f req/s, %.2f MB/s received\n",
+           requests, elapsed, requests / elapsed, total.bytes / elapsed / 1e6);
+    printf("  responses:  2xx %llu, 3xx %llu, 4xx %llu, 5xx %llu, malformed %llu\n",
+           (unsigned long long) total.responses[2], (unsigned long long) total.responses[3],
+           (unsigned long long) total.responses[4], (unsigned long long) total.responses[5],
+           (unsigned long long) total.responses[0]);
+    printf("  errors:     connect %llu, closed before response %llu, unfinished %llu; connections %llu\n",
+           (unsigned long long) total.connectErrors, (unsigned long long) total.closedErrors,
+           (unsigned long long) total.unfinished, (unsigned long long) total.connects);
+    printf("  latency(us)       p50      p90      p99    p99.9   p99.99      max\n");
+    PrintPercentiles("service", total.service);
+    PrintPercentiles("corrected", corrected);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include "../code/log/binlog.h"
+
+//将服务器写出的二进制日志(.blog)还原为文本或 JSON
+//用法: logdecode [--json] file...
+int main(int argc, char *argv[]) {
+    bool json = false;
+    int first = 1;
+    if (argc > 1 && strcmp(argv[1], "--json") == 0) {
+        json = true;
+        first = 2;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: %s [--json] file...\n", argv[0]);
+        return 2;
+    }
+    int ret = 0;
+    for (int i = first; i < argc; i++) {
+        std::ifstream in(argv[i], std::ios::binary);
+        if (!in) {
+            fprintf(stderr, "%s: cannot open\n", argv[i]);
+            ret = 1;
+            continue;
+        }
+        std::stringstream ss;
+        ss << in.rdbuf();
+        std::string data = ss.str();
+        if (BinLog::Decode(data.data(), data.size(), stdout, json) < 0) {
+            fprintf(stderr, "%s: corrupt or truncated log\n", argv[i]);
+            ret = 1;
+        }
+    }
+    return ret;
+}
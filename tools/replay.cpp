@@ -0,0 +1,771 @@
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+//流量回放工具: 读取服务器以 captureFile 录制的文件(格式见 code/log/trafficcapture.h),
+//按录制时的到达时间(或按倍速压缩后的时间)把每个连接收到的原始字节原样发给本地服务器,
+//延迟从排定的发送时间算起,服务器变慢时不会因为协调遗漏而低估分位数。
+//-o 把每个请求的延迟写入文件,--compare 对比两次回放(如新旧两个版本)的延迟分布
+//用法见 Usage()
+
+namespace {
+
+enum RecordType {
+    CAPTURE_OPEN = 1,
+    CAPTURE_DATA = 2,
+    CAPTURE_CLOSE = 3,
+};
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 1316;
+    double speed = 1;           //回放倍速
+    int waitSec = 5;            //最后一个事件之后等待响应的最长时间
+    bool csv = false;
+    std::string out;            //每个请求的延迟写入该文件
+};
+
+//录制中的一个事件
+struct Event {
+    uint64_t at;                //录制时的 Unix 时间,微秒
+    int type;
+    size_t conn;                //连接在 conns 中的下标
+    std::string data;
+    int completes;              //这段数据之后连接上新凑齐的完整请求数
+    bool startsRequest;         //这段数据是否从一个新请求开始
+};
+
+struct Inflight {
+    uint64_t intended;          //排定的发送时间
+};
+
+//等待前一个响应的请求数据
+struct Held {
+    Event *event;
+    uint64_t due;
+};
+
+struct Conn {
+    int fd = -1;
+    bool connecting = false;
+    bool wantWrite = false;
+    bool closeWhenDone = false; //录制中服务器在这里关闭了连接,收完响应后关闭
+    bool finished = false;      //连接已经关闭,之后不再使用
+    std::string out;
+    size_t outOff = 0;
+    std::string in;
+    std::deque <Inflight> inflight;
+    std::deque <Held> held;
+    std::string pending;        //载入时用于切分请求,尚未凑齐的请求数据
+};
+
+struct Result {
+    std::vector <uint64_t> latency;     //从排定的发送时间到收到完整响应,纳秒
+    uint64_t responses[6] = {0};        //按状态码分类,下标为状态码 / 100
+    uint64_t bytes = 0;
+    uint64_t requests = 0;              //录制中完整的请求数
+    uint64_t connects = 0;
+    uint64_t connectErrors = 0;
+    uint64_t closedErrors = 0;          //连接被关闭时尚未收到响应的请求
+    uint64_t unfinished = 0;            //等待超时仍未收到响应的请求
+    uint64_t maxLagNs = 0;              //事件实际执行时间晚于排定时间的最大值,过大说明回放端跟不上
+};
+
+/**
+ * @brief 读取一个 varint
+ * @param p
+ * @param end
+ * @param v
+ * @return 数据不完整时返回 false
+ */
+bool GetVarint(const char *&p, const char *end, uint64_t &v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) { return true; }
+    }
+    return false;
+}
+
+uint64_t GetLittle(const char *p, size_t size) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < size; i++) {
+        v |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+    }
+    return v;
+}
+
+/**
+ * @brief 从连接已经收到的数据中切出完整的请求: 头部以空行结束,请求体的长度由 Content-Length 给出
+ * @param c
+ * @return 新凑齐的请求数
+ */
+int SplitRequests(Conn &c) {
+    int count = 0;
+    size_t pos = 0;
+    while (true) {
+        size_t headerEnd = c.pending.find("\r\n\r\n", pos);
+        if (headerEnd == std::string::npos) { break; }
+        std::string header = c.pending.substr(pos, headerEnd - pos);
+        std::transform(header.begin(), header.end(), header.begin(), ::tolower);
+        size_t length = 0;
+        size_t field = header.find("\r\ncontent-length:");
+        if (field != std::string::npos) {
+            length = strtoul(header.c_str() + field + 17, nullptr, 10);
+        }
+        size_t end = headerEnd + 4 + length;
+        if (c.pending.size() < end) { break; }
+        count++;
+        pos = end;
+    }
+    c.pending.erase(0, pos);
+    return count;
+}
+
+/**
+ * @brief 载入一个录制文件,追加到 events 与 conns 中
+ * @param path
+ * @param events
+ * @param conns
+ * @param err
+ * @return
+ */
+bool LoadCapture(const std::string &path, std::vector <Event> &events, std::vector <Conn> &conns, std::string &err) {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        err = path + ": " + strerror(errno);
+        return false;
+    }
+    std::string content;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) { content.append(buf, n); }
+    fclose(fp);
+    if (content.size() < 16 || content.compare(0, 4, "WCAP") != 0) {
+        err = path + ": not a capture file";
+        return false;
+    }
+    if (GetLittle(content.data() + 4, 4) != 1) {
+        err = path + ": unsupported capture version";
+        return false;
+    }
+    uint64_t start = GetLittle(content.data() + 8, 8);
+    std::map <uint64_t, size_t> ids;    //文件中的连接编号 -> conns 中的下标
+    const char *p = content.data() + 16;
+    const char *end = content.data() + content.size();
+    while (p < end) {
+        Event e;
+        e.type = static_cast<uint8_t>(*p++);
+        uint64_t id, offset, len = 0;
+        if (!GetVarint(p, end, id) || !GetVarint(p, end, offset) ||
+            (e.type == CAPTURE_DATA && (!GetVarint(p, end, len) || len > static_cast<uint64_t>(end - p)))) {
+            //服务器异常退出时最后一批记录可能不完整,之前的记录照常回放
+            fprintf(stderr, "%s: truncated record at offset %td, ignored the rest\n", path.c_str(),
+                    p - content.data());
+            break;
+        }
+        if (e.type < CAPTURE_OPEN || e.type > CAPTURE_CLOSE) {
+            err = path + ": bad record type";
+            return false;
+        }
+        auto it = ids.find(id);
+        if (it == ids.end()) {
+            it = ids.emplace(id, conns.size()).first;
+            conns.emplace_back();
+        }
+        e.at = start + offset;
+        e.conn = it->second;
+        e.data.assign(p, len);
+        e.completes = 0;
+        e.startsRequest = false;
+        p += len;
+        events.push_back(std::move(e));
+    }
+    return true;
+}
+
+/**
+ * @brief 按时间排序,并统计每段数据凑齐的请求数
+ * 各线程的记录分批写入文件,同一时刻的事件按 建立 -> 数据 -> 关闭 的顺序排列;
+ * 同一连接的事件在录制时由同一时刻只有一个线程处理,时间先后即是发生的先后
+ * @param events
+ * @param conns
+ * @return 完整的请求数
+ */
+uint64_t Prepare(std::vector <Event> &events, std::vector <Conn> &conns) {
+    std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b) {
+        return a.at != b.at ? a.at < b.at : a.type < b.type;
+    });
+    uint64_t requests = 0;
+    for (Event &e: events) {
+        if (e.type != CAPTURE_DATA) { continue; }
+        Conn &c = conns[e.conn];
+        e.startsRequest = c.pending.empty();
+        c.pending += e.data;
+        e.completes = SplitRequests(c);
+        requests += e.completes;
+    }
+    for (Conn &c: conns) {
+        c.pending.clear();
+        c.pending.shrink_to_fit();
+    }
+    return requests;
+}
+
+class Replayer {
+public:
+    Replayer(const Options &opts, std::vector <Event> &events, std::vector <Conn> &conns)
+            : opts_(opts), events_(events), conns_(conns) {}
+
+    void Run();
+
+    Result result;
+
+private:
+    void Execute_(Event &e, uint64_t due, uint64_t now);
+
+    bool Send_(Conn &c, Event &e, uint64_t due);
+
+    void Release_(Conn &c);
+
+    void Connect_(Conn &c);
+
+    bool Flush_(Conn &c);
+
+    bool Read_(Conn &c);
+
+    bool Parse_(Conn &c, uint64_t now);
+
+    void Close_(Conn &c);
+
+    void Watch_(Conn &c, bool write);
+
+    const Options &opts_;
+    std::vector <Event> &events_;
+    std::vector <Conn> &conns_;
+    int epollFd_ = -1;
+    uint64_t outstanding_ = 0;      //所有连接上已经排定、尚未收到响应的请求数
+};
+
+void Replayer::Watch_(Conn &c, bool write) {
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN | EPOLLRDHUP | (write ? EPOLLOUT : 0);
+    ev.data.ptr = &c;
+    epoll_ctl(epollFd_, EPOLL_CTL_MOD, c.fd, &ev);
+    c.wantWrite = write;
+}
+
+/**
+ * @brief 发起非阻塞连接,完成时收到可写事件;连接完成之前到达的数据先留在 out 中
+ * @param c
+ */
+void Replayer::Connect_(Conn &c) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opts_.port);
+    inet_pton(AF_INET, opts_.host.c_str(), &addr.sin_addr);
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c.fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        result.connectErrors++;
+        close(c.fd);
+        c.fd = -1;
+        c.finished = true;
+        return;
+    }
+    c.connecting = true;
+    struct epoll_event ev = {0};
+    ev.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = &c;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, c.fd, &ev);
+    c.wantWrite = true;
+}
+
+/**
+ * @brief 关闭连接,尚未收到响应的请求记为错误,之后这个连接上的数据不再发送
+ * @param c
+ */
+void Replayer::Close_(Conn &c) {
+    uint64_t lost = c.inflight.size();
+    for (const Held &h: c.held) { lost += h.event->completes; }
+    result.closedErrors += lost;
+    outstanding_ -= lost;
+    if (c.fd >= 0) {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+    }
+    c.fd = -1;
+    c.connecting = false;
+    c.finished = true;
+    c.out.clear();
+    c.outOff = 0;
+    c.in.clear();
+    c.inflight.clear();
+    c.held.clear();
+}
+
+/**
+ * @brief 写出待发送的数据,写不完时注册可写事件
+ * @param c
+ * @return 连接出错时返回 false
+ */
+bool Replayer::Flush_(Conn &c) {
+    while (c.outOff < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN) { break; }
+            return false;
+        }
+        c.outOff += n;
+    }
+    if (c.outOff == c.out.size()) {
+        c.out.clear();
+        c.outOff = 0;
+    }
+    bool pending = !c.out.empty();
+    if (pending != c.wantWrite) { Watch_(c, pending); }
+    return true;
+}
+
+/**
+ * @brief 读出套接字中的全部数据
+ * @param c
+ * @return 对端关闭或出错时返回 false
+ */
+bool Replayer::Read_(Conn &c) {
+    char buf[65536];
+    while (true) {
+        ssize_t n = read(c.fd, buf, sizeof(buf));
+        if (n > 0) {
+            c.in.append(buf, n);
+            result.bytes += n;
+            continue;
+        }
+        return n < 0 && errno == EAGAIN;
+    }
+}
+
+/**
+ * @brief 解析收到的完整响应,记录延迟
+ * @param c
+ * @param now
+ * @return 收到无法解析或多余的响应时返回 false
+ */
+bool Replayer::Parse_(Conn &c, uint64_t now) {
+    size_t pos = 0;
+    while (true) {
+        size_t headerEnd = c.in.find("\r\n\r\n", pos);
+        if (headerEnd == std::string::npos) { break; }
+        if (c.inflight.empty() || c.in.compare(pos, 5, "HTTP/") != 0) { return false; }
+        //头部字段名不区分大小写,服务器发送的是 Content-length
+        std::string header = c.in.substr(pos, headerEnd - pos);
+        std::transform(header.begin(), header.end(), header.begin(), ::tolower);
+        size_t length = 0;
+        size_t field = header.find("\r\ncontent-length:");
+        if (field != std::string::npos) {
+            length = strtoul(header.c_str() + field + 17, nullptr, 10);
+        }
+        size_t end = headerEnd + 4 + length;
+        if (c.in.size() < end) { break; }
+
+        size_t space = header.find(' ');
+        int code = space == std::string::npos ? 0 : atoi(header.c_str() + space + 1);
+        result.responses[code >= 100 && code < 600 ? code / 100 : 0]++;
+        result.latency.push_back(now - c.inflight.front().intended);
+        c.inflight.pop_front();
+        outstanding_--;
+        pos = end;
+    }
+    c.in.erase(0, pos);
+    return true;
+}
+
+/**
+ * @brief 执行一个到期的事件
+ * @param e
+ * @param due 排定的执行时间
+ * @param now
+ */
+void Replayer::Execute_(Event &e, uint64_t due, uint64_t now) {
+    result.maxLagNs = std::max(result.maxLagNs, now - due);
+    Conn &c = conns_[e.conn];
+    switch (e.type) {
+        case CAPTURE_OPEN:
+            if (c.fd < 0 && !c.finished) { Connect_(c); }
+            break;
+        case CAPTURE_DATA:
+            if (c.fd < 0 && !c.finished) {
+                //建立事件因为服务器端的缓冲区满而被丢弃时,在第一段数据之前建立连接
+                Connect_(c);
+            }
+            if (c.finished) {
+                //服务器已经关闭了连接,录制中之后的请求都记为错误
+                result.closedErrors += e.completes;
+                break;
+            }
+            outstanding_ += e.completes;
+            if (!c.held.empty() || (e.startsRequest && !c.inflight.empty())) {
+                //服务器不支持 pipeline,与录制时的客户端一样收到前一个响应后才发出下一个请求,
+                //延迟仍然从排定的时间算起,等待的时间计入延迟
+                c.held.push_back({&e, due});
+                break;
+            }
+            Send_(c, e, due);
+            break;
+        case CAPTURE_CLOSE:
+            c.closeWhenDone = true;
+            if (c.fd >= 0 && !c.connecting && c.inflight.empty() && c.held.empty() && c.out.empty()) {
+                Close_(c);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief 发出一段数据,其中凑齐的请求开始等待响应
+ * @param c
+ * @param e
+ * @param due 排定的发送时间
+ * @return 连接出错被关闭时返回 false
+ */
+bool Replayer::Send_(Conn &c, Event &e, uint64_t due) {
+    c.out += e.data;
+    std::string().swap(e.data);
+    for (int i = 0; i < e.completes; i++) {
+        c.inflight.push_back({due});
+    }
+    if (!c.connecting && !Flush_(c)) {
+        Close_(c);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 前面的请求都收到响应后,发出等待中的请求数据
+ * @param c
+ */
+void Replayer::Release_(Conn &c) {
+    while (!c.held.empty() && (c.inflight.empty() || !c.held.front().event->startsRequest)) {
+        Held h = c.held.front();
+        c.held.pop_front();
+        if (!Send_(c, *h.event, h.due)) { return; }
+    }
+}
+
+/**
+ * @brief 事件循环: 按排定的时间依次执行事件,最后一个事件之后再等待未完成的响应
+ */
+void Replayer::Run() {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    std::vector <struct epoll_event> ready(1024);
+    if (events_.empty()) { return; }
+    uint64_t base = events_.front().at;
+    uint64_t start = NowNs();
+    auto dueOf = [this, base, start](const Event &e) {
+        return start + static_cast<uint64_t>((e.at - base) * 1000 / opts_.speed);
+    };
+    size_t next = 0;
+    uint64_t deadline = 0;
+    while (true) {
+        uint64_t now = NowNs();
+        while (next < events_.size() && dueOf(events_[next]) <= now) {
+            Execute_(events_[next], dueOf(events_[next]), now);
+            next++;
+        }
+        if (next == events_.size()) {
+            //最后一个事件之后只等待未完成的响应,录制结束时仍然打开的空闲连接直接关闭
+            if (deadline == 0) { deadline = now + static_cast<uint64_t>(opts_.waitSec) * 1000000000ULL; }
+            if (outstanding_ == 0 || now >= deadline) { break; }
+        }
+        //epoll_wait 的超时以毫秒为单位,不足一毫秒时不阻塞,在循环中轮询直到事件到期
+        uint64_t wake = next < events_.size() ? dueOf(events_[next]) : deadline;
+        int timeout = wake > now ? static_cast<int>((wake - now) / 1000000) : 0;
+        int n = epoll_wait(epollFd_, ready.data(), static_cast<int>(ready.size()), timeout);
+        now = NowNs();
+        for (int i = 0; i < n; i++) {
+            Conn &c = *static_cast<Conn *>(ready[i].data.ptr);
+            if (c.fd < 0) { continue; }
+            if (c.connecting) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0 || (ready[i].events & (EPOLLERR | EPOLLHUP))) {
+                    result.connectErrors++;
+                    Close_(c);
+                    continue;
+                }
+                c.connecting = false;
+                result.connects++;
+                if (!Flush_(c)) {
+                    Close_(c);
+                    continue;
+                }
+            }
+            if (ready[i].events & EPOLLOUT) {
+                if (!Flush_(c)) {
+                    Close_(c);
+                    continue;
+                }
+            }
+            if (ready[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                bool open = Read_(c);
+                if (!Parse_(c, now) || !open) {
+                    Close_(c);
+                    continue;
+                }
+                Release_(c);
+                if (c.fd >= 0 && c.closeWhenDone && c.inflight.empty() && c.held.empty() && c.out.empty()) {
+                    Close_(c);
+                }
+            }
+        }
+    }
+    for (Conn &c: conns_) {
+        uint64_t waiting = c.inflight.size();
+        for (const Held &h: c.held) { waiting += h.event->completes; }
+        result.unfinished += waiting;
+        outstanding_ -= waiting;
+        c.inflight.clear();
+        c.held.clear();
+        if (c.fd >= 0) { Close_(c); }
+    }
+    close(epollFd_);
+}
+
+uint64_t Percentile(const std::vector <uint64_t> &sorted, double p) {
+    if (sorted.empty()) { return 0; }
+    return sorted[std::min(static_cast<size_t>(p * sorted.size()), sorted.size() - 1)];
+}
+
+/**
+ * @brief 读取 -o 写出的延迟文件,每行一个微秒数,# 开始的是注释
+ * @param path
+ * @param samples 按升序排列
+ * @return
+ */
+bool LoadLatencies(const std::string &path, std::vector <uint64_t> &samples) {
+    FILE *fp = fopen(path.c_str(), "r");
+    if (fp == nullptr) {
+        fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '\n') { continue; }
+        samples.push_back(strtoull(line, nullptr, 10));
+    }
+    fclose(fp);
+    std::sort(samples.begin(), samples.end());
+    return true;
+}
+
+/**
+ * @brief 两个样本的 Kolmogorov-Smirnov 统计量: 两个经验分布函数之差的最大值
+ * @param a 升序
+ * @param b 升序
+ * @return
+ */
+double KsStatistic(const std::vector <uint64_t> &a, const std::vector <uint64_t> &b) {
+    size_t i = 0, j = 0;
+    double d = 0;
+    while (i < a.size() && j < b.size()) {
+        uint64_t v = std::min(a[i], b[j]);
+        while (i < a.size() && a[i] == v) { i++; }
+        while (j < b.size() && b[j] == v) { j++; }
+        d = std::max(d, fabs(static_cast<double>(i) / a.size() - static_cast<double>(j) / b.size()));
+    }
+    return d;
+}
+
+/**
+ * @brief 对比两次回放的延迟分布
+ * @param oldPath 基准版本的延迟文件
+ * @param newPath 新版本的延迟文件
+ * @param threshold 新版本的 p50 或 p99 比基准慢超过该百分比时返回 1,0 表示不检查
+ * @return 进程退出码
+ */
+int Compare(const std::string &oldPath, const std::string &newPath, double threshold) {
+    std::vector <uint64_t> a, b;
+    if (!LoadLatencies(oldPath, a) || !LoadLatencies(newPath, b)) { return 2; }
+    if (a.empty() || b.empty()) {
+        fprintf(stderr, "no samples\n");
+        return 2;
+    }
+    static const struct {
+        const char *label;
+        double p;
+    } ROWS[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p99.9", 0.999}, {"max", 1.0}};
+    printf("latency(us)  %12s %12s %9s\n", "old", "new", "change");
+    printf("  %-10s %12zu %12zu\n", "samples", a.size(), b.size());
+    bool regressed = false;
+    for (const auto &row: ROWS) {
+        uint64_t x = Percentile(a, row.p), y = Percentile(b, row.p);
+        double change = x > 0 ? (static_cast<double>(y) - x) * 100 / x : 0;
+        printf("  %-10s %12llu %12llu %+8.1f%%\n", row.label, (unsigned long long) x, (unsigned long long) y, change);
+        if (threshold > 0 && (row.p == 0.5 || row.p == 0.99) && change > threshold) { regressed = true; }
+    }
+    //显著性水平 0.05 下两个样本来自同一分布时 D 的临界值
+    double d = KsStatistic(a, b);
+    double critical = 1.358 * sqrt(static_cast<double>(a.size() + b.size()) / (a.size() * b.size()));
+    printf("  KS D = %.4f (critical %.4f at 0.05): %s\n", d, critical,
+           d > critical ? "distributions differ" : "no significant difference");
+    if (regressed) {
+        printf("  regression: p50 or p99 slower by more than %.1f%%\n", threshold);
+        return 1;
+    }
+    return 0;
+}
+
+void Usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [options] CAPTURE...\n"
+            "       %s --compare OLD NEW [--threshold=PCT]\n"
+            "  -H, --host=ADDR        server IPv4 address (127.0.0.1)\n"
+            "  -p, --port=PORT        server port (1316)\n"
+            "  -s, --speed=X          replay at X times the captured rate (1)\n"
+            "  -w, --wait=SEC         wait for outstanding responses after the last event (5)\n"
+            "  -o, --out=FILE         write per-request latencies (us) for --compare\n"
+            "      --csv              print one CSV row instead of the report\n"
+            "      --compare          compare two latency files written by -o\n"
+            "      --threshold=PCT    with --compare, exit 1 if p50 or p99 got slower by more than PCT%%\n",
+            prog, prog);
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    bool compare = false;
+    double threshold = 0;
+    static const struct option LONG_OPTIONS[] = {
+            {"host",      required_argument, nullptr, 'H'},
+            {"port",      required_argument, nullptr, 'p'},
+            {"speed",     required_argument, nullptr, 's'},
+            {"wait",      required_argument, nullptr, 'w'},
+            {"out",       required_argument, nullptr, 'o'},
+            {"csv",       no_argument,       nullptr, 'v'},
+            {"compare",   no_argument,       nullptr, 'm'},
+            {"threshold", required_argument, nullptr, 'T'},
+            {"help",      no_argument,       nullptr, 'h'},
+            {nullptr, 0,                     nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "H:p:s:w:o:h", LONG_OPTIONS, nullptr)) != -1) {
+        switch (opt) {
+            case 'H': opts.host = optarg; break;
+            case 'p': opts.port = atoi(optarg); break;
+            case 's': opts.speed = atof(optarg); break;
+            case 'w': opts.waitSec = atoi(optarg); break;
+            case 'o': opts.out = optarg; break;
+            case 'v': opts.csv = true; break;
+            case 'm': compare = true; break;
+            case 'T': threshold = atof(optarg); break;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (compare) {
+        if (argc - optind != 2) {
+            Usage(argv[0]);
+            return 2;
+        }
+        return Compare(argv[optind], argv[optind + 1], threshold);
+    }
+    struct in_addr probe;
+    if (optind == argc || opts.speed <= 0 || opts.waitSec < 0 || inet_pton(AF_INET, opts.host.c_str(), &probe) != 1) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    //prefork 模式下每个工作进程录制一个文件,一起传入时按时间合并
+    std::vector <Event> events;
+    std::vector <Conn> conns;
+    for (int i = optind; i < argc; i++) {
+        std::string err;
+        if (!LoadCapture(argv[i], events, conns, err)) {
+            fprintf(stderr, "%s\n", err.c_str());
+            return 2;
+        }
+    }
+    uint64_t requests = Prepare(events, conns);
+    double span = events.empty() ? 0 : (events.back().at - events.front().at) / 1e6;
+
+    Replayer replayer(opts, events, conns);
+    replayer.result.requests = requests;
+    uint64_t start = NowNs();
+    replayer.Run();
+    double elapsed = (NowNs() - start) / 1e9;
+    Result &r = replayer.result;
+    std::sort(r.latency.begin(), r.latency.end());
+
+    if (!opts.out.empty()) {
+        FILE *fp = fopen(opts.out.c_str(), "w");
+        if (fp == nullptr) {
+            fprintf(stderr, "%s: %s\n", opts.out.c_str(), strerror(errno));
+            return 2;
+        }
+        fprintf(fp, "# replay of %d capture file(s) at %gx, %zu requests\n", argc - optind, opts.speed, r.latency.size());
+        for (uint64_t v: r.latency) { fprintf(fp, "%llu\n", (unsigned long long) (v / 1000)); }
+        fclose(fp);
+    }
+    uint64_t errors = r.connectErrors + r.closedErrors + r.unfinished + r.responses[0] + r.responses[5];
+    if (opts.csv) {
+        printf("requests,responses,p50_us,p90_us,p99_us,p999_us,max_lag_us,errors\n");
+        printf("%llu,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,%llu\n", (unsigned long long) r.requests, r.latency.size(),
+               Percentile(r.latency, 0.5) / 1e3, Percentile(r.latency, 0.9) / 1e3,
+               Percentile(r.latency, 0.99) / 1e3, Percentile(r.latency, 0.999) / 1e3,
+               r.maxLagNs / 1e3, (unsigned long long) errors);
+        return 0;
+    }
+    printf("%s:%d, %zu connections, %.2fs captured, replayed at %gx in %.2fs\n", opts.host.c_str(), opts.port,
+           conns.size(), span, opts.speed, elapsed);
+    printf("  requests:   %llu captured, %zu responses, %.2f MB received\n",
+           (unsigned long long) r.requests, r.latency.size(), r.bytes / 1e6);
+    printf("  responses:  2xx %llu, 3xx %llu, 4xx %llu, 5xx %llu, malformed %llu\n",
+           (unsigned long long) r.responses[2], (unsigned long long) r.responses[3],
+           (unsigned long long) r.responses[4], (unsigned long long) r.responses[5],
+           (unsigned long long) r.responses[0]);
+    printf("  errors:     connect %llu, closed before response %llu, unfinished %llu; connections %llu\n",
+           (unsigned long long) r.connectErrors, (unsigned long long) r.closedErrors,
+           (unsigned long long) r.unfinished, (unsigned long long) r.connects);
+    printf("  max lag:    %.1f us behind schedule\n", r.maxLagNs / 1e3);
+    printf("  latency(us)        p50       p90       p99     p99.9       max\n");
+    printf("  %-12s", "scheduled");
+    if (r.latency.empty()) {
+        printf("%10s\n", "-");
+        return 0;
+    }
+    for (double p: {0.5, 0.9, 0.99, 0.999}) {
+        printf("%10.1f", Percentile(r.latency, p) / 1e3);
+    }
+    printf("%10.1f\n", r.latency.back() / 1e3);
+    return 0;
+}
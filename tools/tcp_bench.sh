@@ -0,0 +1,10 @@
+#!/bin/sh
+# 在回环地址上对比内核默认 TCP 参数(不设置 TCP_NODELAY 等选项)与配置中的 TCP 参数的吞吐和延迟
+# 用法: tools/tcp_bench.sh <构建目录> [并发连接数] [每轮秒数] [轮数] [路径]
+# 压测由 tools/ab_bench.sh 完成,依赖与 SERVER_ARGS 的用法见该脚本
+set -e
+
+BUILD=${1:?usage: $0 <build-dir> [connections] [seconds] [rounds] [path]}
+exec "$(dirname "$0")/ab_bench.sh" "$BUILD" "${2:-64}" "${3:-15}" "${4:-3}" "${5:-index.html}" \
+    default "--tcpNoDelay=false --sndBufBytes=0 --rcvBufBytes=0 --notSentLowat=0 --keepAliveIdleSec=0" \
+    tuned ""
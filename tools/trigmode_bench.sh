@@ -0,0 +1,59 @@
+#!/bin/sh
+# 在每种触发模式(trigMode 0~3)、线程数与长短连接的组合下压测服务器,输出吞吐、p99 与每个请求消耗的服务器 CPU 时间
+# 用法: tools/trigmode_bench.sh <构建目录> [并发连接数] [每轮秒数] [线程数列表] [路径]
+# 用构建目录中的 tools/bench 产生负载,BENCH_ARGS 传给 bench(如 "-t 2" 或 "-P 4");线程数列表以空格分隔,如 "1 4 8"
+# 服务器与正常运行时一样需要能连接 MySQL,其余参数可以通过 SERVER_ARGS 传入(如 "-c webserver.conf"),端口为 1316
+# mode 列为 "trigMode 监听/连接" 的触发方式;CPU 时间取自 /proc/<pid>/stat 中服务器进程(包括所有线程)的 utime + stime,精度为一个时钟滴答
+set -e
+
+BUILD=${1:?usage: $0 <build-dir> [connections] [seconds] [threads-list] [path]}
+CONNS=${2:-64}
+SECONDS_PER_RUN=${3:-10}
+THREADS=${4:-"1 4"}
+URL_PATH=${5:-/index.html}
+
+BENCH=$(cd "$BUILD/tools" && pwd)/bench
+[ -x "$BENCH" ] || { echo "$BENCH not found, build the bench target first" >&2; exit 1; }
+cd "$BUILD/code"
+HZ=$(getconf CLK_TCK)
+
+cpu_ticks() {
+    #进程名中可能有空格,从最后一个 ')' 之后数,utime 与 stime 是其后的第 12、13 个字段
+    sed 's/.*) //' "/proc/$1/stat" | awk '{print $12 + $13}'
+}
+
+run() {
+    ./server $SERVER_ARGS --trigMode="$1" --threadNum="$2" >/dev/null 2>&1 &
+    pid=$!
+    sleep 1
+    before=$(cpu_ticks "$pid")
+    #csv: rps,p50,p90,p99,p999,corrected_p99,corrected_p999,errors
+    result=$("$BENCH" -c "$CONNS" -d "$SECONDS_PER_RUN" $3 $BENCH_ARGS -r "GET $URL_PATH" --csv | tail -n 1)
+    after=$(cpu_ticks "$pid")
+    kill "$pid"
+    wait "$pid" 2>/dev/null || true
+    echo "$result" | awk -F, -v ticks=$((after - before)) -v hz="$HZ" -v secs="$SECONDS_PER_RUN" '{
+        reqs = $1 * secs
+        printf "%10.0f %10.0f %12.0f %12.1f %8d\n", $1, $4, $6, (reqs > 0 ? ticks / hz * 1e6 / reqs : 0), $8
+    }'
+}
+
+printf "%-10s %7s %9s %10s %10s %12s %12s %8s\n" \
+    mode threads keepalive req/s "p99(us)" "cp99(us)" "cpu(us)/req" errors
+for threads in $THREADS; do
+    for keepalive in on off; do
+        args=""
+        [ "$keepalive" = off ] && args="-C"
+        #同一组线程数与连接方式下四种模式相邻运行,便于对比
+        for mode in 0 1 2 3; do
+            case $mode in
+                0) name="0 LT/LT" ;;
+                1) name="1 LT/ET" ;;
+                2) name="2 ET/LT" ;;
+                3) name="3 ET/ET" ;;
+            esac
+            printf "%-10s %7s %9s " "$name" "$threads" "$keepalive"
+            run "$mode" "$threads" "$args"
+        done
+    done
+done